@@ -0,0 +1,346 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/* Synchronization microbenchmarks.
+ *
+ *   syncbench <bench>[,<bench>...]|all <threads>[,<threads>...] [iters]
+ *
+ * Each thread performs iters operations of the chosen primitive (slow
+ * ones like create and sleep do iters/100).  For every bench and thread
+ * count one line is printed:
+ *
+ *   syncbench: <bench> threads <T> ops <N> ns/op <x> handoffs/op <y>
+ *
+ * ns/op is wall time of the measured phase divided by the total number of
+ * operations.  A handoff is an operation completed by a different thread
+ * than the previous one; handoffs/op near 1 means the primitive ping-pongs
+ * between threads on every op (what round robin forces), near 0 means
+ * threads run long batches undisturbed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <semaphore.h>
+
+#if defined(ENABLE_DMP)
+  #include "dmp.h"
+#else
+  #include <pthread.h>
+#endif
+
+#include "tern/user.h"
+
+#define MAX (100)
+
+int T; // number of threads
+long I = 100000; // iterations per thread
+
+pthread_t th[MAX];
+pthread_barrier_t start;
+
+pthread_mutex_t mu;
+pthread_cond_t cv[MAX];
+pthread_barrier_t bar;
+pthread_rwlock_t rw;
+sem_t sem[MAX];
+volatile int token;
+
+volatile int last_owner;
+volatile long handoffs;
+
+static inline void note(long tid) {
+  if (__sync_lock_test_and_set(&last_owner, (int)tid) != tid)
+    __sync_fetch_and_add(&handoffs, 1);
+}
+
+static long iters(long div) {
+  return I / div > 0 ? I / div : 1;
+}
+
+void *mutex_func(void *arg) {
+  long tid = (long)arg;
+  pthread_barrier_wait(&start);
+  for(long i=0; i<I; ++i) {
+    pthread_mutex_lock(&mu);
+    note(tid);
+    pthread_mutex_unlock(&mu);
+  }
+  return NULL;
+}
+
+void *trylock_func(void *arg) {
+  long tid = (long)arg;
+  pthread_barrier_wait(&start);
+  for(long i=0; i<I; ++i) {
+    while(pthread_mutex_trylock(&mu))
+      ;
+    note(tid);
+    pthread_mutex_unlock(&mu);
+  }
+  return NULL;
+}
+
+/* a token passes around the ring of threads; each thread sleeps on its own
+   condvar, so with two threads this is classic ping-pong. */
+void *condvar_func(void *arg) {
+  long tid = (long)arg;
+  pthread_barrier_wait(&start);
+  for(long i=0; i<I; ++i) {
+    pthread_mutex_lock(&mu);
+    while(token != tid)
+      pthread_cond_wait(&cv[tid], &mu);
+    note(tid);
+    token = (tid + 1) % T;
+    pthread_cond_signal(&cv[token]);
+    pthread_mutex_unlock(&mu);
+  }
+  return NULL;
+}
+
+/* same ring, but everybody sleeps on one condvar and is broadcast to */
+void *broadcast_func(void *arg) {
+  long tid = (long)arg;
+  pthread_barrier_wait(&start);
+  for(long i=0; i<I; ++i) {
+    pthread_mutex_lock(&mu);
+    while(token != tid)
+      pthread_cond_wait(&cv[0], &mu);
+    note(tid);
+    token = (tid + 1) % T;
+    pthread_cond_broadcast(&cv[0]);
+    pthread_mutex_unlock(&mu);
+  }
+  return NULL;
+}
+
+void *barrier_func(void *arg) {
+  long tid = (long)arg;
+  pthread_barrier_wait(&start);
+  for(long i=0; i<I; ++i) {
+    pthread_barrier_wait(&bar);
+    note(tid);
+  }
+  return NULL;
+}
+
+/* the ring again, passed with one semaphore per thread */
+void *sem_func(void *arg) {
+  long tid = (long)arg;
+  pthread_barrier_wait(&start);
+  for(long i=0; i<I; ++i) {
+    sem_wait(&sem[tid]);
+    note(tid);
+    sem_post(&sem[(tid + 1) % T]);
+  }
+  return NULL;
+}
+
+/* read-mostly: one write in ten */
+void *rwlock_func(void *arg) {
+  long tid = (long)arg;
+  pthread_barrier_wait(&start);
+  for(long i=0; i<I; ++i) {
+    if(i % 10 == 0)
+      pthread_rwlock_wrlock(&rw);
+    else
+      pthread_rwlock_rdlock(&rw);
+    note(tid);
+    pthread_rwlock_unlock(&rw);
+  }
+  return NULL;
+}
+
+void *child_func(void *arg) {
+  return arg;
+}
+
+void *create_func(void *arg) {
+  long tid = (long)arg;
+  pthread_barrier_wait(&start);
+  for(long i=0; i<iters(100); ++i) {
+    pthread_t child;
+    int ret = pthread_create(&child, NULL, child_func, NULL);
+    assert(!ret && "pthread_create() failed!");
+    pthread_join(child, NULL);
+    note(tid);
+  }
+  return NULL;
+}
+
+void *sleep_func(void *arg) {
+  long tid = (long)arg;
+  pthread_barrier_wait(&start);
+  for(long i=0; i<iters(100); ++i) {
+    usleep(1);
+    note(tid);
+  }
+  return NULL;
+}
+
+/* nobody ever signals, so every wait runs into its timeout */
+void *timedwait_func(void *arg) {
+  long tid = (long)arg;
+  pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER;
+  pthread_barrier_wait(&start);
+  for(long i=0; i<iters(100); ++i) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 1000;
+    if(ts.tv_nsec >= 1000000000) {
+      ts.tv_sec ++;
+      ts.tv_nsec -= 1000000000;
+    }
+    pthread_mutex_lock(&m);
+    int ret = pthread_cond_timedwait(&cv[tid], &m, &ts);
+    assert((ret == ETIMEDOUT || ret == 0) && "pthread_cond_timedwait() failed!");
+    pthread_mutex_unlock(&m);
+    note(tid);
+  }
+  return NULL;
+}
+
+struct bench_t {
+  const char *name;
+  void *(*func)(void *);
+  long div;      // ops per thread is I/div
+  int min_threads;
+};
+
+bench_t benches[] = {
+  {"mutex",     mutex_func,     1,   1},
+  {"trylock",   trylock_func,   1,   1},
+  {"condvar",   condvar_func,   1,   2},
+  {"broadcast", broadcast_func, 1,   2},
+  {"barrier",   barrier_func,   1,   1},
+  {"sem",       sem_func,       1,   1},
+  {"rwlock",    rwlock_func,    1,   1},
+  {"create",    create_func,    100, 1},
+  {"sleep",     sleep_func,     100, 1},
+  {"timedwait", timedwait_func, 100, 1},
+};
+const int nbenches = sizeof(benches)/sizeof(benches[0]);
+
+void setup(int nthreads) {
+  pthread_mutex_init(&mu, NULL);
+  pthread_rwlock_init(&rw, NULL);
+  pthread_barrier_init(&bar, NULL, nthreads);
+  pthread_barrier_init(&start, NULL, nthreads + 1);
+  for(int i=0; i<nthreads; ++i) {
+    pthread_cond_init(&cv[i], NULL);
+    sem_init(&sem[i], 0, i == 0);
+  }
+  token = 0;
+  last_owner = -1;
+  handoffs = 0;
+}
+
+void teardown(int nthreads) {
+  pthread_mutex_destroy(&mu);
+  pthread_rwlock_destroy(&rw);
+  pthread_barrier_destroy(&bar);
+  pthread_barrier_destroy(&start);
+  for(int i=0; i<nthreads; ++i) {
+    pthread_cond_destroy(&cv[i]);
+    sem_destroy(&sem[i]);
+  }
+}
+
+double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1E9 + ts.tv_nsec;
+}
+
+void run(bench_t *b, int nthreads) {
+  int ret;
+
+  if(nthreads < b->min_threads) {
+    printf("syncbench: %-10s threads %3d skipped (needs %d threads)\n",
+           b->name, nthreads, b->min_threads);
+    return;
+  }
+
+  T = nthreads;
+  setup(nthreads);
+  for(long i=0; i<nthreads; ++i) {
+    ret = pthread_create(&th[i], NULL, b->func, (void*)i);
+    assert(!ret && "pthread_create() failed!");
+  }
+  // read the clock before releasing the threads; the main thread may be
+  // woken from the barrier long after they are done
+  double begin = now_ns();
+  pthread_barrier_wait(&start);
+  for(int i=0; i<nthreads; ++i)
+    pthread_join(th[i], NULL);
+  double elapsed = now_ns() - begin;
+  teardown(nthreads);
+
+  long ops = iters(b->div) * nthreads;
+  printf("syncbench: %-10s threads %3d ops %10ld ns/op %12.1f handoffs/op %.3f\n",
+         b->name, nthreads, ops, elapsed / ops, (double)handoffs / ops);
+  fflush(stdout);
+}
+
+void usage(const char *prog) {
+  fprintf(stderr, "usage: %s <bench>[,<bench>...]|all <threads>[,<threads>...] [iters]\n"
+          "benches:", prog);
+  for(int i=0; i<nbenches; ++i)
+    fprintf(stderr, " %s", benches[i].name);
+  fprintf(stderr, "\n");
+  exit(1);
+}
+
+extern "C" int main(int argc, char * argv[]);
+int main(int argc, char *argv[]) {
+  if(argc != 3 && argc != 4)
+    usage(argv[0]);
+  if(argc == 4)
+    I = atol(argv[3]);
+
+  bool selected[nbenches];
+  memset(selected, 0, sizeof(selected));
+  char *names = strdup(argv[1]);
+  for(char *s = strtok(names, ","); s; s = strtok(NULL, ",")) {
+    bool found = false;
+    for(int i=0; i<nbenches; ++i)
+      if(!strcmp(s, "all") || !strcmp(s, benches[i].name))
+        selected[i] = found = true;
+    if(!found) {
+      fprintf(stderr, "unknown bench '%s'\n", s);
+      usage(argv[0]);
+    }
+  }
+  free(names);
+
+  for(int i=0; i<nbenches; ++i) {
+    if(!selected[i])
+      continue;
+    char *counts = strdup(argv[2]);
+    for(char *s = strtok(counts, ","); s; s = strtok(NULL, ",")) {
+      int nthreads = atoi(s);
+      assert(nthreads > 0 && nthreads <= MAX);
+      run(&benches[i], nthreads);
+    }
+    free(counts);
+  }
+  return 0;
+}
@@ -119,6 +119,18 @@ extern "C" void tern_set_base_timeval(struct timeval *tv){
 }
 #endif
 
+// inserted by eval/sync-instr before a sync op that may keep the turn
+#ifndef __SPEC_HOOK_tern_coalesce_next
+extern "C" void tern_coalesce_next(unsigned insid){
+#ifdef __USE_TERN_RUNTIME
+  if (Space::isApp() && options::DMT) {
+    tern_coalesce_next_real(insid);
+  }
+#endif
+  // If not runnning with xtern, NOP.
+}
+#endif
+
 #ifndef __SPEC_HOOK_tern_detach
 extern "C" void tern_detach(){
 #ifdef __USE_TERN_RUNTIME
@@ -21,6 +21,7 @@
 #include <cstring>
 #include <string>
 #include <set>
+#include <vector>
 #include <dlfcn.h>
 #include <execinfo.h>
 #include <assert.h>
@@ -31,6 +32,8 @@ string func_pattern;
 string void_func_pattern;
 set<string> filter;
 string libPathPrefix;
+vector<string> table_funcs;  // one resolution table slot per hooked function
+vector<string> table_libs;
 
 void init_filter()
 {
@@ -85,7 +88,7 @@ void replace(string &st, string pat, string tobe)
 }
 
 void print_func(
-	FILE *file,
+	string &out,
 	const char *func_ret_type,
 	const char *func_name, 
 	const char *args_with_name, 
@@ -97,6 +100,9 @@ void print_func(
 	string pattern = !strcmp(func_ret_type, "void") ? void_func_pattern : func_pattern;
 	replace(pattern, "FUNC_RET_TYPE", func_ret_type);
 	replace(pattern, "FUNC_NAME", func_name);
+	// tern_direct_* prepend an insid parameter
+	if (!strlen(args_with_name) || !strcmp(args_with_name, "void"))
+		replace(pattern, ", ARGS_WITH_NAME", "");
 	replace(pattern, "ARGS_WITH_NAME", args_with_name);
 	replace(pattern, "ARGS_WITHOUT_NAME", args_without_name);
 	if (!strlen(args_only_name))
@@ -107,7 +113,91 @@ void print_func(
     replace(pattern, "ARGS_ONLY_NAME", args_only_name);
     std::string path =libPathPrefix + lib_path;
     replace(pattern, "LIB_PATH", path.c_str());
-    fprintf(file, "%s", pattern.c_str());
+    out += pattern;
+    table_funcs.push_back(func_name);
+    table_libs.push_back(path);
+}
+
+// The wrappers call the real functions through __hook_table, which a
+// constructor fills with dlsym(RTLD_NEXT, ...) before main() runs, so a
+// wrapper is just a load and an indirect call.  A hook called even earlier
+// (from another library's constructor) resolves its slot on the spot;
+// dlsym always returns the same pointer, so racing threads store the same
+// value.  Functions RTLD_NEXT cannot see, because the app did not link
+// their library, come from dlopen(LIB_PATH) as before.
+//
+// glibc keeps the LinuxThreads pthread_cond_* at GLIBC_2.2.5 (x86_64) or
+// GLIBC_2.0 (i386) next to the default GLIBC_2.3.2 ones, and before 2.34
+// dlsym(RTLD_NEXT, ...) may bind the old version, whose pthread_cond_t
+// layout differs; those are looked up with dlvsym() instead.  Once the
+// constructor has filled every slot, the table is made read-only.
+void print_table(FILE *file)
+{
+  size_t n = table_funcs.size();
+  fprintf(file, "// generated by code_gen from hook_func.def\n");
+  fprintf(file, "enum {\n");
+  for (size_t i = 0; i < n; ++i)
+    fprintf(file, "  __hook_%s,\n", table_funcs[i].c_str());
+  fprintf(file, "  __hook_num_funcs\n};\n\n");
+  fprintf(file, "static const char *const __hook_names[] = {\n");
+  for (size_t i = 0; i < n; ++i)
+    fprintf(file, "  \"%s\",\n", table_funcs[i].c_str());
+  fprintf(file, "};\n\n");
+  fprintf(file, "static const char *const __hook_libs[] = {\n");
+  for (size_t i = 0; i < n; ++i)
+    fprintf(file, "  \"%s\",\n", table_libs[i].c_str());
+  fprintf(file, "};\n\n");
+  fprintf(file, "static const char *const __hook_versions[] = {\n");
+  for (size_t i = 0; i < n; ++i)
+    if (table_funcs[i].compare(0, 13, "pthread_cond_") == 0)
+      fprintf(file, "  \"GLIBC_2.3.2\",\n");
+    else
+      fprintf(file, "  NULL,\n");
+  fprintf(file, "};\n\n");
+  fprintf(file,
+    "#include <sys/mman.h>\n"
+    "#include <unistd.h>\n"
+    "\n"
+    "#define __HOOK_PAGE 4096\n"
+    "static union {\n"
+    "  void *fn[__hook_num_funcs];\n"
+    "  char pad[(__hook_num_funcs * sizeof(void *) + __HOOK_PAGE - 1)\n"
+    "           / __HOOK_PAGE * __HOOK_PAGE];\n"
+    "} __hook_slots __attribute__((aligned(__HOOK_PAGE)));\n"
+    "#define __hook_table __hook_slots.fn\n"
+    "\n"
+    "static void *__hook_resolve(int idx) {\n"
+    "  void *f = NULL;\n"
+    "  if (__hook_versions[idx])\n"
+    "    f = dlvsym(RTLD_NEXT, __hook_names[idx], __hook_versions[idx]);\n"
+    "  if (!f)\n"
+    "    f = dlsym(RTLD_NEXT, __hook_names[idx]);\n"
+    "  if (!f) {\n"
+    "    void *handle = dlopen(__hook_libs[idx], RTLD_LAZY);\n"
+    "    if (!handle) {\n"
+    "      fprintf(stderr, \"dlopen %%s: %%s\\n\", __hook_libs[idx], dlerror());\n"
+    "      abort();\n"
+    "    }\n"
+    "    f = dlsym(handle, __hook_names[idx]);\n"
+    "  }\n"
+    "  if (!f) {\n"
+    "    fprintf(stderr, \"dlsym %%s: %%s\\n\", __hook_names[idx], dlerror());\n"
+    "    abort();\n"
+    "  }\n"
+    "  __hook_table[idx] = f;\n"
+    "  return f;\n"
+    "}\n"
+    "\n"
+    "__attribute__((constructor(101)))\n"
+    "static void __hook_resolve_all(void) {\n"
+    "  for (int i = 0; i < __hook_num_funcs; ++i)\n"
+    "    if (!__hook_table[i])\n"
+    "      __hook_resolve(i);\n"
+    "  // larger pages than __HOOK_PAGE: the table shares its page, leave it\n"
+    "  if (sysconf(_SC_PAGESIZE) == __HOOK_PAGE\n"
+    "      && mprotect(&__hook_slots, sizeof(__hook_slots), PROT_READ))\n"
+    "    perror(\"mprotect hook table\");\n"
+    "}\n\n");
 }
 
 char buffer[1024];
@@ -127,6 +217,7 @@ void convert(FILE *fin)
 {
   FILE *hook_cpp = fopen("template.cpp", "w");
   FILE *types = fopen("hook_type_def.h", "w");
+  string wrappers;
 /*
   fprintf(hook_cpp, "#include <pthread.h>\n");
 	fprintf(hook_cpp, "#include <stdio.h>\n");
@@ -206,7 +297,7 @@ void convert(FILE *fin)
       break;  		
 
     print_func(
-  	  hook_cpp,
+  	  wrappers,
     	func_ret_type.c_str(), 
   		func_name.c_str(), 
   		args_with_name.c_str(), 
@@ -221,6 +312,9 @@ void convert(FILE *fin)
       func_name.c_str(), 
       args_with_name.c_str());
 	}
+  // the table goes first; every wrapper refers to it
+  print_table(hook_cpp);
+  fprintf(hook_cpp, "%s", wrappers.c_str());
   fclose(hook_cpp);
   fclose(types);
 }
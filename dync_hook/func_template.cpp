@@ -21,30 +21,13 @@
 extern "C" FUNC_RET_TYPE FUNC_NAME(ARGS_WITH_NAME){
   typedef FUNC_RET_TYPE (*orig_func_type)(ARGS_WITHOUT_NAME);
 
-  static orig_func_type orig_func;
+  orig_func_type orig_func = (orig_func_type) __hook_table[__hook_FUNC_NAME];
+  if (__builtin_expect(!orig_func, 0))
+    orig_func = (orig_func_type) __hook_resolve(__hook_FUNC_NAME);
 
-  void * handle;
   FUNC_RET_TYPE ret;
   void *eip = 0;
 
-  if (!orig_func) {
-    if(!(handle=dlopen("LIB_PATH", RTLD_LAZY))) {
-      perror("dlopen");
-      puts("here dlopen");
-      abort();
-    }
-
-    orig_func = (orig_func_type) dlsym(handle, "FUNC_NAME");
-
-    if(dlerror()) {
-      perror("dlsym");
-      puts("here dlsym");
-      abort();
-    }
-
-    dlclose(handle);
-  }
-
 #ifdef __USE_TERN_RUNTIME
   if (Space::isApp()) {
     if (options::DMT) {
@@ -52,7 +35,7 @@ extern "C" FUNC_RET_TYPE FUNC_NAME(ARGS_WITH_NAME){
 #ifdef __NEED_INPUT_INSID
       if (options::dync_geteip) {
         Space::enterSys();
-        eip = get_eip();
+        eip = get_eip(__builtin_return_address(0), __builtin_frame_address(0));
         Space::exitSys();
       }
       record_rdtsc_op("FUNC_NAME", "START", 0, eip);
@@ -65,7 +48,7 @@ extern "C" FUNC_RET_TYPE FUNC_NAME(ARGS_WITH_NAME){
     } else {// For performance debugging, by doing this, we are still able to get the sync wait time for non-det mode.
       if (options::dync_geteip) {
         Space::enterSys();
-        eip = get_eip();
+        eip = get_eip(__builtin_return_address(0), __builtin_frame_address(0));
         Space::exitSys();
       }
       record_rdtsc_op("FUNC_NAME", "START", 0, eip);
@@ -82,5 +65,37 @@ extern "C" FUNC_RET_TYPE FUNC_NAME(ARGS_WITH_NAME){
 
   return ret;
 }
+
+#if defined(__USE_TERN_RUNTIME) && defined(__NEED_INPUT_INSID)
+// Called instead of FUNC_NAME by programs rewritten with
+// eval/sync-instr, which passes a constant @insid for the call site.  It
+// makes the same Space and options::DMT checks as the wrapper above, so
+// rewritten calls behave like hooked ones.
+extern "C" FUNC_RET_TYPE tern_direct_FUNC_NAME(unsigned insid, ARGS_WITH_NAME){
+  typedef FUNC_RET_TYPE (*orig_func_type)(ARGS_WITHOUT_NAME);
+
+  orig_func_type orig_func = (orig_func_type) __hook_table[__hook_FUNC_NAME];
+  if (__builtin_expect(!orig_func, 0))
+    orig_func = (orig_func_type) __hook_resolve(__hook_FUNC_NAME);
+
+  FUNC_RET_TYPE ret;
+  if (Space::isApp()) {
+    record_rdtsc_op("FUNC_NAME", "START", 0, (void*)(uint64_t) insid);
+    if (options::DMT)
+      ret = tern_FUNC_NAME(insid, ARGS_ONLY_NAME);
+    else {
+      Space::enterSys();
+      ret = orig_func(ARGS_ONLY_NAME);
+      Space::exitSys();
+    }
+    record_rdtsc_op("FUNC_NAME", "END", 0, (void*)(uint64_t) insid);
+    return ret;
+  }
+
+  ret = orig_func(ARGS_ONLY_NAME);
+
+  return ret;
+}
+#endif
 #endif
 
@@ -31,6 +31,7 @@
 #include <tern/space.h>
 #include <tern/options.h>
 #include <tern/runtime/runtime.h>
+#include <tern/runtime/callsite.h>
 
 using namespace tern;
 
@@ -85,32 +86,13 @@ static void print_stack()
 #endif
 }
 
-void *get_eip()
+// @ret_addr and @frame are the calling wrapper's __builtin_return_address(0)
+// and __builtin_frame_address(0); see tern/runtime/callsite.h.
+void *get_eip(void *ret_addr, void *frame)
 {
-  // Change this "idx" to be 2 when pthread_*() functions are called by 
-  // application code directly; and change it to be 3 when pthread_*()
-  // functions are called by the app's wrapper functions.
-  const int idx = 2;
-  const int len = 5;
-  void *tracePtrs[len];
-  int i;
-  uint64_t ret = 0; 
-  /* Fixme: sometimes after fork(), the child process may hang (100% cpu) here, weird.
-  Saw this case when running the simple-fork-test.c testcase. */
-  int count = backtrace(tracePtrs, len);
-      
   if (options::whole_stack_eip_signature)
-  {
-    ret = 0;
-    for (i = 0; i < count; ++i)
-      ret = ret * 97 + (uint64_t) tracePtrs[i];
-    return (void*) ret;
-    //std::cout << std::hex << tracePtrs[2] << std::dec << std::endl;
-    //char** funcNames = backtrace_symbols( tracePtrs, count );
-    //printf( "%s\n", funcNames[2] );
-    //printf(stderr, "reteip: %p\n", tracePtrs[1]);
-  } else
-    return tracePtrs[idx];  //  this is ret_eip of my caller
+    return (void*) stackSignature(frame);
+  return ret_addr;  //  the app's call site
 }
 
 #include "spec_hooks.cpp"
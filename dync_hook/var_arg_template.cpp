@@ -55,7 +55,7 @@ extern "C" int fcntl(int fd, int cmd, ...){
 #ifdef __NEED_INPUT_INSID
       if (options::dync_geteip) {
         Space::enterSys();
-        eip = get_eip();
+        eip = get_eip(__builtin_return_address(0), __builtin_frame_address(0));
         Space::exitSys();
       }
       record_rdtsc_op("fcntl", "START", 0, eip);
@@ -68,7 +68,7 @@ extern "C" int fcntl(int fd, int cmd, ...){
     } else {// For performance debugging, by doing this, we are still able to get the sync wait time for non-det mode.
       if (options::dync_geteip) {
         Space::enterSys();
-        eip = get_eip();
+        eip = get_eip(__builtin_return_address(0), __builtin_frame_address(0));
         Space::exitSys();
       }
       record_rdtsc_op("fcntl", "START", 0, eip);
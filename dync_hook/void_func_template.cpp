@@ -20,26 +20,11 @@
 extern "C" void FUNC_NAME(ARGS_WITH_NAME){
   typedef int (*orig_func_type)(ARGS_WITHOUT_NAME);
 
-  orig_func_type orig_func;
-  void * handle;
+  orig_func_type orig_func = (orig_func_type) __hook_table[__hook_FUNC_NAME];
+  if (__builtin_expect(!orig_func, 0))
+    orig_func = (orig_func_type) __hook_resolve(__hook_FUNC_NAME);
   void *eip = 0;
 
-  if(!(handle=dlopen("LIB_PATH", RTLD_LAZY))) {
-    perror("dlopen");
-    puts("here dlopen");
-    abort();
-  }
-
-  orig_func = (orig_func_type) dlsym(handle, "FUNC_NAME");
-
-  if(dlerror()) {
-    perror("dlsym");
-    puts("here dlsym");
-    abort();
-  }
-
-  dlclose(handle);
-
 #ifdef __USE_TERN_RUNTIME
   if (Space::isApp()) {
     if (options::DMT) {
@@ -47,7 +32,7 @@ extern "C" void FUNC_NAME(ARGS_WITH_NAME){
 #ifdef __NEED_INPUT_INSID
       if (options::dync_geteip) {
         Space::enterSys();
-        eip = get_eip();
+        eip = get_eip(__builtin_return_address(0), __builtin_frame_address(0));
         Space::exitSys();
       }
       record_rdtsc_op("FUNC_NAME", "START", 0, eip);
@@ -60,7 +45,7 @@ extern "C" void FUNC_NAME(ARGS_WITH_NAME){
     } else {// For performance debugging, by doing this, we are still able to get the sync wait time for non-det mode.
       if (options::dync_geteip) {
         Space::enterSys();
-        eip = get_eip();
+        eip = get_eip(__builtin_return_address(0), __builtin_frame_address(0));
         Space::exitSys();
       }
       record_rdtsc_op("FUNC_NAME", "START", 0, eip);
@@ -76,4 +61,30 @@ extern "C" void FUNC_NAME(ARGS_WITH_NAME){
 
   orig_func(ARGS_ONLY_NAME);
 }
+
+#if defined(__USE_TERN_RUNTIME) && defined(__NEED_INPUT_INSID)
+// see tern_direct_* in func_template.cpp
+extern "C" void tern_direct_FUNC_NAME(unsigned insid, ARGS_WITH_NAME){
+  typedef int (*orig_func_type)(ARGS_WITHOUT_NAME);
+
+  orig_func_type orig_func = (orig_func_type) __hook_table[__hook_FUNC_NAME];
+  if (__builtin_expect(!orig_func, 0))
+    orig_func = (orig_func_type) __hook_resolve(__hook_FUNC_NAME);
+
+  if (Space::isApp()) {
+    record_rdtsc_op("FUNC_NAME", "START", 0, (void*)(uint64_t) insid);
+    if (options::DMT)
+      tern_FUNC_NAME(insid, ARGS_ONLY_NAME);
+    else {
+      Space::enterSys();
+      orig_func(ARGS_ONLY_NAME);
+      Space::exitSys();
+    }
+    record_rdtsc_op("FUNC_NAME", "END", 0, (void*)(uint64_t) insid);
+    return;
+  }
+
+  orig_func(ARGS_ONLY_NAME);
+}
+#endif
 #endif
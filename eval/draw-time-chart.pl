@@ -22,12 +22,16 @@
 # Usage: ./draw-time-chart.pl <directory which stores a recorded schedule from one execution>
 # E.g., ./draw-time-chart.pl ./out
 
+use Cwd 'abs_path';
+use File::Basename;
+
 $numThreads = 0;
 %totalEvents;
 %tids;
 $curDir;
 $threadMargin = "                                                  "; # 40 blanks.
 $skipTid1 = 1;
+$scriptDir = dirname(abs_path($0));
 $outputTime = 1;
 if (scalar(@ARGV) >= 2 && @ARGV[1] eq "--keep-tid1") {
 	$skipTid1 = 0;
@@ -51,10 +55,16 @@ sub parseSchedule {
 	my @fields2;
 	
 	chdir($dirPath);
+	# log_type = async writes one binary log; turn it into tid-*.txt first.
+	if (glob("sync-log*.bin")) {
+		system("$scriptDir/sync-log-to-txt.py .") == 0
+			or die "can't convert sync-log*.bin\n";
+	}
 	opendir (DIR, ".");
 	while (my $file = readdir(DIR)) {
 		next if ($file =~ m/^\./);
 		next if ($file =~ m/\.log/);
+		next if ($file =~ m/\.bin$/);
 		#print "$file\n";
 
 		@fields1 = split(/-/, $file);
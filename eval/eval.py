@@ -239,6 +239,32 @@ def write_other_stats(nondet, repeats, name):
         stats.write('{2}-overhead: {1:.3f}%\n\tavg {0}\n'.format(overhead_avg, overhead_avg*100, name))
         stats.write('{2}:\n\tavg {0}\n\tsem {1}\n'.format(avg, std/math.sqrt(repeats), name))
 
+LOADGEN_PERCENTILES = ['p50', 'p90', 'p99', 'p99.9', 'max']
+
+def get_latency(out_dir, repeats):
+    # percentile -> [us per run], from eval/loadgen output in the client logs
+    latency = {}
+    for i in range(int(repeats)):
+        log_file_name = '%s/client.%d' % (out_dir, i)
+        if not checkExist(log_file_name, os.R_OK):
+            continue
+        for line in open(log_file_name, 'r'):
+            if line.startswith('loadgen: latency us '):
+                fields = line.split()[3:]
+                for name, value in zip(fields[0::2], fields[1::2]):
+                    latency.setdefault(name, []).append(float(value))
+    return latency
+
+def write_latency_stats(xtern, nondet):
+    import evalstats
+    with open("stats.txt", "a") as stats:
+        stats.write('latency (us, median of runs):\n')
+        for p in LOADGEN_PERCENTILES:
+            if p in xtern and p in nondet:
+                x = evalstats.median(xtern[p])
+                n = evalstats.median(nondet[p])
+                stats.write('\t{0:<6} xtern {1:.1f} non-det {2:.1f} ({3:.2f}x)\n'.format(
+                    p, x, n, x / n if n else float('nan')))
 
 def copy_required_files(app, files):
     for f in files.split():
@@ -335,43 +361,67 @@ def preSetting(config, bench, apps_name):
         return
     
  
+def runOnce(cmd, out_dir, i, prefix='output',
+            client_cmd="", client_terminate_server=False,
+            init_env_cmd=""):
+    # warmup runs log to warmup.N, client-warmup.N and out-warmup.N
+    suffix = '' if prefix == 'output' else '-' + prefix
+    with open('%s/%s.%d' % (out_dir, prefix, i), 'w', 102400) as log_file:
+        if init_env_cmd:
+            os.system(init_env_cmd)
+        #proc = subprocess.Popen(xtern_command, stdout=sys.stdout, stderr=sys.stdout,
+        proc = subprocess.Popen(cmd, stdout=log_file, stderr=subprocess.STDOUT,
+                                shell=True, executable=bash_path, bufsize = 102400, preexec_fn=os.setsid)
+        if client_cmd:
+            time.sleep(1)
+            with open('%s/client%s.%d' % (out_dir, suffix, i), 'w', 102400) as client_log_file:
+                client_proc = subprocess.Popen(client_cmd, stdout=client_log_file, stderr=subprocess.STDOUT,
+                                               shell=True, executable=bash_path, bufsize = 102400)
+                client_proc.wait()
+            if client_terminate_server:
+                os.killpg(proc.pid, signal.SIGTERM)
+            proc.wait()
+            time.sleep(2)
+        else:
+            try: # TODO should handle whole block
+                proc.wait()
+            except KeyboardInterrupt as k:
+                try:
+                    os.killpg(proc.pid, signal.SIGTERM)
+                except:
+                    pass
+                raise k
+
+    # move log files into 'xtern' directory
+    try:
+        os.renames('out', '%s/out%s.%d' % (out_dir, suffix, i))
+    except OSError:
+        pass
+
 def execBench(cmd, repeats, out_dir,
               client_cmd="", client_terminate_server=False,
               init_env_cmd=""):
     mkdir_p(out_dir)
     for i in range(int(repeats)):
         sys.stderr.write("        PROGRESS: %5d/%d\r" % (i+1, int(repeats))) # progress
-        with open('%s/output.%d' % (out_dir, i), 'w', 102400) as log_file:
-            if init_env_cmd:
-                os.system(init_env_cmd)
-            #proc = subprocess.Popen(xtern_command, stdout=sys.stdout, stderr=sys.stdout,
-            proc = subprocess.Popen(cmd, stdout=log_file, stderr=subprocess.STDOUT,
-                                    shell=True, executable=bash_path, bufsize = 102400, preexec_fn=os.setsid)
-            if client_cmd:
-                time.sleep(1)
-                with open('%s/client.%d' % (out_dir, i), 'w', 102400) as client_log_file:
-                    client_proc = subprocess.Popen(client_cmd, stdout=client_log_file, stderr=subprocess.STDOUT,
-                                                   shell=True, executable=bash_path, bufsize = 102400)
-                    client_proc.wait()
-                if client_terminate_server:
-                    os.killpg(proc.pid, signal.SIGTERM)
-                proc.wait()
-                time.sleep(2)
+        runOnce(cmd, out_dir, i, 'output', client_cmd, client_terminate_server, init_env_cmd)
+
+def execInterleaved(runs, repeats, warmup, init_env_cmd=""):
+    # runs: [(cmd, out_dir, client_cmd, client_terminate_server), ...]
+    # Alternate the order every round (ABBA...) so that drift in machine
+    # state hits every configuration alike.  The first @warmup rounds
+    # go to warmup.N and are not counted.
+    for cmd, out_dir, client_cmd, client_terminate_server in runs:
+        mkdir_p(out_dir)
+    total = warmup + int(repeats)
+    for r in range(total):
+        sys.stderr.write("        PROGRESS: %5d/%d\r" % (r+1, total)) # progress
+        order = runs if r % 2 == 0 else list(reversed(runs))
+        for cmd, out_dir, client_cmd, client_terminate_server in order:
+            if r < warmup:
+                runOnce(cmd, out_dir, r, 'warmup', client_cmd, client_terminate_server, init_env_cmd)
             else:
-                try: # TODO should handle whole block
-                    proc.wait()
-                except KeyboardInterrupt as k:
-                    try:
-                        os.killpg(proc.pid, signal.SIGTERM)
-                    except:
-                        pass
-                    raise k
-
-        # move log files into 'xtern' directory
-        try:
-            os.renames('out', '%s/out.%d' % (out_dir, i))
-        except OSError:
-            pass
+                runOnce(cmd, out_dir, r - warmup, 'output', client_cmd, client_terminate_server, init_env_cmd)
 
 def processBench(config, bench):
     # slient the output in parallel model-checking
@@ -447,8 +497,9 @@ def processBench(config, bench):
     else:
         xtern_command = ' '.join(['time', XTERN_PRELOAD, export, exec_file] + inputs.split())
     logging.info("executing '%s'" % xtern_command)
-    if not args.compare_only:
+    if not args.compare_only and not args.stats:
         execBench(xtern_command, repeats, 'xtern', client_cmd, client_terminate_server, init_env_cmd)
+    xtern_client_cmd = client_cmd
 
     client_cmd = config.get(bench, 'C_CMD')
     if client_cmd:
@@ -461,9 +512,16 @@ def processBench(config, bench):
     else:
         nondet_command = ' '.join(['time', RAND_PRELOAD, export, exec_file] + inputs.split())
     logging.info("executing '%s'" % nondet_command)
-    if not args.compare_only:
+    if not args.compare_only and not args.stats:
         execBench(nondet_command, repeats, 'non-det', client_cmd, client_terminate_server, init_env_cmd)
 
+    # --stats: the two runs take turns instead of going back to back
+    if not args.compare_only and args.stats:
+        logging.info("interleaving xtern and non-det, %d warmup round(s)" % args.warmup)
+        execInterleaved([(xtern_command, 'xtern', xtern_client_cmd, client_terminate_server),
+                         (nondet_command, 'non-det', client_cmd, client_terminate_server)],
+                        repeats, args.warmup, init_env_cmd)
+
     # run additional benchmark for dthreads
     dthread = config.get(bench, 'DTHREADS')
     if dthread:
@@ -555,6 +613,20 @@ def processBench(config, bench):
                 break
 
     write_stats(xtern_cost, nondet_cost, int(repeats))
+    xtern_latency = get_latency('xtern', repeats)
+    nondet_latency = get_latency('non-det', repeats)
+    if xtern_latency and nondet_latency:
+        write_latency_stats(xtern_latency, nondet_latency)
+    if args.stats:
+        import evalstats
+        summary = evalstats.summarize(xtern_cost, nondet_cost,
+                                      args.bootstrap, args.confidence)
+        if xtern_latency and nondet_latency:
+            summary['latency'] = evalstats.summarize_latency(
+                xtern_latency, nondet_latency, args.bootstrap, args.confidence)
+        evalstats.write_summary(summary, "stats.json")
+        logging.info(evalstats.format_summary(bench, summary))
+        stats_results[bench] = summary
     if dthread:
         write_other_stats(nondet_cost, int(repeats), 'dthreads')
     if dmp_o:
@@ -650,6 +722,33 @@ if __name__ == "__main__":
     parser.add_argument("--smtmc-only",
                         action="store_true",
                         help="run only run dbug+xtern model-checking in model-checking mode")
+    parser.add_argument("--stats",
+                        action="store_true",
+                        help="interleave xtern and non-det runs and report medians with bootstrap CIs (results.json)")
+    parser.add_argument("--warmup",
+                        default=1,
+                        type=int,
+                        metavar='NUM',
+                        help="rounds to run and discard before measuring (--stats only, default: 1)")
+    parser.add_argument("--pin",
+                        metavar='CPUS',
+                        help="pin every run to CPUS, in taskset -c syntax (e.g. 0-3)")
+    parser.add_argument("--bootstrap",
+                        default=1000,
+                        type=int,
+                        metavar='NUM',
+                        help="bootstrap resamples (--stats only, default: 1000)")
+    parser.add_argument("--confidence",
+                        default=0.95,
+                        type=float,
+                        help="confidence level of the intervals (--stats only, default: 0.95)")
+    parser.add_argument("--baseline",
+                        metavar='JSON',
+                        help="results.json of an earlier --stats run; fail on overhead regressions against it")
+    parser.add_argument("--threshold",
+                        default=0.05,
+                        type=float,
+                        help="relative overhead growth that counts as a regression (default: 0.05)")
     args = parser.parse_args()
 
     if args.filename.__len__() == 0:
@@ -660,6 +759,25 @@ if __name__ == "__main__":
     else:
         logging.debug('config files: ' + ', '.join(args.filename))
 
+    if args.baseline:
+        args.stats = True
+        # resolve now; the "current" symlink moves to the new run
+        args.baseline = os.path.realpath(args.baseline)
+    if args.stats and args.model_checking:
+        logging.error("--stats cannot be combined with model checking")
+        sys.exit(1)
+    if args.stats and args.warmup < 0:
+        logging.error("# of warmup rounds is %d", args.warmup)
+        sys.exit(1)
+
+    # children inherit the affinity, so pinning ourselves pins every run
+    if args.pin:
+        if subprocess.call(['taskset', '-pc', args.pin, str(os.getpid())],
+                           stdout=open(os.devnull, 'w')):
+            logging.error("cannot pin to cpus '%s'" % args.pin)
+            sys.exit(1)
+        logging.info("pinned to cpus %s" % args.pin)
+
     if args.model_checking:
         if args.parallel < 1:
             logging.error("# of processes is %d", args.parallel)
@@ -691,6 +809,7 @@ if __name__ == "__main__":
     default_options = getXternDefaultOptions()
     git_info = getGitInfo()
     root_dir = os.getcwd()
+    regressed = []
 
     for config_file in args.filename:
         logging.info("processing '" + config_file + "'")
@@ -720,6 +839,7 @@ if __name__ == "__main__":
                 diff.write(git_info[3])
         
         benchmarks = local_config.sections()
+        stats_results = {}
         all_threads = []
         semaphore = threading.BoundedSemaphore(args.parallel if args.model_checking else 1)
         log_lock = threading.Lock()
@@ -744,5 +864,18 @@ if __name__ == "__main__":
             for t in all_threads:
                 t.join()
 
+        if args.stats:
+            import evalstats
+            evalstats.write_summary(stats_results, "results.json")
+            logging.info("statistics written to %s/results.json" % run_dir)
+            if args.baseline:
+                regressed += evalstats.check_regressions(stats_results,
+                                                         args.baseline, args.threshold)
+
         os.chdir(root_dir)
+
+    if regressed:
+        logging.error("%d regression(s) against %s: %s" % (
+            len(regressed), args.baseline, ', '.join(regressed)))
+        sys.exit(1)
        
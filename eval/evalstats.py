@@ -0,0 +1,123 @@
+#!/usr/bin/env python
+
+
+#
+# Copyright (c) 2013,  Regents of the Columbia University 
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+# materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+
+# Statistics for eval.py --stats: medians, bootstrap confidence intervals
+# of the median and of the xtern/non-det overhead ratio, and regression
+# checks against a saved JSON baseline.
+
+import json
+import random
+import logging
+
+def median(values):
+    values = sorted(values)
+    n = len(values)
+    if n == 0:
+        return float('nan')
+    if n % 2:
+        return values[n // 2]
+    return (values[n // 2 - 1] + values[n // 2]) / 2.0
+
+def _percentile(sorted_values, q):
+    idx = int(round(q * (len(sorted_values) - 1)))
+    return sorted_values[max(0, min(len(sorted_values) - 1, idx))]
+
+def bootstrap_ci(samples, statistic, resamples=1000, confidence=0.95, seed=0):
+    """percentile bootstrap CI of statistic(*samples); each list in
+    samples is resampled independently"""
+    rng = random.Random(seed)
+    estimates = []
+    for _ in range(resamples):
+        resampled = [[s[rng.randrange(len(s))] for _ in s] for s in samples]
+        estimates.append(statistic(*resampled))
+    estimates.sort()
+    alpha = (1.0 - confidence) / 2
+    return [_percentile(estimates, alpha), _percentile(estimates, 1.0 - alpha)]
+
+def summarize(xtern, nondet, resamples=1000, confidence=0.95):
+    """summary of one bench: median and CI of each side and of the ratio"""
+    ratio = lambda x, n: median(x) / median(n)
+    result = {'confidence': confidence}
+    for name, samples in (('xtern', xtern), ('non-det', nondet)):
+        result[name] = {
+            'samples': samples,
+            'median': median(samples),
+            'ci': bootstrap_ci([samples], median, resamples, confidence),
+        }
+    result['overhead'] = {
+        'ratio': ratio(xtern, nondet),
+        'ci': bootstrap_ci([xtern, nondet], ratio, resamples, confidence),
+    }
+    return result
+
+def summarize_latency(xtern, nondet, resamples=1000, confidence=0.95):
+    """per latency percentile (dicts of name -> [value per run]): median
+    over runs of each side, with CIs"""
+    result = {}
+    for p in sorted(set(xtern) & set(nondet)):
+        result[p] = {}
+        for name, samples in (('xtern', xtern[p]), ('non-det', nondet[p])):
+            result[p][name] = {
+                'median': median(samples),
+                'ci': bootstrap_ci([samples], median, resamples, confidence),
+            }
+    return result
+
+def write_summary(summary, path):
+    with open(path, 'w') as f:
+        json.dump(summary, f, indent=2, sort_keys=True)
+
+def format_summary(bench, summary):
+    o = summary['overhead']
+    x = summary['xtern']
+    n = summary['non-det']
+    return ('%s: overhead %.3fx [%.3f, %.3f]  xtern %.3fs [%.3f, %.3f]'
+            '  non-det %.3fs [%.3f, %.3f]' % (bench,
+            o['ratio'], o['ci'][0], o['ci'][1],
+            x['median'], x['ci'][0], x['ci'][1],
+            n['median'], n['ci'][0], n['ci'][1]))
+
+def check_regressions(results, baseline_path, threshold):
+    """compare the overhead ratio of every bench in @results with the one
+    in the baseline file; a bench regresses when its ratio grew by more
+    than @threshold (relative) and the CIs do not overlap.  Returns the
+    list of regressed benches."""
+    with open(baseline_path) as f:
+        baseline = json.load(f)
+    regressed = []
+    for bench in sorted(results):
+        if bench not in baseline:
+            logging.info("%s: not in baseline" % bench)
+            continue
+        new = results[bench]['overhead']
+        old = baseline[bench]['overhead']
+        change = new['ratio'] / old['ratio'] - 1.0
+        msg = "%s: overhead %.3fx -> %.3fx (%+.1f%%)" % (
+            bench, old['ratio'], new['ratio'], change * 100)
+        if change > threshold and new['ci'][0] > old['ci'][1]:
+            logging.error("REGRESSION " + msg)
+            regressed.append(bench)
+        elif change < -threshold and new['ci'][1] < old['ci'][0]:
+            logging.info("improvement " + msg)
+        else:
+            logging.info(msg)
+    return regressed
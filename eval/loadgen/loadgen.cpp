@@ -0,0 +1,406 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* Closed-loop loopback load generator for the server apps.
+ *
+ * Every connection is a thread that sends one request, waits for the
+ * whole response, records the latency and sends the next, so the offered
+ * load adapts to the server and the latency tail shows turn waits and
+ * the blocking-op path directly.  Protocols: HTTP GET (mongoose, apache)
+ * and memcached get/set, text or binary.
+ *
+ * Output, parsed by eval.py:
+ *
+ *   loadgen: proto <p> conns <c> requests <n> errors <e> seconds <s> throughput <r> req/s
+ *   loadgen: latency us p50 <x> p90 <x> p99 <x> p99.9 <x> max <x>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+enum proto_t { HTTP, MC_TEXT, MC_BINARY };
+
+struct options_t {
+  proto_t proto;
+  const char *host;
+  int port;
+  int conns;            // concurrent closed-loop clients
+  long requests;        // total measured requests
+  long warmup;          // unmeasured requests per connection
+  const char *path;     // HTTP
+  bool reconnect;       // HTTP: new connection per request
+  double get_ratio;     // memcached
+  int keys;             // memcached
+  int value_size;       // memcached
+} opt = { HTTP, "127.0.0.1", 8080, 8, 10000, 10, "/", false, 0.9, 1000, 100 };
+
+struct client_t {
+  pthread_t th;
+  int id;
+  int fd;
+  unsigned seed;
+  long nreq;
+  long errors;
+  std::vector<uint64_t> lat;   // ns
+  std::string buf;             // bytes read past the current response
+};
+
+static uint64_t now_ns(void) {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static struct sockaddr_in server;
+
+static int connect_server(void) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    perror("loadgen: socket");
+    return -1;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  if (connect(fd, (struct sockaddr *)&server, sizeof(server)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static bool send_all(int fd, const char *p, size_t n) {
+  while (n > 0) {
+    ssize_t r = send(fd, p, n, MSG_NOSIGNAL);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      return false;
+    p += r;
+    n -= r;
+  }
+  return true;
+}
+
+/// read more bytes into @c->buf; false on error or EOF
+static bool fill(client_t *c) {
+  char tmp[16384];
+  ssize_t r;
+  do {
+    r = recv(c->fd, tmp, sizeof(tmp), 0);
+  } while (r < 0 && errno == EINTR);
+  if (r <= 0)
+    return false;
+  c->buf.append(tmp, r);
+  return true;
+}
+
+/// make sure @c->buf holds at least @n bytes
+static bool need(client_t *c, size_t n) {
+  while (c->buf.size() < n)
+    if (!fill(c))
+      return false;
+  return true;
+}
+
+/// position just past @delim in @c->buf, reading as needed; npos on error
+static size_t find(client_t *c, const char *delim, size_t from = 0) {
+  size_t pos;
+  while ((pos = c->buf.find(delim, from)) == std::string::npos)
+    if (!fill(c))
+      return std::string::npos;
+  return pos + strlen(delim);
+}
+
+static bool http_request(client_t *c) {
+  char req[1024];
+  int n = snprintf(req, sizeof(req),
+                   "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n\r\n",
+                   opt.path, opt.host, opt.reconnect ? "close" : "keep-alive");
+  if (!send_all(c->fd, req, n))
+    return false;
+
+  size_t hdr = find(c, "\r\n\r\n");
+  if (hdr == std::string::npos)
+    return false;
+  if (c->buf.compare(0, 5, "HTTP/") != 0)
+    return false;
+  std::string head = c->buf.substr(0, hdr);
+  for (size_t i = 0; i < head.size(); ++i)
+    head[i] = tolower(head[i]);
+  size_t cl = head.find("\r\ncontent-length:");
+  bool closing = head.find("\r\nconnection: close") != std::string::npos
+    || (head.compare(0, 8, "http/1.0") == 0
+        && head.find("\r\nconnection: keep-alive") == std::string::npos);
+  if (cl != std::string::npos) {
+    size_t len = strtoul(head.c_str() + cl + strlen("\r\ncontent-length:"), 0, 10);
+    if (!need(c, hdr + len))
+      return false;
+    c->buf.erase(0, hdr + len);
+  } else {
+    // no length: the body runs to EOF
+    while (fill(c))
+      ;
+    c->buf.clear();
+    closing = true;
+  }
+  if (closing || opt.reconnect) {
+    close(c->fd);
+    c->buf.clear();
+    c->fd = connect_server();
+  }
+  return true;
+}
+
+static void make_key(client_t *c, char *key, size_t n) {
+  snprintf(key, n, "loadgen:%d", rand_r(&c->seed) % opt.keys);
+}
+
+static bool mc_text_request(client_t *c) {
+  char key[64];
+  make_key(c, key, sizeof(key));
+  std::string req;
+  bool get = rand_r(&c->seed) < opt.get_ratio * RAND_MAX;
+  if (get) {
+    req = std::string("get ") + key + "\r\n";
+  } else {
+    char hdr[128];
+    snprintf(hdr, sizeof(hdr), "set %s 0 0 %d\r\n", key, opt.value_size);
+    req = hdr + std::string(opt.value_size, 'x') + "\r\n";
+  }
+  if (!send_all(c->fd, req.data(), req.size()))
+    return false;
+
+  if (!get) {
+    size_t end = find(c, "\r\n");
+    if (end == std::string::npos)
+      return false;
+    bool ok = c->buf.compare(0, 8, "STORED\r\n") == 0;
+    c->buf.erase(0, end);
+    return ok;
+  }
+  // VALUE <key> <flags> <bytes>\r\n<data>\r\n ... END\r\n
+  size_t pos = 0;
+  for (;;) {
+    size_t end = find(c, "\r\n", pos);
+    if (end == std::string::npos)
+      return false;
+    if (c->buf.compare(pos, 5, "END\r\n") == 0) {
+      c->buf.erase(0, end);
+      return true;
+    }
+    if (c->buf.compare(pos, 6, "VALUE ") != 0)
+      return false;
+    size_t sp = c->buf.rfind(' ', end - 2);
+    size_t bytes = strtoul(c->buf.c_str() + sp + 1, 0, 10);
+    pos = end + bytes + 2;
+    if (!need(c, pos))
+      return false;
+  }
+}
+
+/// memcached binary protocol header; all fields big endian
+struct mc_header_t {
+  uint8_t  magic;
+  uint8_t  opcode;
+  uint16_t keylen;
+  uint8_t  extlen;
+  uint8_t  datatype;
+  uint16_t status;     // vbucket in requests
+  uint32_t bodylen;
+  uint32_t opaque;
+  uint64_t cas;
+} __attribute__((packed));
+
+static bool mc_binary_request(client_t *c) {
+  char key[64];
+  make_key(c, key, sizeof(key));
+  size_t keylen = strlen(key);
+  bool get = rand_r(&c->seed) < opt.get_ratio * RAND_MAX;
+
+  mc_header_t h;
+  memset(&h, 0, sizeof(h));
+  h.magic = 0x80;
+  h.opcode = get ? 0x00 : 0x01;
+  h.keylen = htons(keylen);
+  h.extlen = get ? 0 : 8;      // set: flags + expiration
+  size_t body = h.extlen + keylen + (get ? 0 : opt.value_size);
+  h.bodylen = htonl(body);
+  std::string req((const char *)&h, sizeof(h));
+  if (!get)
+    req.append(8, '\0');
+  req.append(key, keylen);
+  if (!get)
+    req.append(opt.value_size, 'x');
+  if (!send_all(c->fd, req.data(), req.size()))
+    return false;
+
+  if (!need(c, sizeof(mc_header_t)))
+    return false;
+  mc_header_t r;
+  memcpy(&r, c->buf.data(), sizeof(r));
+  size_t total = sizeof(r) + ntohl(r.bodylen);
+  if (r.magic != 0x81 || !need(c, total))
+    return false;
+  c->buf.erase(0, total);
+  uint16_t status = ntohs(r.status);
+  return status == 0 || (get && status == 1);   // 1: key not found
+}
+
+static bool request(client_t *c) {
+  if (c->fd < 0 && (c->fd = connect_server()) < 0)
+    return false;
+  bool ok;
+  switch (opt.proto) {
+  case HTTP:      ok = http_request(c); break;
+  case MC_TEXT:   ok = mc_text_request(c); break;
+  default:        ok = mc_binary_request(c); break;
+  }
+  if (!ok && c->fd >= 0) {
+    close(c->fd);
+    c->fd = -1;
+    c->buf.clear();
+  }
+  return ok;
+}
+
+static void *client_func(void *arg) {
+  client_t *c = (client_t *)arg;
+  c->fd = connect_server();
+  for (long i = 0; i < opt.warmup; ++i)
+    request(c);
+  c->lat.reserve(c->nreq);
+  for (long i = 0; i < c->nreq; ++i) {
+    uint64_t start = now_ns();
+    if (request(c))
+      c->lat.push_back(now_ns() - start);
+    else
+      c->errors ++;
+  }
+  if (c->fd >= 0)
+    close(c->fd);
+  return NULL;
+}
+
+static double percentile(const std::vector<uint64_t> &v, double q) {
+  if (v.empty())
+    return 0;
+  size_t idx = (size_t)(q * (v.size() - 1) + 0.5);
+  return v[idx] / 1000.0;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+    "usage: %s [options]\n"
+    "  -p http|mc-text|mc-binary  protocol (default http)\n"
+    "  -H host                    server address (default 127.0.0.1)\n"
+    "  -P port                    server port (default 8080)\n"
+    "  -c conns                   concurrent connections (default 8)\n"
+    "  -n requests                measured requests in total (default 10000)\n"
+    "  -w warmup                  unmeasured requests per connection (default 10)\n"
+    "  -u path                    HTTP: path to GET (default /)\n"
+    "  -C                         HTTP: new connection for every request\n"
+    "  -g ratio                   memcached: fraction of gets (default 0.9)\n"
+    "  -k keys                    memcached: key space (default 1000)\n"
+    "  -s bytes                   memcached: value size of sets (default 100)\n",
+    prog);
+  exit(1);
+}
+
+int main(int argc, char *argv[]) {
+  int ch;
+  while ((ch = getopt(argc, argv, "p:H:P:c:n:w:u:Cg:k:s:h")) != -1) {
+    switch (ch) {
+    case 'p':
+      if (!strcmp(optarg, "http"))           opt.proto = HTTP;
+      else if (!strcmp(optarg, "mc-text"))   opt.proto = MC_TEXT;
+      else if (!strcmp(optarg, "mc-binary")) opt.proto = MC_BINARY;
+      else usage(argv[0]);
+      break;
+    case 'H': opt.host = optarg; break;
+    case 'P': opt.port = atoi(optarg); break;
+    case 'c': opt.conns = atoi(optarg); break;
+    case 'n': opt.requests = atol(optarg); break;
+    case 'w': opt.warmup = atol(optarg); break;
+    case 'u': opt.path = optarg; break;
+    case 'C': opt.reconnect = true; break;
+    case 'g': opt.get_ratio = atof(optarg); break;
+    case 'k': opt.keys = atoi(optarg); break;
+    case 's': opt.value_size = atoi(optarg); break;
+    default: usage(argv[0]);
+    }
+  }
+  if (opt.conns <= 0 || opt.requests <= 0 || opt.keys <= 0 || opt.value_size < 0)
+    usage(argv[0]);
+
+  struct hostent *he = gethostbyname(opt.host);
+  if (!he) {
+    fprintf(stderr, "loadgen: cannot resolve %s\n", opt.host);
+    return 1;
+  }
+  memset(&server, 0, sizeof(server));
+  server.sin_family = AF_INET;
+  server.sin_port = htons(opt.port);
+  memcpy(&server.sin_addr, he->h_addr_list[0], sizeof(server.sin_addr));
+
+  std::vector<client_t> clients(opt.conns);
+  uint64_t start = now_ns();
+  for (int i = 0; i < opt.conns; ++i) {
+    client_t &c = clients[i];
+    c.id = i;
+    c.fd = -1;
+    c.seed = i + 1;
+    c.nreq = opt.requests / opt.conns + (i < opt.requests % opt.conns);
+    c.errors = 0;
+    if (pthread_create(&c.th, NULL, client_func, &c)) {
+      perror("loadgen: pthread_create");
+      return 1;
+    }
+  }
+  std::vector<uint64_t> lat;
+  long errors = 0;
+  for (int i = 0; i < opt.conns; ++i) {
+    pthread_join(clients[i].th, NULL);
+    lat.insert(lat.end(), clients[i].lat.begin(), clients[i].lat.end());
+    errors += clients[i].errors;
+  }
+  double seconds = (now_ns() - start) / 1e9;
+  std::sort(lat.begin(), lat.end());
+
+  static const char *names[] = {"http", "mc-text", "mc-binary"};
+  printf("loadgen: proto %s conns %d requests %lu errors %ld seconds %.3f"
+         " throughput %.1f req/s\n", names[opt.proto], opt.conns,
+         (unsigned long)lat.size(), errors, seconds, lat.size() / seconds);
+  printf("loadgen: latency us p50 %.1f p90 %.1f p99 %.1f p99.9 %.1f max %.1f\n",
+         percentile(lat, 0.5), percentile(lat, 0.9), percentile(lat, 0.99),
+         percentile(lat, 0.999), lat.empty() ? 0 : lat.back() / 1000.0);
+  return errors && lat.empty() ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "sync-instr.h"
+using namespace tern;
+
+#include "llvm/DerivedTypes.h"
+#include "llvm/Constants.h"
+#include "llvm/IntrinsicInst.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/CallSite.h"
+#include "tern/syncfuncs.h"
+
+#include <stdio.h>
+#include <vector>
+using namespace std;
+using namespace llvm;
+
+static RegisterPass<SyncInstr> X(
+		"xtern-sync-instr",
+		"Rewrite sync calls into tern_direct_* calls",
+		false,
+		false);
+
+static cl::opt<bool> InstrSyscalls("xtern-sync-instr-syscalls",
+    cl::desc("also rewrite blocking syscalls (default on)"),
+    cl::init(true));
+
+static cl::opt<std::string> InsidMap("xtern-sync-instr-map",
+    cl::desc("write the insid of each rewritten call to this file"),
+    cl::init(""));
+
+// listed in tern/syncfuncs.def.h but not wrapped by dync_hook/hook_func.def,
+// so interpose.so has no tern_direct_* for them; keep calling libc.
+static const char *unhooked_ops[] = {
+  "getpeername",
+  "pthread_mutex_destroy",
+  "pthread_rwlock_destroy",
+  "pthread_rwlock_init"
+};
+
+char SyncInstr::ID = 0;
+
+SyncInstr::SyncInstr(): ModulePass(&ID), next_insid(1) {
+}
+
+SyncInstr::~SyncInstr() {
+}
+
+void SyncInstr::getAnalysisUsage(AnalysisUsage &AU) const {
+  ModulePass::getAnalysisUsage(AU);
+}
+
+void SyncInstr::init(Module &M) {
+  int_type = IntegerType::get(M.getContext(), 32);
+  sync_ops.clear();
+  sync_nrs.clear();
+# define DEF(func, kind, ...) \
+  sync_ops[#func] = syncfunc::kind; sync_nrs[#func] = syncfunc::func;
+# define DEFTERNAUTO(func)
+# define DEFTERNUSER(func)
+# include "tern/syncfuncs.def.h"
+# undef DEF
+# undef DEFTERNAUTO
+# undef DEFTERNUSER
+  for (unsigned i = 0; i < sizeof(unhooked_ops)/sizeof(unhooked_ops[0]); ++i)
+    sync_ops.erase(unhooked_ops[i]);
+}
+
+const string *SyncInstr::syncOp(CallInst *ci) {
+  Function *callee = ci->getCalledFunction();
+  // indirect calls, and an app's own definition of a sync op, stay
+  if (!callee || !callee->isDeclaration())
+    return NULL;
+  map<string, unsigned>::iterator it = sync_ops.find(callee->getName().str());
+  if (it == sync_ops.end())
+    return NULL;
+  if (it->second != syncfunc::Synchronization && !InstrSyscalls)
+    return NULL;
+  if (callee->getFunctionType()->isVarArg())
+    return NULL;
+  return &it->first;
+}
+
+bool SyncInstr::followedBySyncOp(CallInst *ci) {
+  BasicBlock::iterator i = ci;
+  for (++i; !isa<TerminatorInst>(i); ++i) {
+    if (isa<DbgInfoIntrinsic>(i))
+      continue;
+    if (CallInst *next = dyn_cast<CallInst>(i)) {
+      // an op that may pass through without the turn (time(), write() to
+      // a regular file, ...) would leave the kept turn held across the
+      // app code after it
+      const string *op = syncOp(next);
+      return op && syncfunc::takesTurn(sync_nrs[*op]);
+    }
+  }
+  return false;
+}
+
+bool SyncInstr::instrument(CallInst *ci, Module &M, FILE *insid_map) {
+  const string *op = syncOp(ci);
+  if (!op)
+    return false;
+  const FunctionType *fty = ci->getCalledFunction()->getFunctionType();
+
+  // tern_direct_<func>(unsigned insid, <args of func>)
+  vector<const Type *> params;
+  params.push_back(int_type);
+  for (unsigned i = 0; i < fty->getNumParams(); ++i)
+    params.push_back(fty->getParamType(i));
+  FunctionType *hook_fty = FunctionType::get(fty->getReturnType(), params, false);
+  Constant *hook = M.getOrInsertFunction("tern_direct_" + *op, hook_fty);
+  assert(hook);
+
+  unsigned insid = next_insid ++;
+  // the straight-line code up to the next sync op cannot wait for another
+  // thread, so this op may keep the turn (options::coalesce_ops)
+  if (syncfunc::takesTurn(sync_nrs[*op]) && followedBySyncOp(ci)) {
+    Constant *mark = M.getOrInsertFunction("tern_coalesce_next",
+        Type::getVoidTy(M.getContext()), int_type, NULL);
+    CallInst::Create(mark, ConstantInt::get(int_type, insid), "", ci);
+  }
+  vector<Value *> args;
+  args.push_back(ConstantInt::get(int_type, insid));
+  for (unsigned i = 0; i < ci->getNumOperands() - 1; ++i)
+    args.push_back(ci->getOperand(i + 1));
+  CallInst *hook_ci = CallInst::Create(hook, args.begin(), args.end(), "", ci);
+  hook_ci->setCallingConv(ci->getCallingConv());
+  hook_ci->takeName(ci);
+  ci->replaceAllUsesWith(hook_ci);
+  ci->eraseFromParent();
+
+  if (insid_map)
+    fprintf(insid_map, "%u %s %s\n", insid,
+            hook_ci->getParent()->getParent()->getNameStr().c_str(),
+            op->c_str());
+  return true;
+}
+
+bool SyncInstr::runOnModule(Module &M) {
+  init(M);
+
+  FILE *insid_map = NULL;
+  if (InsidMap != "") {
+    insid_map = fopen(InsidMap.c_str(), "w");
+    if (!insid_map)
+      perror(InsidMap.c_str());
+  }
+
+  // collect first; instrument() erases the calls it replaces.  Module,
+  // function and block order are fixed in the bitcode, so the same
+  // bitcode always gets the same insids.
+  vector<CallInst *> calls;
+  for (Module::iterator f = M.begin(), fe = M.end(); f != fe; ++f) {
+    if (f->isDeclaration() || f->getName().startswith("tern_"))
+      continue;
+    for (Function::iterator b = f->begin(), be = f->end(); b != be; ++b)
+      for (BasicBlock::iterator i = b->begin(), ie = b->end(); i != ie; ++i)
+        if (CallInst *ci = dyn_cast<CallInst>(i))
+          calls.push_back(ci);
+  }
+
+  unsigned n = 0;
+  for (size_t i = 0; i < calls.size(); ++i)
+    if (instrument(calls[i], M, insid_map))
+      ++ n;
+  if (insid_map)
+    fclose(insid_map);
+  fprintf(stderr, "xtern-sync-instr: rewrote %u sync calls\n", n);
+  return n > 0;
+}
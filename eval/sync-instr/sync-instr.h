@@ -0,0 +1,79 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __SYNC_INSTR_H
+#define __SYNC_INSTR_H
+
+#include "llvm/Pass.h"
+#include "llvm/Module.h"
+#include "llvm/Instructions.h"
+
+#include <stdio.h>
+#include <map>
+#include <string>
+
+namespace tern {
+  /// Rewrites direct calls to the sync ops and blocking syscalls listed in
+  /// tern/syncfuncs.def.h (pthread_*, sem_*, accept, recv, ...) into
+  /// calls to tern_direct_<op>(insid, args...), passing a constant insid.
+  /// tern_direct_<op> is generated into dync_hook/interpose.so next to the
+  /// <op> wrapper and makes the same Space::isApp() and options::DMT
+  /// checks, falling back to the real function, but it skips get_eip()
+  /// and gives every call site a small id that is stable across runs and
+  /// builds of the same bitcode, for the sync log, lineup and the
+  /// profilers.
+  ///
+  ///   opt -load sync-instr.so -xtern-sync-instr app.bc -o app.instr.bc
+  ///
+  /// The instrumented program is linked against dync_hook/interpose.so,
+  /// which provides tern_direct_* and still starts the runtime from its
+  /// __libc_start_main hook; calls the pass cannot see (from uninstrumented
+  /// libraries, through function pointers) keep going through the
+  /// wrappers, and ops interpose.so does not wrap are left alone.  A
+  /// call followed by another sync op with no calls or branches in
+  /// between is preceded by tern_coalesce_next(insid), which lets it keep
+  /// the turn (options::coalesce_ops); both ops must be ones that always
+  /// take the turn (syncfunc::takesTurn()).
+  /// -xtern-sync-instr-map=<file> writes "insid function callee" for each
+  /// rewritten call.
+  struct SyncInstr: public llvm::ModulePass {
+  private:
+    const llvm::Type *int_type;
+    std::map<std::string, unsigned> sync_ops; /// name -> syncfunc kind
+    std::map<std::string, unsigned> sync_nrs; /// name -> syncfunc number
+    unsigned next_insid;
+
+  protected:
+    /// name of the sync op @ci calls if it is to be rewritten, else NULL
+    const std::string *syncOp(llvm::CallInst *ci);
+    /// is the next call after @ci in its basic block a sync op?
+    bool followedBySyncOp(llvm::CallInst *ci);
+    bool instrument(llvm::CallInst *ci, llvm::Module &M, FILE *insid_map);
+
+  public:
+    static char ID;
+    SyncInstr();
+    virtual ~SyncInstr();
+    virtual bool runOnModule(llvm::Module &M);
+    virtual void getAnalysisUsage(llvm::AnalysisUsage &AU) const;
+    void init(llvm::Module &M);
+  };
+}
+
+#endif
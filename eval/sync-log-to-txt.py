@@ -0,0 +1,112 @@
+#!/usr/bin/env python
+
+#
+# Copyright (c) 2013,  Regents of the Columbia University 
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+# materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+
+# Usage: ./sync-log-to-txt.py <output dir> [<dir to write tid-*.txt to>]
+#
+# Converts the segmented binary sync log written with log_type = async
+# (sync-log[-<pid>].<seg>.bin) back into the per-thread text logs that
+# TxtLogger writes, so that draw-time-chart.pl and friends keep working.
+
+import glob
+import os
+import re
+import struct
+import sys
+
+MAGIC = 'XTSYNC1'
+HDR = struct.Struct('<8sII')                # AsyncLogHeader
+REC = struct.Struct('<QIiHBBB3xQQQ4Q')      # AsyncSyncRec
+MAX_SYNC_ARGS = 4
+
+def sync_names():
+    """names indexed by syncfunc enum value, read from syncfuncs.def.h"""
+    root = os.environ.get('XTERN_ROOT',
+                          os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+    names = ['not_sync']
+    with open(os.path.join(root, 'include', 'tern', 'syncfuncs.def.h')) as f:
+        for line in f:
+            m = re.match(r'^(DEF|DEFTERNAUTO|DEFTERNUSER)\((\w+)', line)
+            if m:
+                names.append(m.group(2))
+    return names
+
+def ts(ns):
+    return '%d:%09d' % (ns // 1000000000, ns % 1000000000)
+
+def read_log(files):
+    for fn in files:
+        with open(fn, 'rb') as f:
+            hdr = f.read(HDR.size)
+            magic, rec_size, seg_no = HDR.unpack(hdr)
+            if magic.rstrip(b'\0').decode() != MAGIC or rec_size != REC.size:
+                sys.stderr.write('%s: not an async sync log\n' % fn)
+                sys.exit(1)
+            while True:
+                buf = f.read(REC.size)
+                if len(buf) < REC.size:
+                    break
+                yield REC.unpack(buf)
+
+def convert(files, outdir, prefix):
+    names = sync_names()
+    outs = {}
+    nrecs = 0
+    for rec in read_log(files):
+        (turn, insid, tid, sync, after, nargs, phase,
+         app, syscall, sched) = rec[:10]
+        args = rec[10:10 + min(nargs, MAX_SYNC_ARGS)]
+        if tid not in outs:
+            outs[tid] = open(os.path.join(outdir, '%s%d.txt' % (prefix, tid)), 'w')
+            outs[tid].write('op insid turn app_time syscall_time sched_time tid args\n')
+        name = names[sync] if sync < len(names) else 'sync_%d' % sync
+        if name in ('tern_thread_begin', 'tern_thread_end'):
+            line = '%s 0x%x' % (name, insid)
+        else:
+            name += ('', '_first', '_second')[phase]
+            line = '%s 0x%08x' % (name, insid)
+        line += ' %d %s %s %s %d' % (turn, ts(app), ts(syscall), ts(sched), tid)
+        line += ''.join(' 0x%x' % a for a in args)
+        outs[tid].write(line + '\n')
+        nrecs += 1
+    for f in outs.values():
+        f.close()
+    return nrecs
+
+def main():
+    if len(sys.argv) < 2:
+        sys.stderr.write('Usage: %s <output dir> [<dir to write tid-*.txt to>]\n'
+                         % sys.argv[0])
+        sys.exit(1)
+    logdir = sys.argv[1]
+    outdir = sys.argv[2] if len(sys.argv) > 2 else logdir
+    # group segments by process: sync-log.NNNN.bin or sync-log-<pid>.NNNN.bin
+    procs = {}
+    for fn in glob.glob(os.path.join(logdir, 'sync-log*.bin')):
+        m = re.match(r'sync-log(-\d+)?\.(\d+)\.bin$', os.path.basename(fn))
+        if m:
+            procs.setdefault(m.group(1) or '', []).append((int(m.group(2)), fn))
+    for pid, segs in sorted(procs.items()):
+        files = [fn for _, fn in sorted(segs)]
+        n = convert(files, outdir, 'tid%s-' % pid)
+        print('%s: %d records in %d segments' % (pid[1:] or 'log', n, len(files)))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,92 @@
+#!/usr/bin/env python
+
+#
+# Copyright (c) 2013,  Regents of the Columbia University 
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+# materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+
+# Summarize an eval.py run of syncbench.cfg: median ns/op and handoffs/op
+# of every bench and thread count, one column per mode (cfg section) plus
+# the non-det baseline.
+
+import os
+import re
+import sys
+import argparse
+
+LINE = re.compile(r'^syncbench: (\S+)\s+threads\s+(\d+) ops\s+\d+ ns/op\s+(\S+) handoffs/op (\S+)')
+
+def median(values):
+    values = sorted(values)
+    n = len(values)
+    if n % 2:
+        return values[n // 2]
+    return (values[n // 2 - 1] + values[n // 2]) / 2.0
+
+def collect(directory):
+    # (bench, threads) -> ([ns/op], [handoffs/op])
+    results = {}
+    if not os.path.isdir(directory):
+        return results
+    for name in sorted(os.listdir(directory)):
+        if not name.startswith('output.'):
+            continue
+        for line in open(os.path.join(directory, name)):
+            m = LINE.match(line)
+            if not m:
+                continue
+            key = (m.group(1), int(m.group(2)))
+            ns, handoffs = results.setdefault(key, ([], []))
+            ns.append(float(m.group(3)))
+            handoffs.append(float(m.group(4)))
+    return results
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Tabulate syncbench results of an eval.py run")
+    parser.add_argument('run_dir', nargs='?', default='current',
+        help="eval.py run directory (default: current)")
+    parser.add_argument('--handoffs', action='store_true',
+        help="print handoffs/op instead of ns/op")
+    args = parser.parse_args()
+
+    columns = []    # (label, results)
+    for bench_dir in sorted(os.listdir(args.run_dir)):
+        if not bench_dir.startswith('microbench_syncbench'):
+            continue
+        mode = bench_dir[len('microbench_syncbench'):].lstrip('_') or 'default'
+        path = os.path.join(args.run_dir, bench_dir)
+        columns.append((mode, collect(os.path.join(path, 'xtern'))))
+        if not any(label == 'non-det' for label, _ in columns):
+            columns.append(('non-det', collect(os.path.join(path, 'non-det'))))
+    if not columns:
+        print >> sys.stderr, "no syncbench results under " + args.run_dir
+        sys.exit(1)
+
+    keys = set()
+    for _, results in columns:
+        keys.update(results.keys())
+    idx = 1 if args.handoffs else 0
+    print ('%-10s %7s' % ('bench', 'threads')) + ''.join(' %12s' % label for label, _ in columns)
+    for bench, threads in sorted(keys):
+        row = '%-10s %7d' % (bench, threads)
+        for _, results in columns:
+            if (bench, threads) in results:
+                row += (' %12.3f' if args.handoffs else ' %12.1f') \
+                    % median(results[(bench, threads)][idx])
+            else:
+                row += ' %12s' % '-'
+        print row
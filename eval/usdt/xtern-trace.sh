@@ -0,0 +1,46 @@
+#!/bin/bash
+
+#
+# Copyright (c) 2013,  Regents of the Columbia University 
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+#
+# 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+#
+# 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+# materials provided with the distribution.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+# CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+# PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+
+# Attach one of the sample bpftrace scripts in this directory to a running
+# xtern process through the USDT probes of the runtime
+# (include/tern/runtime/probes.h).  The runtime must have been built with
+# <sys/sdt.h> available.  Needs root.
+#
+#   xtern-trace.sh turn-wait.bt <pid>
+#
+# The same probes are visible to perf:
+#   perf buildid-cache --add $XTERN_ROOT/dync_hook/interpose.so
+#   perf record -e sdt_xtern:get_turn_exit -p <pid>
+
+if [ $# -ne 2 ]; then
+  echo "usage: $0 <script.bt> <pid>" >&2
+  exit 1
+fi
+
+script=$1
+[ -f "$script" ] || script=`dirname $0`/$1
+interpose=${XTERN_INTERPOSE:-$XTERN_ROOT/dync_hook/interpose.so}
+if [ ! -f "$interpose" ]; then
+  echo "cannot find $interpose; set XTERN_ROOT or XTERN_INTERPOSE" >&2
+  exit 1
+fi
+
+sed "s|@INTERPOSE@|$interpose|g" "$script" | bpftrace -p $2 -
@@ -22,6 +22,7 @@
 #define __TERN_RECORDER_LOGDEFS_H
 
 #include <stdint.h>
+#include <sys/types.h>
 #include "stdio.h"
 #include <boost/static_assert.hpp>
 #include "tern/syncfuncs.h"
@@ -38,6 +39,7 @@ enum {
   LOG_SIZE        = 1*TRUNK_SIZE,
   MAX_INLINE_ARGS = 2U,
   MAX_EXTRA_ARGS  = 3U,
+  MAX_SYNC_ARGS   = 4U,
   INVALID_INSID   = (unsigned)(-1)
 };
 
@@ -133,7 +135,7 @@ struct SyncRec: public InsidRec {
   short    sync;     // type of sync call
   bool     after;    // before or after the sync call
   bool     timedout; // is the wait timed out?
-  int      turn;     // turn no. that this sync occurred
+  uint64_t turn;     // turn no. that this sync occurred
   uint64_t args[MAX_INLINE_ARGS];
 };
 BOOST_STATIC_ASSERT(sizeof(SyncRec)<=RECORD_SIZE);
@@ -201,6 +203,135 @@ inline short ExtraArgsRec::numArgsInRec() const {
   return std::min(rec_narg, (short)MAX_EXTRA_ARGS);
 }
 
+/// number of arguments that loggers record for @sync, or -1 if @sync is
+/// not handled yet.  Must match the variable arguments the runtime passes
+/// to Logger::logSync().
+static inline int NumLoggedSyncArgs(short sync) {
+  switch(sync) {
+    // log nothing, mostly for sched point.
+  case syncfunc::accept4:
+  case syncfunc::recv:
+  case syncfunc::recvfrom:
+  case syncfunc::recvmsg:
+  case syncfunc::select:
+  case syncfunc::poll:
+  case syncfunc::bind:
+  case syncfunc::listen:
+  case syncfunc::getsockopt:
+  case syncfunc::setsockopt:
+  case syncfunc::pipe:
+  case syncfunc::fcntl:
+  case syncfunc::shutdown:
+  case syncfunc::gethostbyaddr:
+  case syncfunc::inet_ntoa:
+  case syncfunc::strtok:
+  case syncfunc::epoll_wait:
+  case syncfunc::epoll_create:
+  case syncfunc::epoll_ctl:
+  case syncfunc::sigwait:
+  case syncfunc::fgets:
+  case syncfunc::kill:
+  case syncfunc::fork:
+  case syncfunc::execv:
+  case syncfunc::sched_yield:
+  case syncfunc::wait:
+  case syncfunc::waitpid:
+  case syncfunc::tern_idle:
+  case syncfunc::tern_non_det_start:
+  case syncfunc::tern_non_det_end:
+    return 0;
+    // log one sync var (common case)
+  case syncfunc::tern_thread_begin:
+  case syncfunc::tern_thread_end:
+  case syncfunc::pthread_mutex_init:
+  case syncfunc::pthread_mutex_destroy:
+  case syncfunc::pthread_mutex_lock:
+  case syncfunc::pthread_mutex_unlock:
+  case syncfunc::pthread_barrier_wait:
+  case syncfunc::pthread_barrier_destroy:
+  case syncfunc::pthread_cond_signal:
+  case syncfunc::pthread_cond_broadcast:
+  case syncfunc::sem_wait:
+  case syncfunc::sem_init:
+  case syncfunc::sem_post:
+  case syncfunc::pthread_join:
+  case syncfunc::pthread_detach:
+  case syncfunc::sleep:
+  case syncfunc::usleep:
+  case syncfunc::nanosleep:
+  case syncfunc::pthread_rwlock_rdlock:
+  case syncfunc::pthread_rwlock_wrlock:
+  case syncfunc::tern_lineup_start:
+  case syncfunc::tern_lineup_end:
+  case syncfunc::tern_lineup_destroy:
+    return 1;
+    // log two sync vars for cond_*wait
+  case syncfunc::pthread_mutex_timedlock:
+  case syncfunc::pthread_cond_wait:
+  case syncfunc::pthread_barrier_init:
+  case syncfunc::pthread_create:
+  case syncfunc::pthread_mutex_trylock:
+  case syncfunc::sem_trywait:
+  case syncfunc::sem_timedwait:
+  case syncfunc::pthread_rwlock_tryrdlock:  //  rwlock, ret
+  case syncfunc::pthread_rwlock_trywrlock:
+  case syncfunc::pthread_rwlock_unlock:  //  rwlock, ret
+  case syncfunc::gethostbyname:  //  ret, dns cache hit
+  case syncfunc::gethostbyname_r:
+  case syncfunc::getaddrinfo:
+  case syncfunc::freeaddrinfo:  //  res, cached
+    return 2;
+    // log three sync vars
+  case syncfunc::pthread_cond_timedwait:  //  cv, mu, ret
+  case syncfunc::read:  //  sig, fd, ret
+  case syncfunc::pread:  //  sig, fd, ret
+  case syncfunc::accept:  //  sock(ret), from_port, to_port
+  case syncfunc::write: //  sig, fd, ret
+  case syncfunc::pwrite: //  sig, fd, ret
+  case syncfunc::tern_lineup_init:
+    return 3;
+  case syncfunc::connect: //  fd, from_port, to_port, ret
+    return 4;
+  }
+  return -1;
+}
+
+/// record of the async sync log (log_type = async).  Times are in
+/// nanoseconds.  The log is a sequence of segment files, each starting
+/// with an AsyncLogHeader followed by records sorted by turn.
+struct AsyncSyncRec {
+  uint64_t turn;
+  uint32_t insid;
+  int32_t  tid;
+  uint16_t sync;
+  uint8_t  after;
+  uint8_t  nargs;
+  uint8_t  phase;   // 0: only record, 1: _first, 2: _second
+  uint8_t  pad[3];
+  uint64_t app_time;
+  uint64_t syscall_time;
+  uint64_t sched_time;
+  uint64_t args[MAX_SYNC_ARGS];
+};
+BOOST_STATIC_ASSERT(sizeof(AsyncSyncRec) == 80);
+
+struct AsyncLogHeader {
+  char     magic[8];  // ASYNC_LOG_MAGIC
+  uint32_t rec_size;  // sizeof(AsyncSyncRec)
+  uint32_t seg_no;
+};
+#define ASYNC_LOG_MAGIC "XTSYNC1"
+
+static inline int getAsyncLogFilename(char *buf, size_t sz,
+                                      pid_t pid, unsigned seg) {
+  if (pid)
+    return snprintf(buf, sz, "%s/sync-log-%d.%04u.bin",
+                  options::output_dir.c_str(), pid, seg);
+  else
+    return snprintf(buf, sz, "%s/sync-log.%04u.bin",
+                  options::output_dir.c_str(), seg);
+}
+
 static inline int getLogFilename(char *buf, size_t sz,
                                  int tid, const char* ext) {
   if (options::pid_in_logfilename)
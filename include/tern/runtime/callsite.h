@@ -0,0 +1,50 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TERN_RECORDER_CALLSITE_H
+#define __TERN_RECORDER_CALLSITE_H
+
+#include <stdint.h>
+
+namespace tern {
+
+/// Call-site identification for the hook wrappers (options::dync_geteip).
+///
+/// A wrapper passes its own __builtin_return_address(0), which is the
+/// app's call site, so the plain id costs nothing.  The whole-stack
+/// signature (options::whole_stack_eip_signature) hashes the return
+/// addresses found by walking saved frame pointers from the wrapper's
+/// __builtin_frame_address(0), instead of unwinding with backtrace(),
+/// which is slow, takes locks in libgcc and can hang in a forked child.
+/// The walk only reads inside the calling thread's stack and stops at the
+/// first frame that does not look like one, so it is safe on code built
+/// without frame pointers; it is only useful when the app is built with
+/// -fno-omit-frame-pointer, as dync_hook itself is.
+enum { CALLSITE_MAX_DEPTH = 20 };
+
+/// fills @rets with up to @max return addresses, innermost first,
+/// starting with the caller of the function whose frame is @frame;
+/// returns how many were found
+int frameWalk(void *frame, void **rets, int max);
+
+/// hash of the return addresses frameWalk() finds, up to @depth of them
+uint64_t stackSignature(void *frame, int depth = CALLSITE_MAX_DEPTH);
+
+}
+
+#endif
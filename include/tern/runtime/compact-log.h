@@ -0,0 +1,144 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TERN_RECORDER_COMPACT_LOG_H
+#define __TERN_RECORDER_COMPACT_LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <tr1/unordered_map>
+#include "tern/logdefs.h"
+
+namespace tern {
+
+/// Compact sync log (log_type = compact), one tid-N.cmp file per thread.
+/// The file starts with a CompactLogHeader.  Each record is a sequence of
+/// unsigned LEB128 varints:
+///
+///   tag        (sync << 3) | (after << 2) | phase
+///   insid      dictionary code
+///   turn       zigzag delta from the previous record of this thread
+///   app_time   ns; the three times are already intervals (see
+///   syscall    update_time()), so they are small and stored as is
+///   sched_time
+///   args       NumLoggedSyncArgs(sync) dictionary codes
+///
+/// A dictionary code is 0 followed by a literal that is not remembered,
+/// 1 followed by a literal that is appended to the dictionary, or k >= 2
+/// for the (k-2)th dictionary entry.  Insids and arguments that look like
+/// addresses go into two separate dictionaries of at most
+/// COMPACT_DICT_SIZE entries each; once a dictionary is full, new values
+/// are written as plain literals.
+enum {
+  COMPACT_DICT_SIZE   = 4096,
+  COMPACT_MAX_REC     = 10 * (7 + MAX_SYNC_ARGS * 2), // worst-case bytes
+  COMPACT_MIN_DICT_ARG = 0x10000 // smaller args are not worth an entry
+};
+
+struct CompactLogHeader {
+  char    magic[8]; // COMPACT_LOG_MAGIC
+  int32_t tid;
+  int32_t pad;
+};
+#define COMPACT_LOG_MAGIC "XTCMP1"
+
+static inline uint64_t zigzag(int64_t v) {
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t v) {
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline char *putVarint(char *p, uint64_t v) {
+  while (v >= 0x80) {
+    *p++ = (char)(v | 0x80);
+    v >>= 7;
+  }
+  *p++ = (char)v;
+  return p;
+}
+
+/// returns NULL if the varint runs past @end
+static inline const char *getVarint(const char *p, const char *end,
+                                    uint64_t &v) {
+  v = 0;
+  for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+    uint8_t b = *p++;
+    v |= (uint64_t)(b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return p;
+  }
+  return NULL;
+}
+
+/// encoder state of one thread.  Kept separate from CompactLogger so
+/// that it can be tested without a running scheduler.
+struct CompactLogEncoder {
+  CompactLogEncoder() { reset(); }
+  void reset();
+
+  /// encode @rec into @p, which must have COMPACT_MAX_REC bytes room;
+  /// returns the end of the encoded record.
+  char *encode(char *p, const AsyncSyncRec &rec);
+
+protected:
+  typedef std::tr1::unordered_map<uint64_t, unsigned> dict_t;
+  char *putCode(char *p, dict_t &dict, uint64_t v, bool remember);
+
+  uint64_t last_turn;
+  dict_t   insids;
+  dict_t   objs;
+};
+
+/// decoder for one tid-N.cmp file.
+struct CompactLogDecoder {
+  CompactLogDecoder(): buf(NULL), buf_len(0), begin(NULL), pos(NULL),
+                       end(NULL), tid(-1) {}
+  ~CompactLogDecoder();
+
+  /// load @file; returns false if it is not a compact sync log
+  bool open(const char *file);
+  /// decode from a memory buffer that holds only records, no header
+  void attach(const char *b, size_t len, int thid);
+  /// decode the next record; returns false at the end of the log
+  bool next(AsyncSyncRec &rec);
+  /// print @rec the way TxtLogger does
+  static void print(FILE *f, const AsyncSyncRec &rec);
+
+  size_t size() const { return end - begin; }
+  int getTid() const { return tid; }
+
+protected:
+  void reset();
+  const char *getCode(const char *p, std::vector<uint64_t> &dict,
+                      uint64_t &v);
+
+  char       *buf;     /// mmapped file, if open() was used
+  size_t      buf_len;
+  const char *begin, *pos, *end;
+  int         tid;
+  uint64_t    last_turn;
+  std::vector<uint64_t> insids;
+  std::vector<uint64_t> objs;
+};
+
+}
+
+#endif
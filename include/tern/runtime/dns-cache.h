@@ -0,0 +1,78 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TERN_RECORDER_DNS_CACHE_H
+#define __TERN_RECORDER_DNS_CACHE_H
+
+#include <string>
+#include <tr1/unordered_map>
+#include <netdb.h>
+
+namespace tern {
+
+/// Name resolution cache used when options::dns_cache is on.  The first
+/// resolution of a (node, service, hints) key fixes the answer for the
+/// rest of the run, so later lookups are both fast and deterministic.
+///
+/// getaddrinfo() results handed out by the cache are shared, read-only
+/// copies with a reference count; freeaddrinfo() must go through
+/// releaseAddrInfo() so that it only drops a reference.  gethostbyname()
+/// results live as long as the cache, matching the "static buffer"
+/// semantics of libc.
+///
+/// Not thread-safe; callers must hold the turn.
+struct DnsCache {
+  /// on a hit, store a new reference to the cached list in @res
+  bool lookupAddrInfo(const char *node, const char *service,
+                      const struct addrinfo *hints, struct addrinfo **res);
+  /// cache a copy of @ai (a list returned by libc) unless the key is
+  /// already cached, and store a new reference to the cached list in
+  /// @res.  The caller still owns @ai.
+  void insertAddrInfo(const char *node, const char *service,
+                      const struct addrinfo *hints, const struct addrinfo *ai,
+                      struct addrinfo **res);
+  /// drop a reference; returns false if @res was not handed out by us
+  bool releaseAddrInfo(struct addrinfo *res);
+
+  struct hostent *lookupHost(const char *name);
+  struct hostent *insertHost(const char *name, const struct hostent *h);
+
+  /// copy @src into @dst with all strings and addresses stored in @buf,
+  /// as gethostbyname_r() does.  Returns 0, or ERANGE if @buf is too small.
+  static int copyHost(const struct hostent *src, struct hostent *dst,
+                      char *buf, size_t buflen);
+
+  ~DnsCache();
+
+protected:
+  static std::string addrInfoKey(const char *node, const char *service,
+                                 const struct addrinfo *hints);
+  static struct addrinfo *copyAddrInfo(const struct addrinfo *ai);
+
+  typedef std::tr1::unordered_map<std::string, struct addrinfo*> ai_map;
+  typedef std::tr1::unordered_map<struct addrinfo*, unsigned> ref_map;
+  typedef std::tr1::unordered_map<std::string, struct hostent*> host_map;
+
+  ai_map addrinfos;  /// key to cached list
+  ref_map refs;      /// cached list to # of references (the cache holds one)
+  host_map hosts;    /// name to cached hostent
+};
+
+}
+
+#endif
@@ -0,0 +1,106 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TERN_RECORDER_LATENCY_HIST_H
+#define __TERN_RECORDER_LATENCY_HIST_H
+
+#include <stdint.h>
+
+namespace tern {
+
+/// Per-call-site latency histograms (options::latency_hist).  Every thread
+/// owns a fixed table of (sync op, insid) sites; each site keeps one
+/// log-linear histogram per latency kind.  The tables are merged and
+/// written to <output_dir>/latency-<pid>.csv at exit.
+///
+/// Buckets are HDR-style: values below 2^LAT_SUB_BITS+1 ns get a bucket
+/// each; above that, every power of two is split into 2^LAT_SUB_BITS
+/// equal sub-buckets, so a bucket is at most 1/2^LAT_SUB_BITS of its
+/// value wide.
+enum LatencyKind {
+  LAT_TURN_WAIT = 0,  /// waiting in getTurn()
+  LAT_IN_TURN,        /// holding the turn in the op; not counting time
+                      /// parked in the middle of it (turnWait())
+  LAT_SYSCALL,        /// blocking call made off the turn
+  LAT_NUM_KINDS
+};
+
+enum {
+  LAT_SUB_BITS    = 2,
+  LAT_MAX_EXP     = 40,   // ~18 minutes; larger values go in the last bucket
+  // exact buckets, sub-buckets of 2^e for e in (LAT_SUB_BITS, LAT_MAX_EXP),
+  // and one bucket for everything from 2^LAT_MAX_EXP up
+  LAT_NUM_BUCKETS = (2 << LAT_SUB_BITS)
+                    + (LAT_MAX_EXP - LAT_SUB_BITS - 1) * (1 << LAT_SUB_BITS) + 1,
+  LAT_MAX_SITES   = 128   // per thread; the last site collects the rest
+};
+
+struct LatencyHist {
+  uint32_t counts[LAT_NUM_BUCKETS];
+  uint64_t total_ns;
+  uint64_t max_ns;
+
+  static inline unsigned bucket(uint64_t ns) {
+    if (ns < (2U << LAT_SUB_BITS))
+      return (unsigned)ns;
+    unsigned e = 63 - __builtin_clzll(ns); // ns in [2^e, 2^(e+1))
+    if (e >= LAT_MAX_EXP)
+      return LAT_NUM_BUCKETS - 1;
+    unsigned sub = (unsigned)(ns >> (e - LAT_SUB_BITS)) & ((1U << LAT_SUB_BITS) - 1);
+    return (2U << LAT_SUB_BITS) + (e - LAT_SUB_BITS - 1) * (1U << LAT_SUB_BITS) + sub;
+  }
+
+  /// smallest value that falls in bucket @b
+  static inline uint64_t bucketLow(unsigned b) {
+    if (b < (2U << LAT_SUB_BITS))
+      return b;
+    unsigned i = b - (2U << LAT_SUB_BITS);
+    unsigned e = i / (1U << LAT_SUB_BITS) + LAT_SUB_BITS + 1;
+    unsigned sub = i % (1U << LAT_SUB_BITS);
+    return (1ULL << e) + ((uint64_t)sub << (e - LAT_SUB_BITS));
+  }
+
+  inline void add(uint64_t ns) {
+    ++ counts[bucket(ns)];
+    total_ns += ns;
+    if (ns > max_ns)
+      max_ns = ns;
+  }
+
+  void merge(const LatencyHist &o);
+  uint64_t count() const;
+  /// value at percentile @p (0-100), reported as the bucket's low end
+  uint64_t percentile(double p) const;
+};
+
+struct LatencySite {
+  unsigned      insid;
+  unsigned short sync;   /// 0: site slot unused
+  LatencyHist   hists[LAT_NUM_KINDS];
+};
+
+struct LatencyStat {
+  static void record(LatencyKind kind, unsigned short sync, unsigned insid,
+                     uint64_t ns);
+  /// merge all threads' tables and write the CSV
+  static void dump(void);
+};
+
+}
+
+#endif
@@ -0,0 +1,106 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TERN_RECORDER_LIVE_STAT_H
+#define __TERN_RECORDER_LIVE_STAT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+namespace tern {
+
+/// Live runtime statistics (options::live_stat), published in the POSIX
+/// shared memory segment /xtern-stat-<pid> so that tools/xtern-top can
+/// watch a running process.  Each thread only writes its own
+/// LiveThreadStat slot, and the object table is only written with the
+/// turn held, so plain volatile stores suffice: readers may see a
+/// slightly stale value, never a torn one on the 64-bit targets we run.
+enum {
+  LIVE_STAT_VERSION     = 1,
+  LIVE_STAT_MAX_THREADS = 1024, // higher tids are not published
+  LIVE_STAT_MAX_OBJS    = 512   // sync objects tracked for wait time
+};
+#define LIVE_STAT_MAGIC "XTSTAT1"
+
+struct LiveThreadStat {
+  volatile uint64_t turns;         /// sync ops that took the turn
+  volatile uint64_t turn_wait_ns;  /// time spent in getTurn()
+  volatile uint64_t block_ops;     /// blocking calls made off the turn
+  volatile uint64_t wakeups;       /// threads this thread woke up
+  volatile uint64_t lineup_succ;
+  volatile uint64_t lineup_timeout;
+  volatile uint64_t nondet_entries;
+  volatile uint64_t idle_turns;    /// turns taken by the idle thread
+};
+
+struct LiveObjStat {
+  volatile uint64_t addr;          /// 0 if the slot is free
+  volatile uint64_t waits;
+  volatile uint64_t wait_ns;       /// time waiting on addr in syncWait()
+};
+
+struct LiveStatShm {
+  char     magic[8];
+  uint32_t version;
+  int32_t  pid;
+  uint64_t start_ns;               /// CLOCK_MONOTONIC at progBegin
+  volatile uint64_t turn;          /// last turn handed out
+  volatile int32_t  nthreads;      /// 1 + largest tid seen
+  int32_t  pad;
+  volatile uint64_t obj_overflow_ns; /// waits on objects not in objs[]
+  LiveThreadStat threads[LIVE_STAT_MAX_THREADS];
+  LiveObjStat    objs[LIVE_STAT_MAX_OBJS];
+};
+
+static inline void getLiveStatName(char *buf, size_t sz, pid_t pid) {
+  snprintf(buf, sz, "/xtern-stat-%d", (int)pid);
+}
+
+struct LiveStat {
+  static void progBegin(void);
+  static void progEnd(void);
+  static void childForkReturn(void);
+
+  /// NULL unless options::live_stat.  Stays mapped until exit once set,
+  /// since other threads may still be updating it when progEnd() runs.
+  static LiveStatShm *shm;
+  /// private slot for tids that do not fit in shm->threads; nobody
+  /// reads it
+  static LiveThreadStat dropped;
+
+  /// may be called off the turn, so nthreads is raised with a CAS
+  static inline LiveThreadStat *thread(int tid) {
+    if (tid < 0 || tid >= LIVE_STAT_MAX_THREADS)
+      return &dropped;
+    int n = shm->nthreads;
+    while (tid >= n) {
+      if (__sync_bool_compare_and_swap(&shm->nthreads, n, tid + 1))
+        break;
+      n = shm->nthreads;
+    }
+    return &shm->threads[tid];
+  }
+
+  /// called with the turn held
+  static void objWaited(void *addr, uint64_t ns);
+};
+
+}
+
+#endif
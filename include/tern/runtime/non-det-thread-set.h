@@ -23,6 +23,7 @@
 #include <tr1/unordered_set>
 #include <pthread.h>
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <list>
 //#include <string.h>
@@ -38,7 +39,7 @@ namespace tern {
 struct non_det_thread_set {
   protected:
     std::list<int> tid_list;
-    std::tr1::unordered_map<int, unsigned> tid_to_logical_clock_map;
+    std::tr1::unordered_map<int, uint64_t> tid_to_logical_clock_map;
 
   public:
     non_det_thread_set() {
@@ -46,7 +47,7 @@ struct non_det_thread_set {
       tid_to_logical_clock_map.clear();
     }
     
-    void insert(int tid, unsigned clock) {
+    void insert(int tid, uint64_t clock) {
       //fprintf(stderr, "non-det-thread-set insert tid %d, clock %u\n", tid, clock);
       ASSERT2(!in(tid));
       tid_list.push_back(tid);
@@ -80,7 +81,7 @@ struct non_det_thread_set {
       return *(tid_list.begin());
     }
 
-    unsigned get_clock(int tid) {
+    uint64_t get_clock(int tid) {
       ASSERT2(tid_to_logical_clock_map.find(tid) != tid_to_logical_clock_map.end());
       return tid_to_logical_clock_map[tid];
     }
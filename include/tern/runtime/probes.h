@@ -0,0 +1,52 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TERN_RECORDER_PROBES_H
+#define __TERN_RECORDER_PROBES_H
+
+// USDT (SystemTap/DTrace-style) static probes in the scheduler.  When
+// <sys/sdt.h> is available the runtime Makefile defines XTERN_USDT and
+// each probe compiles to a single nop plus a note in .note.stapsdt, so
+// bpftrace or perf can attach to a running process at no cost when
+// nothing is attached.  All probes live in provider "xtern"; see
+// eval/usdt/ for sample scripts.
+//
+//   get_turn_enter(tid, insid)          about to wait for the turn
+//   get_turn_exit(tid, insid, turn)     got the turn
+//   sched_op(tid, op, turn, insid)      op done, turn about to be released
+//   put_turn(tid, turn)                 turn released
+//   block_enter(tid, op, insid)         leaving the turn for a blocking call
+//   block_exit(tid, op, insid)          blocking call returned
+//   wait(tid, chan, timeout_turn)       waiting on chan, with the turn
+//   signal(tid, woken_tid, chan)        woke up woken_tid waiting on chan
+//   timeout(tid, chan, timeout_turn)    a wait of tid timed out
+//   lineup_success(tid, opaque_type)    every thread of a lineup arrived
+//   lineup_timeout(tid, opaque_type)    a lineup timed out
+
+#ifdef XTERN_USDT
+#include <sys/sdt.h>
+#define XTERN_PROBE2(name, a, b) DTRACE_PROBE2(xtern, name, a, b)
+#define XTERN_PROBE3(name, a, b, c) DTRACE_PROBE3(xtern, name, a, b, c)
+#define XTERN_PROBE4(name, a, b, c, d) DTRACE_PROBE4(xtern, name, a, b, c, d)
+#else
+#define XTERN_PROBE2(name, a, b) do {} while (0)
+#define XTERN_PROBE3(name, a, b, c) do {} while (0)
+#define XTERN_PROBE4(name, a, b, c, d) do {} while (0)
+#endif
+
+#endif
@@ -44,17 +44,25 @@ static __inline__ unsigned long long rdtsc(void)
   __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
   return ( (unsigned long long)lo)|( ((unsigned long long)hi)<<32 );
 }
+
+// rdtscp waits for earlier instructions to finish, so the read is not
+// moved ahead of the code being timed.  Check for it with cpuid first.
+static __inline__ unsigned long long rdtscp(void)
+{
+  unsigned hi, lo, aux;
+  __asm__ __volatile__ ("rdtscp" : "=a"(lo), "=d"(hi), "=c"(aux));
+  return ( (unsigned long long)lo)|( ((unsigned long long)hi)<<32 );
+}
 #endif
 
-//__thread
-// per process.
+// one traced op; kept in per-thread chunks, see rdtsc.cpp.
 struct sync_op_entry {
-  unsigned tid;
+  unsigned long long clock;
   const char *op;
   const char *op_suffix;
-  unsigned op_print_depth;
-  unsigned long long clock;
   void *eip;
+  unsigned tid;
+  unsigned op_print_depth;
 };
 
 extern void process_rdtsc_log(void);
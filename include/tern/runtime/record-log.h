@@ -26,6 +26,7 @@
 #include <tr1/unordered_map>
 
 #include "tern/logdefs.h"
+#include "tern/runtime/compact-log.h"
 
 namespace tern {
 
@@ -39,7 +40,7 @@ struct Logger {
   virtual void logRet(uint8_t flags, unsigned insid,
                       short narg, void* func, uint64_t data) {}
   virtual void logSync(unsigned insid, unsigned short sync,
-                       unsigned turn, 
+                       uint64_t turn, 
                        timespec time1, 
                        timespec time2, timespec sched_time, 
                        bool after = true, ...) {}
@@ -70,6 +71,7 @@ struct Logger {
   static void progEnd();
   static void threadBegin(int tid);
   static void threadEnd(void);
+  static void childForkReturn(void); /// called in the child after fork()
 
   /// map function address at runtime to a unique function ID.  We need
   /// this mapping so that we can find the llvm::Function* corresponding
@@ -86,7 +88,7 @@ struct Logger {
 
 struct TxtLogger: public Logger {
   virtual void logSync(unsigned insid, unsigned short sync,
-                       unsigned turn,
+                       uint64_t turn,
                        timespec time1, 
                        timespec time2, timespec sched_time, 
                        bool after = true, ...);
@@ -109,34 +111,103 @@ struct BinLogger: public Logger {
   virtual void logRet(uint8_t flags, unsigned insid,
                       short narg, void* func, uint64_t data);
   virtual void logSync(unsigned insid, unsigned short sync,
-                       unsigned turn, 
+                       uint64_t turn, 
                        timespec time1, 
                        timespec time2, timespec sched_time, 
                        bool after = true, ...);
   virtual ~BinLogger();
   BinLogger(int tid);
 
+  static void childForkReturn(void);
+
 protected:
 
-  void mapLogTrunk(void);
+  /// the log is a sequence of TRUNK_SIZE segments of the log file.  Once
+  /// half of the current segment is used, the next one is mapped by a
+  /// background thread, and once the current one is full, it is dropped
+  /// with MADV_DONTNEED and unmapped in the background as well.  Writing a
+  /// record thus costs one compare and one pointer bump.
   void checkAndGrowLogSize(void) {
-    // TODO: check log buffer size and allocate new space if necessary
-    assert(off + RECORD_SIZE <= TRUNK_SIZE);
+    if (__builtin_expect(cur >= limit, 0))
+      growLog();
   }
+  void growLog(void);
+  void mapLogTrunk(void);
+  friend struct BinLogMapper;
 
-  char*      buf;
-  unsigned   off;
+  char*      buf;   /// start of current segment
+  char*      cur;   /// where the next record goes
+  char*      limit; /// cur >= limit: prefetch next segment or switch to it
   int        fd;
-  off_t      foff;
+  off_t      foff;  /// file offset of the segment after the current one
+
+  char* volatile next_buf;     /// next segment, mapped in the background
+  volatile bool  next_pending; /// mapping of next_buf is in flight
 };
 
 
+/// logger that moves log I/O off the turn.  Each thread appends
+/// fixed-size AsyncSyncRec records to its own single-producer,
+/// single-consumer ring.  A background writer thread, which is not a tern
+/// thread and never takes the turn, merges the rings in turn order into
+/// one segmented file (see getAsyncLogFilename()).  The rings are drained
+/// at exit and in the parent before fork(); on a fatal signal, whatever
+/// they hold is dumped ring by ring, best effort.
+struct AsyncLogger: public Logger {
+  virtual void logSync(unsigned insid, unsigned short sync,
+                       uint64_t turn,
+                       timespec time1,
+                       timespec time2, timespec sched_time,
+                       bool after = true, ...);
+  virtual void flush();
+  AsyncLogger(int tid);
+  virtual ~AsyncLogger();
+
+  static void progBegin();
+  static void progEnd();
+  static void childForkReturn();
+
+  /// write out buffered records in turn order; returns # of records
+  /// written.  Unless @all is set, only records that can no longer be
+  /// preceded by an unpublished record are written.
+  static unsigned drain(bool all);
+
+  struct ring_t;
+
+protected:
+  int tid;
+  ring_t *ring;
+};
+
+/// logger that writes the compact sync log described in compact-log.h.
+/// Records are encoded into a per-thread buffer under the turn, and the
+/// buffer goes to tid-N.cmp with one write() per COMPACT_BUF_SIZE bytes.
+struct CompactLogger: public Logger {
+  virtual void logSync(unsigned insid, unsigned short sync,
+                       uint64_t turn,
+                       timespec time1,
+                       timespec time2, timespec sched_time,
+                       bool after = true, ...);
+  virtual void flush();
+  CompactLogger(int tid);
+  virtual ~CompactLogger();
+
+  enum {COMPACT_BUF_SIZE = 64*1024};
+
+protected:
+  int   tid;
+  int   fd;
+  char *buf;
+  char *cur;
+  CompactLogEncoder enc;
+};
+
 /// logger for testing; prints out a canonicalized log that remains the
 /// same across different deterministic runs.  Note that pointer addresses
 /// are fine because our testing script canonicalizes them
 struct TestLogger: public Logger {
   virtual void logSync(unsigned insid, unsigned short sync,
-                       unsigned turn, 
+                       uint64_t turn, 
                        timespec time1, 
                        timespec time2, timespec sched_time, 
                        bool after = true, ...);
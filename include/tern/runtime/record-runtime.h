@@ -23,8 +23,11 @@
 #define __TERN_RECORDER_RUNTIME_H
 
 #include <tr1/unordered_map>
+#include <deque>
+#include <sys/socket.h>
 #include "tern/runtime/runtime.h"
 #include "tern/runtime/record-scheduler.h"
+#include "tern/runtime/dns-cache.h"
 #include "runtime-stat.h"
 #include <time.h>
 
@@ -54,12 +57,34 @@ struct ref_cnt_barrier_t {
 typedef std::tr1::unordered_map<pthread_barrier_t*, barrier_t> barrier_map;
 typedef std::tr1::unordered_map<unsigned, ref_cnt_barrier_t> refcnt_bar_map;
 
+/// connections drained from one listening socket but not yet handed out
+/// to an accept() caller; see options::accept_batching.
+struct accept_batch_t {
+  struct conn_t {
+    int fd;
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+  };
+  std::deque<conn_t> conns;
+  bool draining; // is some thread blocked in accept() on this socket?
+  int nwaiters;  // threads parked in syncWait() on this batch
+  accept_batch_t(): draining(false), nwaiters(0) {}
+};
+typedef std::tr1::unordered_map<int, accept_batch_t> accept_batch_map;
+
 typedef std::tr1::unordered_map<pthread_t, int> tid_map_t;
 typedef std::tr1::unordered_map<void*, std::list<int> > waiting_tid_t;
 
-template <typename _Scheduler>
+/// @_Instrumented == false is the lean instantiation InstallRuntime() picks
+/// when every instrumentation option (log_sync, record_runtime_stat,
+/// record_rdtsc, live_stat, latency_hist, turn_hog_profile,
+/// schedule_fingerprint) is off: the checks of those options on the sync
+/// paths fold to false and the code they guard is compiled out.
+template <typename _Scheduler, bool _Instrumented = true>
 struct RecorderRT: public Runtime, public _Scheduler {
 
+  static const bool instrumented = _Instrumented;
+
   void progBegin(void);
   void progEnd(void);
   void threadBegin(void);
@@ -112,6 +137,7 @@ struct RecorderRT: public Runtime, public _Scheduler {
   void threadDetach();
   void nonDetBarrierEnd(int bar_id, int cnt);
   void setBaseTime(struct timespec *ts);
+  void coalesceNext(unsigned insid);
   
   void symbolic(unsigned insid, int &error, void *addr, int nbytes, const char *name);
 
@@ -197,15 +223,28 @@ protected:
 
   /* These two sync wait/signal operations also contain logic for dbug+parrot, so name them separately.
   These two operations should only involve "sync" objects from applications or soft barrier hints. */
-  int syncWait(void *chan, unsigned timeout = Scheduler::FOREVER);
+  int syncWait(void *chan, uint64_t timeout = Scheduler::FOREVER);
   void syncSignal(void *chan, bool all=false);
+  /// _S::wait() from inside an op, for the profilers' in-turn clocks
+  int turnWait(void *chan, uint64_t timeout = Scheduler::FOREVER);
+  void liveStatTurn(uint64_t wait_ns);
 
-  int absTimeToTurn(const struct timespec *abstime);
-  int relTimeToTurn(const struct timespec *reltime);
+  uint64_t absTimeToTurn(const struct timespec *abstime);
+  uint64_t relTimeToTurn(const struct timespec *reltime);
 
-  int pthreadMutexLockHelper(pthread_mutex_t *mutex, unsigned timeout = Scheduler::FOREVER);
-  int pthreadRWLockWrLockHelper(pthread_rwlock_t *rwlock, unsigned timeout = Scheduler::FOREVER);
-  int pthreadRWLockRdLockHelper(pthread_rwlock_t *rwlock, unsigned timeout = Scheduler::FOREVER);
+  int pthreadMutexLockHelper(pthread_mutex_t *mutex, uint64_t timeout = Scheduler::FOREVER);
+  int pthreadRWLockWrLockHelper(pthread_rwlock_t *rwlock, uint64_t timeout = Scheduler::FOREVER);
+  int pthreadRWLockRdLockHelper(pthread_rwlock_t *rwlock, uint64_t timeout = Scheduler::FOREVER);
+
+  int acceptBatchHelper(unsigned insid, int &error, unsigned short syncop, int sockfd,
+                        struct sockaddr *cliaddr, socklen_t *addrlen, int flags);
+  int popAcceptedConn(accept_batch_t &batch, struct sockaddr *cliaddr, socklen_t *addrlen, int flags);
+  void resetAcceptBatch(int sockfd);
+  int getaddrinfoCached(unsigned insid, int &error, const char *node, const char *service,
+                        const struct addrinfo *hints, struct addrinfo **res);
+  struct hostent *gethostbynameCached(unsigned insid, int &error, const char *name);
+  int gethostbynameRCached(unsigned insid, int &error, const char *name, struct hostent *ret,
+                           char *buf, size_t buflen, struct hostent **result, int *h_errnop);
   
   /// for each pthread barrier, track the count of the number and number
   /// of threads arrived at the barrier
@@ -214,6 +253,15 @@ protected:
   /// for each opaque type, track the its ref counted barrier.
   refcnt_bar_map refcnt_bars;
 
+  /// for each listening socket, the connections drained by the thread
+  /// that blocked in accept() and not yet handed out.  Only accessed
+  /// with the turn held.
+  accept_batch_map accept_batches;
+
+  /// resolution results shared by all threads when options::dns_cache is
+  /// on.  Only accessed with the turn held.
+  DnsCache dns_cache;
+
   /// need these semaphores to assign tid deterministically; see comments
   /// for pthreadCreate() and threadBegin()
   sem_t thread_begin_sem;
@@ -22,9 +22,8 @@
 // TODO:
 // 1. use multiple wait queues per waitvar, instead of one for all
 //    waitvars, for performance?
-// 2. implement random scheduler
-// 3. implement replay scheduler
-// 4. support break out of turn.  RR can deadlock if program uses ad hoc
+// 2. implement replay scheduler
+// 3. support break out of turn.  RR can deadlock if program uses ad hoc
 //    sync, such as "while(flag)"
 
 #ifndef __TERN_RECORDER_SCHEDULER_H
@@ -55,7 +54,7 @@ struct RecordSerializer: public Serializer {
     pthread_mutex_unlock(&lock);
   }
 
-  int  wait(void *chan, unsigned timeout = Scheduler::FOREVER) {
+  int  wait(void *chan, uint64_t timeout = Scheduler::FOREVER) {
     incTurnCount();
     putTurn();
     sched_yield();  //  give control to other threads
@@ -96,7 +95,7 @@ struct RRScheduler: public Scheduler {
     pthread_cond_t cond;
     sem_t    sem;
     void*    chan;
-    unsigned timeout;
+    uint64_t timeout;
     int      status; // return value of wait()
     volatile bool wakenUp;
 
@@ -119,16 +118,20 @@ struct RRScheduler: public Scheduler {
 
   virtual void getTurn();
   virtual void putTurn(bool at_thread_end = false);
-  virtual int  wait(void *chan, unsigned timeout = Scheduler::FOREVER);
+  virtual int  wait(void *chan, uint64_t timeout = Scheduler::FOREVER);
   virtual std::list<int> signal(void *chan, bool all=false);
 
-  virtual int block(); 
+  virtual void block(); 
   virtual bool interProStart();
   virtual bool interProEnd();
   virtual void wakeup();
 
-  unsigned incTurnCount(void);
-  unsigned getTurnCount(void);
+  uint64_t incTurnCount(void);
+  uint64_t getTurnCount(void);
+
+  /// keep the turn across the next putTurn() if @syncop cannot block
+  /// and this thread has options::coalesce_ops left
+  void coalesce(unsigned syncop);
 
   void childForkReturn();
 
@@ -140,11 +143,13 @@ protected:
   /// timeout threads on @waitq
   int fireTimeouts();
   /// return the next timeout turn number
-  unsigned nextTimeout();
+  uint64_t nextTimeout();
   /// pop the @runq and wakes up the thread at the front of @runq
   virtual void next(bool at_thread_end=false, bool hasPoppedFront = false);
   /// child classes can override this method to reorder threads in @runq
   virtual void reorderRunq(void) {}
+  /// puts thread @tid, which just gave up the turn, back on @runq
+  virtual void requeue(int tid) { runq.push_back(tid); }
 
   /// for debugging
   void selfcheck(void);
@@ -166,6 +171,12 @@ protected:
   // improves performance
   wait_t waits[MAX_THREAD_NUM];
 
+  /// set by coalesce(), consumed by the next putTurn()
+  bool keep_turn;
+  /// ops each thread may still run in the turn it kept; refilled when
+  /// the thread hands the turn on
+  int coalesce_left[MAX_THREAD_NUM];
+
   //  for inter-process operation wakeup
   typedef std::tr1::unordered_set<int> tid_set;
   tid_set inter_pro_wakeup_tids;
@@ -203,6 +214,57 @@ struct Random {
   unsigned long next;
 };
 
+/// RR with a seeded coin flip at every putTurn(): on heads the thread goes
+/// back to the front of @runq and keeps the turn for another op.  The
+/// same options::scheduler_seed always gives the same schedule; other
+/// seeds explore other interleavings.
+struct RandomScheduler: public RRScheduler {
+  RandomScheduler();
+
+protected:
+  virtual void requeue(int tid);
+
+  Random rng;
+};
+
+/// No ordering at all.  The turn is a plain mutex that only keeps the
+/// runtime's own bookkeeping consistent; threads get it in whatever order
+/// the OS picks, and wait() blocks on a condition variable until
+/// signal() instead of being woken in turn order.  Timeouts still count
+/// turns, which the idle thread advances with wall time.  With
+/// options::scheduler=passthrough this measures the cost of determinism
+/// with the same wrappers and instrumentation as RR.
+struct PassthroughScheduler: public Serializer {
+  typedef Serializer Parent;
+
+  struct wait_t {
+    pthread_cond_t cond;
+    void*    chan;
+    uint64_t timeout;
+    int      status;
+    bool     waiting;
+    wait_t(): chan(NULL), timeout(FOREVER), status(0), waiting(false) {
+      pthread_cond_init(&cond, NULL);
+    }
+  };
+
+  virtual void getTurn() { pthread_mutex_lock(&lock); }
+  virtual void putTurn(bool at_thread_end = false);
+  virtual int  wait(void *chan, uint64_t timeout = Scheduler::FOREVER);
+  virtual std::list<int> signal(void *chan, bool all=false);
+
+  uint64_t incTurnCount(void);
+
+  void childForkReturn();
+
+  PassthroughScheduler();
+
+protected:
+  pthread_mutex_t lock;
+  std::list<int> waitq;
+  wait_t waits[MAX_THREAD_NUM];
+};
+
 } // namespace tern
 
 #endif
@@ -380,6 +380,7 @@ public:
       head = tail = elem;
     } else {
       elem->next = head;
+      head->prev = elem;
       head = elem;
     }
     DBG_INSERT_ELEM(__FUNCTION__, elem);
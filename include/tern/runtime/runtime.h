@@ -26,6 +26,7 @@
 #include <sys/epoll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <netdb.h>
 
 namespace tern {
 
@@ -91,6 +92,7 @@ struct Runtime {
   virtual void threadDetach() = 0;
   virtual void nonDetBarrierEnd(int bar_id, int cnt) = 0;
   virtual void setBaseTime(struct timespec *ts) = 0;
+  virtual void coalesceNext(unsigned insid) = 0;
 
   // print runtime stat.
   virtual void printStat() = 0;
@@ -187,10 +189,11 @@ struct Runtime {
   virtual int __accept4(unsigned insid, int &error, int sockfd, struct sockaddr *cliaddr, socklen_t *addrlen, int flags);
   virtual int __connect(unsigned insid, int &error, int sockfd, const struct sockaddr *serv_addr, socklen_t addrlen);
   virtual struct hostent *__gethostbyname(unsigned insid, int &error, const char *name);
-  // Heming: weird and hack, remove virtual here currently.
-  int __gethostbyname_r(unsigned insid, int &error, const char *name, struct hostent *ret, char *buf, size_t buflen, struct hostent **result, int *h_errnop);
-  int __getaddrinfo(unsigned insid, int &error, const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res);
-  void __freeaddrinfo(unsigned insid, int &error, struct addrinfo *res);
+  // These three are only scheduled by RecorderRT when options::dns_cache
+  // is on; otherwise they go straight to libc.
+  virtual int __gethostbyname_r(unsigned insid, int &error, const char *name, struct hostent *ret, char *buf, size_t buflen, struct hostent **result, int *h_errnop);
+  virtual int __getaddrinfo(unsigned insid, int &error, const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res);
+  virtual void __freeaddrinfo(unsigned insid, int &error, struct addrinfo *res);
   virtual struct hostent *__gethostbyaddr(unsigned insid, int &error, const void *addr, int len, int type);
   virtual char *__inet_ntoa(unsigned ins, int &error, struct in_addr in);
   virtual char *__strtok(unsigned ins, int &error, char * str, const char * delimiters);
@@ -0,0 +1,55 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TERN_RECORDER_SCHEDULE_FINGERPRINT_H
+#define __TERN_RECORDER_SCHEDULE_FINGERPRINT_H
+
+#include <stdint.h>
+
+namespace tern {
+
+/// Rolling schedule fingerprint (options::schedule_fingerprint).
+///
+/// Every scheduled op folds (turn, tid, op, object) into a 64-bit hash,
+/// so two runs can be checked for the same schedule by comparing one
+/// number instead of diffing sync logs.  The object is the first logged
+/// argument of a Synchronization op, renamed to the order in which it was
+/// first used so that ASLR and malloc placement do not change the hash;
+/// it is 0 for other ops, whose arguments (fds, sizes) are not part of
+/// the schedule.  Only called with the turn held.
+///
+/// The final hash is printed to stderr at exit.  With
+/// options::schedule_fingerprint_interval = N, the running hash is also
+/// appended to <output_dir>/fingerprint-<pid>.txt every N turns, which
+/// narrows down where two diverging runs part ways.
+struct ScheduleFingerprint {
+  static void update(uint64_t turn, int tid, unsigned short op, uint64_t obj);
+  static void progEnd(void);
+  /// forgets all ops and objects seen so far
+  static void reset(void);
+
+  static uint64_t hash;
+  static uint64_t nops;
+};
+
+/// picks the first logged argument out of a SCHED_TIMER_END argument list
+static inline uint64_t fingerprintObj(uint64_t obj, ...) { return obj; }
+
+}
+
+#endif
@@ -22,6 +22,7 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <list>
 #include <tr1/unordered_map>
@@ -143,7 +144,9 @@ protected:
 /// runtime use serializers, instead of schedulers.
 struct Serializer: public TidMap {
 
-  enum {FOREVER = UINT_MAX}; // wait forever w/o timeout
+  /// turns are 64 bits so that timeouts stay ordered at millions of
+  /// turns per second; a 32-bit count wraps within the hour
+  static const uint64_t FOREVER = ~0ULL; // wait forever w/o timeout
 
   /// wait on @chan until another thread calls signal(@chan), or turnCount
   /// is greater than or equal to @timeout if @timeout is not 0.  give up
@@ -154,7 +157,7 @@ struct Serializer: public TidMap {
   /// until @timeout
   ///
   /// @return 0 if wait() is signaled or ETIMEOUT if wait() times out
-  virtual int wait(void *chan, unsigned timeout=FOREVER) { 
+  virtual int wait(void *chan, uint64_t timeout=FOREVER) { 
     incTurnCount();
     putTurn();
     getTurn();
@@ -178,11 +181,10 @@ struct Serializer: public TidMap {
   ///
   /// NOTICE: different delay before @block() should not lead to different
   /// schedule.
-  virtual int block() { 
+  virtual void block() { 
     getTurn();
-    int ret = incTurnCount(); 
+    incTurnCount(); 
     putTurn();
-    return ret;
   }
 
   /// start to fastly and safely do a inter-process operation (without getting a turn and putting it).
@@ -215,20 +217,24 @@ struct Serializer: public TidMap {
   /// pthread_cond_*wait
   pthread_mutex_t *getLock() { return NULL; }
 
+  /// the current thread just did @syncop and is about to putTurn();
+  /// schedulers may let it keep the turn for its next op
+  void coalesce(unsigned syncop) { }
+
   /// must call within turn because turnCount is shared across all
   /// threads.  we provide this method instead of incrementing turn for
   /// each successful getTurn() because a successful getTurn() may not
   /// lead to a real success of a synchronization operation (e.g., see
   /// pthread_mutex_lock() implementation)
   static const int INF = 0x7fffff00;
-  virtual unsigned incTurnCount(void);
-  virtual unsigned getTurnCount(void);
+  virtual uint64_t incTurnCount(void);
+  virtual uint64_t getTurnCount(void);
 
   Serializer();
   ~Serializer();
 
   FILE *logger;
-  unsigned turnCount; // number of turns so far
+  uint64_t turnCount; // number of turns so far
 };
 
 
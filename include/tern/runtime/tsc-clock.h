@@ -0,0 +1,76 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TERN_RECORDER_TSC_CLOCK_H
+#define __TERN_RECORDER_TSC_CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+#include "tern/runtime/rdtsc.h"
+
+namespace tern {
+
+/// Nanosecond clock for the logging hot path (options::log_tsc_time).  If
+/// the CPU has an invariant TSC and rdtscp, time is read with rdtscp and
+/// scaled with a factor calibrated once against CLOCK_MONOTONIC_RAW;
+/// otherwise it falls back to clock_gettime(CLOCK_MONOTONIC_RAW).
+struct TscClock {
+  /// detect the TSC and calibrate it; cheap to call more than once.
+  /// @force_fallback is for testing the fallback path.
+  static void init(bool force_fallback = false);
+
+  static inline uint64_t now() {
+    if (use_tsc)
+      return cyclesToNs(readTsc());
+    return monotonicRaw();
+  }
+
+  /// scale a TSC delta to ns; only meaningful if usingTsc()
+  static inline uint64_t cyclesToNs(uint64_t cycles) {
+    // split so that cycles * mult never overflows 64 bits
+    uint64_t hi = cycles >> 32, lo = cycles & 0xffffffffULL;
+    return ((hi * mult) << (32 - shift)) + ((lo * mult) >> shift);
+  }
+
+  static uint64_t monotonicRaw() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  }
+
+  static inline uint64_t readTsc() {
+#if defined(__i386__) || defined(__x86_64__)
+    return rdtscp();
+#else
+    return 0; // init() never picks the TSC here
+#endif
+  }
+
+  static bool usingTsc() { return use_tsc; }
+  static double tscPerNs() { return (double)(1ULL << shift) / mult; }
+
+protected:
+  static bool     use_tsc;
+  static bool     inited;
+  static uint64_t mult;  /// ns = cycles * mult >> shift
+  static unsigned shift;
+};
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __TERN_RECORDER_TURN_HOG_H
+#define __TERN_RECORDER_TURN_HOG_H
+
+#include <stdint.h>
+
+namespace tern {
+
+/// Head-of-line stall profiler (options::turn_hog_profile).
+///
+/// Under DMT a thread that runs a long stretch of code between two sync
+/// ops holds up every thread queued behind it, because the turn waits for
+/// it.  When a thread is granted the turn, the time the turn sat idle
+/// since the previous release, times the number of other threads then
+/// waiting in getTurn(), is charged to the code region the granted thread
+/// just ran: from its previous sync op site to the current one.  Time
+/// spent holding the turn inside an op while others queue is charged to
+/// the same region as in-op time.  The top regions, the "turn hogs", are
+/// written to <output_dir>/turn-hogs-<pid>.txt at exit.
+struct TurnHogProfiler {
+  /// called before getTurn()
+  static inline void arrive(void) { __sync_fetch_and_add(&nwaiting, 1); }
+  /// called right after getTurn(); returns the stall caused by the
+  /// caller and sets @waiters to the # of threads it held up
+  static uint64_t grant(uint64_t arrive_ns, uint64_t grant_ns,
+                        unsigned &waiters);
+  /// called with the turn held, before the op gives it away to wait
+  /// (syncWait()); the in-op time so far goes to the op's region
+  static void yield(uint64_t grant_ns);
+  /// called with the turn held, just before it is released
+  static void release(unsigned short op, unsigned insid, uint64_t stall_ns,
+                      unsigned waiters, uint64_t grant_ns);
+  static void dump(void);
+
+  static volatile int nwaiting;      /// threads inside getTurn()
+  static volatile uint64_t last_release_ns;
+};
+
+}
+
+#endif
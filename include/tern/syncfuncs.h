@@ -88,6 +88,34 @@ static inline const char* getTernName(unsigned nr) {
   return nameInTern[nr];
 }
 
+/// ops whose RecorderRT hook takes the turn every time it runs outside a
+/// non-det region.  Others in this table may pass straight through: time(),
+/// gettimeofday(), write() or close() on a regular file, ...
+static inline bool takesTurn(unsigned nr) {
+  switch (nr) {
+  case pthread_mutex_lock:
+  case pthread_mutex_unlock:
+  case pthread_mutex_trylock:
+  case pthread_mutex_timedlock:
+  case pthread_rwlock_rdlock:
+  case pthread_rwlock_wrlock:
+  case pthread_rwlock_tryrdlock:
+  case pthread_rwlock_trywrlock:
+  case pthread_rwlock_unlock:
+  case pthread_cond_wait:
+  case pthread_cond_timedwait:
+  case pthread_cond_signal:
+  case pthread_cond_broadcast:
+  case pthread_barrier_wait:
+  case sem_wait:
+  case sem_trywait:
+  case sem_timedwait:
+  case sem_post:
+    return true;
+  }
+  return false;
+}
+
 unsigned getNameID(const char* name);
 unsigned getTernNameID(const char* nameInTern);
 
@@ -0,0 +1,396 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "tern/runtime/record-log.h"
+#include "tern/runtime/run-queue.h"
+
+namespace tern {
+
+/// Single-producer, single-consumer ring.  The owner thread advances
+/// tail; whoever holds drain_mutex advances head.  head and tail never
+/// wrap, so tail - head is the number of records in the ring.
+struct AsyncLogger::ring_t {
+  volatile uint64_t head;
+  char pad1[64 - sizeof(uint64_t)];
+  volatile uint64_t tail;
+  char pad2[64 - sizeof(uint64_t)];
+  uint64_t mask;
+  AsyncSyncRec recs[1];
+};
+
+static AsyncLogger::ring_t *rings[MAX_THREAD_NUM];
+static volatile int nrings = 0; // rings[0..nrings) may be non-NULL
+static uint64_t ring_size;      // # of records per ring, power of 2
+
+static pthread_mutex_t drain_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t writer_th;
+static volatile bool writer_running = false;
+static volatile bool writer_stop = false;
+
+static int log_fd = -1;
+static unsigned seg_no = 0;
+static uint64_t seg_off = 0;
+static pid_t log_pid = 0; // 0 unless the pid goes into the file name
+
+// records are merged into this buffer before they are written out
+enum { WRITE_BUF_RECS = 1024 };
+static AsyncSyncRec write_buf[WRITE_BUF_RECS];
+
+static const int fatal_signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+
+static inline uint64_t ts2ns(const timespec &ts) {
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void open_segment(void) {
+  char logFile[256];
+  getAsyncLogFilename(logFile, sizeof(logFile), log_pid, seg_no);
+  log_fd = open(logFile, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+  assert(log_fd >= 0 && "can't open async log file!");
+
+  AsyncLogHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  strncpy(hdr.magic, ASYNC_LOG_MAGIC, sizeof(hdr.magic));
+  hdr.rec_size = sizeof(AsyncSyncRec);
+  hdr.seg_no = seg_no;
+  ssize_t ret = write(log_fd, &hdr, sizeof(hdr));
+  assert(ret == (ssize_t)sizeof(hdr) && "can't write async log header!");
+  seg_off = sizeof(hdr);
+}
+
+static void write_records(const AsyncSyncRec *recs, unsigned n) {
+  while (n) {
+    if (seg_off + sizeof(AsyncSyncRec) > (uint64_t)options::async_log_segment_size
+        && seg_off > sizeof(AsyncLogHeader)) {
+      close(log_fd);
+      ++ seg_no;
+      open_segment();
+    }
+    uint64_t room = ((uint64_t)options::async_log_segment_size - seg_off)
+      / sizeof(AsyncSyncRec);
+    unsigned cnt = (room == 0 || room > n) ? n : (unsigned)room;
+    const char *p = (const char*)recs;
+    size_t len = cnt * sizeof(AsyncSyncRec);
+    while (len) {
+      ssize_t ret = write(log_fd, p, len);
+      if (ret < 0 && errno == EINTR)
+        continue;
+      assert(ret > 0 && "can't write async log!");
+      p += ret;
+      len -= ret;
+    }
+    seg_off += cnt * sizeof(AsyncSyncRec);
+    recs += cnt;
+    n -= cnt;
+  }
+}
+
+unsigned AsyncLogger::drain(bool all) {
+  pthread_mutex_lock(&drain_mutex);
+  if (log_fd < 0) {
+    pthread_mutex_unlock(&drain_mutex);
+    return 0;
+  }
+
+  int n = nrings;
+  uint64_t limit = 0;
+  bool any = false;
+  // Pass 1: find the largest turn published so far.  A record with a
+  // smaller turn was published by a thread that held the turn before, so
+  // it happened before this one and is visible in pass 2 below, even if
+  // its ring looked empty in pass 1.
+  for (int i = 0; i < n; ++i) {
+    ring_t *r = rings[i];
+    if (!r)
+      continue;
+    uint64_t t = r->tail;
+    if (t == r->head)
+      continue;
+    __sync_synchronize();
+    uint64_t turn = r->recs[(t - 1) & r->mask].turn;
+    if (!any || turn > limit)
+      limit = turn;
+    any = true;
+  }
+  if (!any) {
+    pthread_mutex_unlock(&drain_mutex);
+    return 0;
+  }
+  __sync_synchronize();
+
+  // Pass 2: merge all rings up to limit in turn order.
+  static uint64_t heads[MAX_THREAD_NUM], tails[MAX_THREAD_NUM];
+  for (int i = 0; i < n; ++i)
+    if (rings[i]) {
+      heads[i] = rings[i]->head;
+      tails[i] = rings[i]->tail;
+    }
+  __sync_synchronize();
+
+  unsigned nbuf = 0, total = 0;
+  while (true) {
+    int best = -1;
+    uint64_t best_turn = 0;
+    for (int i = 0; i < n; ++i) {
+      ring_t *r = rings[i];
+      if (!r || heads[i] == tails[i])
+        continue;
+      uint64_t turn = r->recs[heads[i] & r->mask].turn;
+      if (!all && turn > limit)
+        continue;
+      if (best < 0 || turn < best_turn) {
+        best = i;
+        best_turn = turn;
+      }
+    }
+    if (best < 0)
+      break;
+    write_buf[nbuf++] = rings[best]->recs[heads[best] & rings[best]->mask];
+    ++ heads[best];
+    if (nbuf == WRITE_BUF_RECS) {
+      write_records(write_buf, nbuf);
+      total += nbuf;
+      nbuf = 0;
+    }
+  }
+  if (nbuf) {
+    write_records(write_buf, nbuf);
+    total += nbuf;
+  }
+
+  // hand the slots back to the producers only after the copies are done
+  __sync_synchronize();
+  for (int i = 0; i < n; ++i)
+    if (rings[i])
+      rings[i]->head = heads[i];
+
+  pthread_mutex_unlock(&drain_mutex);
+  return total;
+}
+
+static void *writer_main(void *arg) {
+  while (!writer_stop) {
+    if (AsyncLogger::drain(false) == 0)
+      usleep(options::async_log_flush_usec);
+  }
+  return NULL;
+}
+
+static void start_writer(void) {
+  writer_stop = false;
+  // created with the libc pthread_create() because we are in Sys space,
+  // so the writer is not a tern thread and never shows up in the runq.
+  int ret = pthread_create(&writer_th, NULL, writer_main, NULL);
+  assert(ret == 0 && "can't create async log writer!");
+  writer_running = true;
+}
+
+/// Writes what the rings hold straight to the current segment, ring by
+/// ring, for a crashing process.  drain() is no good here: it takes
+/// drain_mutex, which the crashing thread may hold, and asserts.  This
+/// only reads the rings and calls write(), so it is async-signal-safe,
+/// but it is best effort: a record being published now may be missed,
+/// records the writer thread is merging now may be written twice, and
+/// the segment may outgrow async_log_segment_size.  Records come out in
+/// turn order per thread, which is how eval/sync-log-to-txt.py splits
+/// them, but not merged across threads.
+static void dump_rings(void) {
+  if (log_fd < 0)
+    return;
+  int n = nrings;
+  for (int i = 0; i < n; ++i) {
+    AsyncLogger::ring_t *r = rings[i];
+    if (!r)
+      continue;
+    uint64_t head = r->head, tail = r->tail;
+    __sync_synchronize();
+    while (head != tail) {
+      // up to the end of the ring buffer, then from its start
+      uint64_t cnt = r->mask + 1 - (head & r->mask);
+      if (cnt > tail - head)
+        cnt = tail - head;
+      const char *p = (const char*)&r->recs[head & r->mask];
+      size_t len = cnt * sizeof(AsyncSyncRec);
+      while (len) {
+        ssize_t ret = write(log_fd, p, len);
+        if (ret < 0 && errno == EINTR)
+          continue;
+        if (ret <= 0)
+          return;
+        p += ret;
+        len -= ret;
+      }
+      head += cnt;
+    }
+  }
+}
+
+static void fatal_signal_handler(int sig) {
+  int saved_errno = errno;
+  dump_rings();
+  if (log_fd >= 0)
+    fsync(log_fd);
+  errno = saved_errno;
+  // SA_RESETHAND restored the default action; re-raise to die with the
+  // original signal.
+  raise(sig);
+}
+
+static void init_ring_size(void) {
+  ring_size = 1;
+  while (ring_size < (uint64_t)options::async_log_ring_size)
+    ring_size <<= 1;
+}
+
+void AsyncLogger::progBegin() {
+  if (!ring_size)
+    init_ring_size();
+  log_pid = options::pid_in_logfilename ? getpid() : 0;
+  seg_no = 0;
+  open_segment();
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = fatal_signal_handler;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESETHAND | SA_NODEFER;
+  for (unsigned i = 0; i < sizeof(fatal_signals)/sizeof(fatal_signals[0]); ++i)
+    sigaction(fatal_signals[i], &sa, NULL);
+
+  start_writer();
+}
+
+void AsyncLogger::progEnd() {
+  if (writer_running) {
+    writer_stop = true;
+    pthread_join(writer_th, NULL);
+    writer_running = false;
+  }
+  drain(true);
+  pthread_mutex_lock(&drain_mutex);
+  if (log_fd >= 0) {
+    close(log_fd);
+    log_fd = -1;
+  }
+  pthread_mutex_unlock(&drain_mutex);
+}
+
+/// In the child, the parent's writer thread is gone and drain_mutex may
+/// have been copied in the locked state.  Records still in the rings
+/// belong to the parent, which writes them out itself, so drop them and
+/// start a new log named after the child's pid.
+void AsyncLogger::childForkReturn() {
+  pthread_mutex_init(&drain_mutex, NULL);
+  for (int i = 0; i < nrings; ++i)
+    if (rings[i])
+      rings[i]->head = rings[i]->tail;
+  log_fd = -1;
+  log_pid = getpid();
+  seg_no = 0;
+  open_segment();
+  writer_running = false;
+  start_writer();
+}
+
+AsyncLogger::AsyncLogger(int thid) {
+  tid = thid;
+  assert(tid >= 0 && tid < MAX_THREAD_NUM);
+  pthread_mutex_lock(&drain_mutex);
+  if (!ring_size)
+    init_ring_size();
+  if (!rings[tid]) {
+    size_t size = sizeof(ring_t) + (ring_size - 1) * sizeof(AsyncSyncRec);
+    ring_t *r = (ring_t*)malloc(size);
+    assert(r && "can't allocate async log ring!");
+    memset(r, 0, sizeof(ring_t));
+    r->mask = ring_size - 1;
+    rings[tid] = r;
+    if (tid >= nrings)
+      nrings = tid + 1;
+  }
+  // a ring outlives its logger, so a reused tid keeps appending to it
+  ring = rings[tid];
+  pthread_mutex_unlock(&drain_mutex);
+}
+
+AsyncLogger::~AsyncLogger() {
+}
+
+void AsyncLogger::logSync(unsigned insid, unsigned short sync,
+                          uint64_t turn,
+                          timespec time1,
+                          timespec time2, timespec sched_time,
+                          bool after, ...) {
+  assert(sync >= syncfunc::first_sync && sync < syncfunc::num_syncs
+    && "trying to log unknown synchronization operation!");
+
+  uint64_t t = ring->tail;
+  while (t - ring->head > ring->mask) {
+    // ring is full; the writer only needs our records, which are
+    // already published, to make progress.
+    if (log_fd < 0)
+      return; // log already closed at exit
+    if (writer_running)
+      sched_yield();
+    else
+      drain(false);
+  }
+
+  AsyncSyncRec *rec = &ring->recs[t & ring->mask];
+  rec->turn = turn;
+  rec->insid = insid;
+  rec->tid = tid;
+  rec->sync = sync;
+  rec->after = after;
+  rec->phase = (NumRecordsForSync(sync) == 2) ? (after ? 2 : 1) : 0;
+  rec->app_time = ts2ns(time1);
+  rec->syscall_time = ts2ns(time2);
+  rec->sched_time = ts2ns(sched_time);
+
+  int nargs = NumLoggedSyncArgs(sync);
+  assert(nargs >= 0 && nargs <= (int)MAX_SYNC_ARGS && "sync is not yet handled!");
+  rec->nargs = nargs;
+  va_list args;
+  va_start(args, after);
+  for (int i = 0; i < nargs; ++i)
+    rec->args[i] = va_arg(args, uint64_t);
+  va_end(args);
+
+  // publish the record only after it is fully written
+  __sync_synchronize();
+  ring->tail = t + 1;
+}
+
+void AsyncLogger::flush() {
+  drain(false);
+}
+
+} // namespace tern
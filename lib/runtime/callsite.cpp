@@ -0,0 +1,80 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include "tern/runtime/callsite.h"
+
+namespace tern {
+
+// x86 frame layout with frame pointers: [fp] = caller's fp, [fp+8] = ret
+struct stack_frame {
+  stack_frame *next;
+  void *ret;
+};
+
+static __thread uintptr_t stack_lo = 0;
+static __thread uintptr_t stack_hi = 0;
+
+static void init_stack_bounds(void) {
+  pthread_attr_t attr;
+  void *addr;
+  size_t size;
+  if (pthread_getattr_np(pthread_self(), &attr) != 0)
+    return;
+  if (pthread_attr_getstack(&attr, &addr, &size) == 0) {
+    stack_lo = (uintptr_t)addr;
+    stack_hi = (uintptr_t)addr + size;
+  }
+  pthread_attr_destroy(&attr);
+}
+
+static inline bool on_stack(uintptr_t p) {
+  return p >= stack_lo && p + sizeof(stack_frame) <= stack_hi
+    && (p & (sizeof(void*) - 1)) == 0;
+}
+
+int frameWalk(void *frame, void **rets, int max) {
+  if (!stack_hi)
+    init_stack_bounds();
+  int n = 0;
+  stack_frame *fp = (stack_frame*)frame;
+  while (n < max && on_stack((uintptr_t)fp)) {
+    if (!fp->ret)
+      break;
+    rets[n++] = fp->ret;
+    // frames grow toward higher addresses as we go up the stack
+    if ((uintptr_t)fp->next <= (uintptr_t)fp)
+      break;
+    fp = fp->next;
+  }
+  return n;
+}
+
+uint64_t stackSignature(void *frame, int depth) {
+  void *rets[CALLSITE_MAX_DEPTH];
+  if (depth > CALLSITE_MAX_DEPTH)
+    depth = CALLSITE_MAX_DEPTH;
+  int n = frameWalk(frame, rets, depth);
+  uint64_t ret = 0;
+  for (int i = 0; i < n; ++i)
+    ret = ret * 97 + (uint64_t)rets[i];
+  return ret;
+}
+
+}
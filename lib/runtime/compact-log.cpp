@@ -0,0 +1,281 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "tern/syncfuncs.h"
+#include "tern/runtime/compact-log.h"
+#include "tern/runtime/record-log.h"
+
+namespace tern {
+
+void CompactLogEncoder::reset() {
+  last_turn = 0;
+  insids.clear();
+  objs.clear();
+}
+
+char *CompactLogEncoder::putCode(char *p, dict_t &dict, uint64_t v,
+                                 bool remember) {
+  dict_t::iterator it = dict.find(v);
+  if (it != dict.end())
+    return putVarint(p, it->second + 2);
+  if (remember && dict.size() < COMPACT_DICT_SIZE) {
+    unsigned idx = dict.size();
+    dict[v] = idx;
+    p = putVarint(p, 1);
+  } else
+    p = putVarint(p, 0);
+  return putVarint(p, v);
+}
+
+char *CompactLogEncoder::encode(char *p, const AsyncSyncRec &rec) {
+  p = putVarint(p, ((uint64_t)rec.sync << 3)
+                | ((uint64_t)(rec.after ? 1 : 0) << 2) | rec.phase);
+  p = putCode(p, insids, rec.insid, true);
+  p = putVarint(p, zigzag((int64_t)(rec.turn - last_turn)));
+  p = putVarint(p, rec.app_time);
+  p = putVarint(p, rec.syscall_time);
+  p = putVarint(p, rec.sched_time);
+  last_turn = rec.turn;
+  for (unsigned i = 0; i < rec.nargs; ++i)
+    p = putCode(p, objs, rec.args[i], rec.args[i] >= COMPACT_MIN_DICT_ARG);
+  return p;
+}
+
+CompactLogDecoder::~CompactLogDecoder() {
+  if (buf)
+    munmap(buf, buf_len);
+}
+
+void CompactLogDecoder::reset() {
+  last_turn = 0;
+  insids.clear();
+  objs.clear();
+}
+
+bool CompactLogDecoder::open(const char *file) {
+  int fd = ::open(file, O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(CompactLogHeader)) {
+    close(fd);
+    return false;
+  }
+  char *p = (char*)mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    return false;
+  const CompactLogHeader *hdr = (const CompactLogHeader*)p;
+  if (strncmp(hdr->magic, COMPACT_LOG_MAGIC, sizeof(hdr->magic))) {
+    munmap(p, st.st_size);
+    return false;
+  }
+  buf = p;
+  buf_len = st.st_size;
+  attach(p + sizeof(CompactLogHeader),
+         st.st_size - sizeof(CompactLogHeader), hdr->tid);
+  return true;
+}
+
+void CompactLogDecoder::attach(const char *b, size_t len, int thid) {
+  begin = pos = b;
+  end = b + len;
+  tid = thid;
+  reset();
+}
+
+const char *CompactLogDecoder::getCode(const char *p,
+                                       std::vector<uint64_t> &dict,
+                                       uint64_t &v) {
+  uint64_t code;
+  if (!(p = getVarint(p, end, code)))
+    return NULL;
+  if (code >= 2) {
+    if (code - 2 >= dict.size())
+      return NULL;
+    v = dict[code - 2];
+    return p;
+  }
+  if (!(p = getVarint(p, end, v)))
+    return NULL;
+  if (code == 1)
+    dict.push_back(v);
+  return p;
+}
+
+bool CompactLogDecoder::next(AsyncSyncRec &rec) {
+  const char *p = pos;
+  uint64_t v;
+  if (p >= end)
+    return false;
+
+  memset(&rec, 0, sizeof(rec));
+  rec.tid = tid;
+  if (!(p = getVarint(p, end, v)))
+    goto truncated;
+  rec.sync = v >> 3;
+  rec.after = (v >> 2) & 1;
+  rec.phase = v & 3;
+  if (!(p = getCode(p, insids, v)))
+    goto truncated;
+  rec.insid = v;
+  if (!(p = getVarint(p, end, v)))
+    goto truncated;
+  rec.turn = last_turn += unzigzag(v);
+  if (!(p = getVarint(p, end, v)))
+    goto truncated;
+  rec.app_time = v;
+  if (!(p = getVarint(p, end, v)))
+    goto truncated;
+  rec.syscall_time = v;
+  if (!(p = getVarint(p, end, v)))
+    goto truncated;
+  rec.sched_time = v;
+  {
+    int nargs = NumLoggedSyncArgs(rec.sync);
+    if (nargs < 0)
+      goto truncated;
+    rec.nargs = nargs;
+    for (int i = 0; i < nargs; ++i) {
+      if (!(p = getCode(p, objs, v)))
+        goto truncated;
+      rec.args[i] = v;
+    }
+  }
+  pos = p;
+  return true;
+
+truncated:
+  // a crash can leave a partial record at the end; stop there
+  fprintf(stderr, "compact log of thread %d: bad record at offset %ld\n",
+          tid, (long)(pos - begin));
+  pos = end;
+  return false;
+}
+
+void CompactLogDecoder::print(FILE *f, const AsyncSyncRec &rec) {
+  const char *name = (rec.sync >= syncfunc::first_sync
+                      && rec.sync < syncfunc::num_syncs) ?
+    syncfunc::getName(rec.sync) : "unknown";
+  if (rec.sync == syncfunc::tern_thread_begin
+      || rec.sync == syncfunc::tern_thread_end)
+    fprintf(f, "%s 0x%x", name, rec.insid);
+  else {
+    static const char *suffix[] = {"", "_first", "_second"};
+    fprintf(f, "%s%s 0x%08x", name, suffix[rec.phase % 3], rec.insid);
+  }
+  fprintf(f, " %llu %llu:%09llu %llu:%09llu %llu:%09llu %d",
+          (unsigned long long)rec.turn,
+          (unsigned long long)(rec.app_time / 1000000000ULL),
+          (unsigned long long)(rec.app_time % 1000000000ULL),
+          (unsigned long long)(rec.syscall_time / 1000000000ULL),
+          (unsigned long long)(rec.syscall_time % 1000000000ULL),
+          (unsigned long long)(rec.sched_time / 1000000000ULL),
+          (unsigned long long)(rec.sched_time % 1000000000ULL),
+          rec.tid);
+  for (unsigned i = 0; i < rec.nargs; ++i)
+    fprintf(f, " 0x%llx", (unsigned long long)rec.args[i]);
+  fprintf(f, "\n");
+}
+
+static void write_all(int fd, const char *p, size_t len) {
+  while (len) {
+    ssize_t ret = write(fd, p, len);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    assert(ret > 0 && "can't write compact log!");
+    p += ret;
+    len -= ret;
+  }
+}
+
+CompactLogger::CompactLogger(int thid) {
+  char logFile[64];
+  getLogFilename(logFile, sizeof(logFile), thid, ".cmp");
+
+  tid = thid;
+  fd = open(logFile, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+  assert(fd >= 0 && "can't open log file for write!");
+  buf = cur = (char*)malloc(COMPACT_BUF_SIZE);
+  assert(buf && "can't allocate compact log buffer!");
+
+  CompactLogHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  strncpy(hdr.magic, COMPACT_LOG_MAGIC, sizeof(hdr.magic));
+  hdr.tid = tid;
+  write_all(fd, (const char*)&hdr, sizeof(hdr));
+}
+
+CompactLogger::~CompactLogger() {
+  flush();
+  close(fd);
+  free(buf);
+}
+
+void CompactLogger::flush() {
+  write_all(fd, buf, cur - buf);
+  cur = buf;
+}
+
+void CompactLogger::logSync(unsigned insid, unsigned short sync,
+                            uint64_t turn,
+                            timespec time1,
+                            timespec time2, timespec sched_time,
+                            bool after, ...) {
+  assert(sync >= syncfunc::first_sync && sync < syncfunc::num_syncs
+    && "trying to log unknown synchronization operation!");
+
+  AsyncSyncRec rec;
+  rec.turn = turn;
+  rec.insid = insid;
+  rec.tid = tid;
+  rec.sync = sync;
+  rec.after = after;
+  rec.phase = (NumRecordsForSync(sync) == 2) ? (after ? 2 : 1) : 0;
+  rec.app_time = (uint64_t)time1.tv_sec * 1000000000ULL + time1.tv_nsec;
+  rec.syscall_time = (uint64_t)time2.tv_sec * 1000000000ULL + time2.tv_nsec;
+  rec.sched_time = (uint64_t)sched_time.tv_sec * 1000000000ULL
+    + sched_time.tv_nsec;
+
+  int nargs = NumLoggedSyncArgs(sync);
+  assert(nargs >= 0 && nargs <= (int)MAX_SYNC_ARGS && "sync is not yet handled!");
+  rec.nargs = nargs;
+  va_list args;
+  va_start(args, after);
+  for (int i = 0; i < nargs; ++i)
+    rec.args[i] = va_arg(args, uint64_t);
+  va_end(args);
+
+  if (cur + COMPACT_MAX_REC > buf + COMPACT_BUF_SIZE)
+    flush();
+  cur = enc.encode(cur, rec);
+}
+
+} // namespace tern
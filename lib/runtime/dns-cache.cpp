@@ -0,0 +1,199 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+#include "tern/runtime/dns-cache.h"
+
+using namespace std;
+
+namespace tern {
+
+static inline size_t align_up(size_t n, size_t a) {
+  return (n + a - 1) & ~(a - 1);
+}
+
+string DnsCache::addrInfoKey(const char *node, const char *service,
+                             const struct addrinfo *hints) {
+  ostringstream key;
+  // '\0' cannot appear inside a node or service name, so use it as the
+  // separator; a NULL name and an empty name must not collide either.
+  key << (node ? 'n' : '-') << (node ? node : "") << '\0'
+      << (service ? 's' : '-') << (service ? service : "") << '\0';
+  if (hints)
+    key << hints->ai_flags << ',' << hints->ai_family << ','
+        << hints->ai_socktype << ',' << hints->ai_protocol;
+  else
+    key << '-';
+  return key.str();
+}
+
+/// copy a whole list into one malloc()ed block, so it can be shared and
+/// freed in one go.
+struct addrinfo *DnsCache::copyAddrInfo(const struct addrinfo *ai) {
+  const size_t A = sizeof(void*);
+  size_t size = 0;
+  for (const struct addrinfo *p = ai; p; p = p->ai_next) {
+    size += align_up(sizeof(struct addrinfo), A);
+    size += align_up(p->ai_addrlen, A);
+    if (p->ai_canonname)
+      size += align_up(strlen(p->ai_canonname) + 1, A);
+  }
+  if (size == 0)
+    return NULL;
+
+  char *block = (char*)malloc(size);
+  assert(block && "can't allocate dns cache entry!");
+  char *cur = block;
+  struct addrinfo *head = NULL, **link = &head;
+  for (const struct addrinfo *p = ai; p; p = p->ai_next) {
+    struct addrinfo *q = (struct addrinfo*)cur;
+    cur += align_up(sizeof(struct addrinfo), A);
+    *q = *p;
+    q->ai_next = NULL;
+    if (p->ai_addr) {
+      q->ai_addr = (struct sockaddr*)cur;
+      memcpy(q->ai_addr, p->ai_addr, p->ai_addrlen);
+    }
+    cur += align_up(p->ai_addrlen, A);
+    if (p->ai_canonname) {
+      q->ai_canonname = cur;
+      strcpy(q->ai_canonname, p->ai_canonname);
+      cur += align_up(strlen(p->ai_canonname) + 1, A);
+    }
+    *link = q;
+    link = &q->ai_next;
+  }
+  assert(cur == block + size);
+  return head;
+}
+
+bool DnsCache::lookupAddrInfo(const char *node, const char *service,
+                              const struct addrinfo *hints, struct addrinfo **res) {
+  ai_map::iterator it = addrinfos.find(addrInfoKey(node, service, hints));
+  if (it == addrinfos.end())
+    return false;
+  ++ refs[it->second];
+  *res = it->second;
+  return true;
+}
+
+void DnsCache::insertAddrInfo(const char *node, const char *service,
+                              const struct addrinfo *hints, const struct addrinfo *ai,
+                              struct addrinfo **res) {
+  string key = addrInfoKey(node, service, hints);
+  ai_map::iterator it = addrinfos.find(key);
+  if (it == addrinfos.end()) {
+    // first resolution of this key wins; later racing resolutions are
+    // dropped so every thread sees the same answer.
+    struct addrinfo *copy = copyAddrInfo(ai);
+    assert(copy && "caching an empty getaddrinfo() result!");
+    it = addrinfos.insert(make_pair(key, copy)).first;
+    refs[copy] = 1;
+  }
+  ++ refs[it->second];
+  *res = it->second;
+}
+
+bool DnsCache::releaseAddrInfo(struct addrinfo *res) {
+  ref_map::iterator it = refs.find(res);
+  if (it == refs.end())
+    return false;
+  assert(it->second > 1 && "freeaddrinfo() on a list more times than it was returned!");
+  -- it->second;
+  return true;
+}
+
+int DnsCache::copyHost(const struct hostent *src, struct hostent *dst,
+                       char *buf, size_t buflen) {
+  const size_t A = sizeof(char*);
+  size_t naliases = 0, naddrs = 0, strsize = strlen(src->h_name) + 1;
+  for (char **p = src->h_aliases; p && *p; ++p, ++naliases)
+    strsize += strlen(*p) + 1;
+  for (char **p = src->h_addr_list; p && *p; ++p)
+    ++ naddrs;
+
+  size_t pad = align_up((uintptr_t)buf, A) - (uintptr_t)buf;
+  size_t need = pad + (naliases + 1 + naddrs + 1) * sizeof(char*)
+    + naddrs * src->h_length + strsize;
+  if (need > buflen)
+    return ERANGE;
+
+  char **aliases = (char**)(buf + pad);
+  char **addrs = aliases + naliases + 1;
+  char *cur = (char*)(addrs + naddrs + 1);
+  for (size_t i = 0; i < naddrs; ++i) {
+    addrs[i] = cur;
+    memcpy(cur, src->h_addr_list[i], src->h_length);
+    cur += src->h_length;
+  }
+  addrs[naddrs] = NULL;
+  for (size_t i = 0; i < naliases; ++i) {
+    aliases[i] = cur;
+    strcpy(cur, src->h_aliases[i]);
+    cur += strlen(cur) + 1;
+  }
+  aliases[naliases] = NULL;
+  dst->h_name = cur;
+  strcpy(cur, src->h_name);
+
+  dst->h_aliases = aliases;
+  dst->h_addrtype = src->h_addrtype;
+  dst->h_length = src->h_length;
+  dst->h_addr_list = addrs;
+  return 0;
+}
+
+struct hostent *DnsCache::lookupHost(const char *name) {
+  host_map::iterator it = hosts.find(name);
+  return it == hosts.end() ? NULL : it->second;
+}
+
+struct hostent *DnsCache::insertHost(const char *name, const struct hostent *h) {
+  host_map::iterator it = hosts.find(name);
+  if (it != hosts.end())
+    return it->second;
+
+  // grow the block until the copy fits
+  size_t size = sizeof(struct hostent) + 256;
+  while (true) {
+    char *block = (char*)malloc(size);
+    assert(block && "can't allocate dns cache entry!");
+    struct hostent *copy = (struct hostent*)block;
+    if (copyHost(h, copy, block + sizeof(struct hostent),
+                 size - sizeof(struct hostent)) == 0) {
+      hosts[name] = copy;
+      return copy;
+    }
+    free(block);
+    size *= 2;
+  }
+}
+
+DnsCache::~DnsCache() {
+  for (ref_map::iterator it = refs.begin(); it != refs.end(); ++it)
+    free(it->first);
+  for (host_map::iterator it = hosts.begin(); it != hosts.end(); ++it)
+    free(it->second);
+}
+
+}
@@ -397,6 +397,13 @@ void tern_set_base_time_real(struct timespec *ts) {
   errno = error;
 }
 
+void tern_coalesce_next_real(unsigned insid) {
+  int error = errno;
+  Space::enterSys();
+  Runtime::the->coalesceNext(insid);
+  Space::exitSys();
+  errno = error;
+}
 
 void tern_non_det_barrier_end_real(int bar_id, int cnt) {
   int error = errno;
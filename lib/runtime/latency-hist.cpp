@@ -0,0 +1,199 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+#include "tern/options.h"
+#include "tern/syncfuncs.h"
+#include "tern/runtime/latency-hist.h"
+
+using namespace std;
+
+namespace tern {
+
+enum { LAT_MAX_THREADS = 8192 };
+
+struct LatencyTable {
+  LatencySite sites[LAT_MAX_SITES];
+};
+
+static LatencyTable *lat_tables[LAT_MAX_THREADS];
+static volatile unsigned lat_ntables = 0;
+static __thread LatencyTable *lat_self = NULL;
+
+void LatencyHist::merge(const LatencyHist &o) {
+  for (unsigned i = 0; i < LAT_NUM_BUCKETS; ++i)
+    counts[i] += o.counts[i];
+  total_ns += o.total_ns;
+  if (o.max_ns > max_ns)
+    max_ns = o.max_ns;
+}
+
+uint64_t LatencyHist::count() const {
+  uint64_t n = 0;
+  for (unsigned i = 0; i < LAT_NUM_BUCKETS; ++i)
+    n += counts[i];
+  return n;
+}
+
+uint64_t LatencyHist::percentile(double p) const {
+  uint64_t n = count();
+  if (n == 0)
+    return 0;
+  uint64_t rank = (uint64_t)(p / 100.0 * n + 0.5);
+  if (rank < 1)
+    rank = 1;
+  uint64_t seen = 0;
+  for (unsigned i = 0; i < LAT_NUM_BUCKETS; ++i) {
+    seen += counts[i];
+    if (seen >= rank)
+      return bucketLow(i);
+  }
+  return bucketLow(LAT_NUM_BUCKETS - 1);
+}
+
+static LatencyTable *new_table(void) {
+  unsigned i = __sync_fetch_and_add(&lat_ntables, 1);
+  if (i >= LAT_MAX_THREADS) {
+    lat_self = (LatencyTable*)-1;
+    return NULL;
+  }
+  // mmap so that threads that never log do not cost memory, and so that
+  // no malloc() runs inside a hooked sync op
+  void *p = mmap(0, sizeof(LatencyTable), PROT_READ|PROT_WRITE,
+                 MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  assert(p != MAP_FAILED && "can't allocate latency table!");
+  lat_tables[i] = (LatencyTable*)p;
+  lat_self = (LatencyTable*)p;
+  return lat_self;
+}
+
+void LatencyStat::record(LatencyKind kind, unsigned short sync,
+                         unsigned insid, uint64_t ns) {
+  LatencyTable *t = lat_self;
+  if (!t)
+    t = new_table();
+  if (!t || t == (LatencyTable*)-1)
+    return;
+
+  // open addressing; the last slot collects sites that do not fit
+  unsigned h = (insid * 2654435761U + sync) % (LAT_MAX_SITES - 1);
+  LatencySite *site = &t->sites[LAT_MAX_SITES - 1];
+  for (unsigned i = 0; i < LAT_MAX_SITES - 1; ++i) {
+    LatencySite *s = &t->sites[(h + i) % (LAT_MAX_SITES - 1)];
+    if (s->sync == sync && s->insid == insid) {
+      site = s;
+      break;
+    }
+    if (s->sync == 0) {
+      s->sync = sync;
+      s->insid = insid;
+      site = s;
+      break;
+    }
+  }
+  site->hists[kind].add(ns);
+}
+
+void LatencyStat::dump(void) {
+  typedef map<pair<unsigned short, unsigned>, LatencySite> site_map;
+  site_map merged;
+
+  unsigned n = lat_ntables;
+  if (n > LAT_MAX_THREADS)
+    n = LAT_MAX_THREADS;
+  for (unsigned t = 0; t < n; ++t) {
+    LatencyTable *tab = lat_tables[t];
+    if (!tab)
+      continue;
+    for (unsigned i = 0; i < LAT_MAX_SITES; ++i) {
+      const LatencySite &s = tab->sites[i];
+      bool used = false;
+      for (unsigned k = 0; k < LAT_NUM_KINDS; ++k)
+        used = used || s.hists[k].count();
+      if (!used)
+        continue;
+      // the overflow slot has no single site; report it as op 0
+      pair<unsigned short, unsigned> key = (i == LAT_MAX_SITES - 1) ?
+        make_pair((unsigned short)0, 0U) : make_pair(s.sync, s.insid);
+      site_map::iterator it = merged.find(key);
+      if (it == merged.end()) {
+        LatencySite &m = merged[key];
+        memset(&m, 0, sizeof(m));
+        m.sync = key.first;
+        m.insid = key.second;
+        it = merged.find(key);
+      }
+      for (unsigned k = 0; k < LAT_NUM_KINDS; ++k)
+        it->second.hists[k].merge(s.hists[k]);
+    }
+  }
+  if (merged.empty())
+    return;
+
+  char path[1024];
+  mkdir(options::output_dir.c_str(), 0777);
+  snprintf(path, sizeof(path), "%s/latency-%d.csv",
+           options::output_dir.c_str(), (int)getpid());
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    perror(path);
+    return;
+  }
+
+  static const char *kinds[] = {"turn_wait", "in_turn", "syscall"};
+  fprintf(f, "op,insid,kind,count,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,buckets\n");
+  for (site_map::iterator it = merged.begin(); it != merged.end(); ++it) {
+    const LatencySite &s = it->second;
+    const char *op = (s.sync >= syncfunc::first_sync && s.sync < syncfunc::num_syncs) ?
+      syncfunc::getName(s.sync) : "other";
+    for (unsigned k = 0; k < LAT_NUM_KINDS; ++k) {
+      const LatencyHist &h = s.hists[k];
+      uint64_t cnt = h.count();
+      if (!cnt)
+        continue;
+      fprintf(f, "%s,0x%x,%s,%llu,%llu,%llu,%llu,%llu,%llu,%llu,", op,
+              s.insid, kinds[k], (unsigned long long)cnt,
+              (unsigned long long)(h.total_ns / cnt),
+              (unsigned long long)h.percentile(50),
+              (unsigned long long)h.percentile(90),
+              (unsigned long long)h.percentile(99),
+              (unsigned long long)h.percentile(99.9),
+              (unsigned long long)h.max_ns);
+      // non-empty buckets as low_ns:count, so runs can be re-merged
+      const char *sep = "";
+      for (unsigned b = 0; b < LAT_NUM_BUCKETS; ++b)
+        if (h.counts[b]) {
+          fprintf(f, "%s%llu:%u", sep,
+                  (unsigned long long)LatencyHist::bucketLow(b), h.counts[b]);
+          sep = " ";
+        }
+      fprintf(f, "\n");
+    }
+  }
+  fclose(f);
+}
+
+}
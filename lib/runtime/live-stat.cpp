@@ -0,0 +1,112 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "tern/options.h"
+#include "tern/runtime/live-stat.h"
+
+namespace tern {
+
+LiveStatShm *LiveStat::shm = NULL;
+LiveThreadStat LiveStat::dropped;
+
+static void create_segment(void) {
+  char name[64];
+  getLiveStatName(name, sizeof(name), getpid());
+  int fd = shm_open(name, O_CREAT|O_RDWR|O_TRUNC, 0644);
+  if (fd < 0) {
+    perror("live_stat: shm_open");
+    return;
+  }
+  if (ftruncate(fd, sizeof(LiveStatShm)) < 0) {
+    perror("live_stat: ftruncate");
+    close(fd);
+    shm_unlink(name);
+    return;
+  }
+  void *p = mmap(0, sizeof(LiveStatShm), PROT_READ|PROT_WRITE,
+                 MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    perror("live_stat: mmap");
+    shm_unlink(name);
+    return;
+  }
+
+  LiveStatShm *s = (LiveStatShm*)p; // zero-filled by ftruncate
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  s->version = LIVE_STAT_VERSION;
+  s->pid = getpid();
+  s->start_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  // readers check the magic last
+  __sync_synchronize();
+  strncpy(s->magic, LIVE_STAT_MAGIC, sizeof(s->magic));
+  LiveStat::shm = s;
+}
+
+void LiveStat::progBegin(void) {
+  if (options::live_stat)
+    create_segment();
+}
+
+/// only remove the name; threads that have not noticed the program end
+/// may still write to the segment, so it stays mapped until exit.
+void LiveStat::progEnd(void) {
+  if (!shm)
+    return;
+  char name[64];
+  getLiveStatName(name, sizeof(name), getpid());
+  shm_unlink(name);
+}
+
+/// the child inherits the parent's mapping; stop writing to it and
+/// publish a segment of its own.
+void LiveStat::childForkReturn(void) {
+  if (!shm)
+    return;
+  LiveStatShm *s = shm;
+  shm = NULL;
+  munmap(s, sizeof(LiveStatShm));
+  create_segment();
+}
+
+void LiveStat::objWaited(void *addr, uint64_t ns) {
+  uint64_t a = (uint64_t)(uintptr_t)addr;
+  unsigned h = (unsigned)((a >> 4) * 2654435761U) % LIVE_STAT_MAX_OBJS;
+  for (unsigned i = 0; i < 16; ++i) {
+    LiveObjStat &o = shm->objs[(h + i) % LIVE_STAT_MAX_OBJS];
+    if (o.addr == a || o.addr == 0) {
+      o.waits = o.waits + 1;
+      o.wait_ns = o.wait_ns + ns;
+      o.addr = a;
+      return;
+    }
+  }
+  shm->obj_overflow_ns = shm->obj_overflow_ns + ns;
+}
+
+}
@@ -16,67 +16,295 @@
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include "tern/runtime/rdtsc.h"
 
 using namespace std;
 
-pthread_spinlock_t rdtsc_lock;
-const size_t max_v_size = 300000000;
-std::vector<sync_op_entry *> rdtsc_log;
-size_t rdtsc_index = (size_t)-1;
+// Each thread appends to its own chain of mmap()ed chunks, so recording
+// an op takes neither malloc() nor a lock.  Chains are merged by clock
+// when the log is processed, at exit or on options::rdtsc_dump_signal.
+enum {
+  RDTSC_CHUNK_ENTRIES = 64*1024,
+  RDTSC_MAX_THREADS   = 8192
+};
+
+struct rdtsc_chunk {
+  rdtsc_chunk *next;
+  volatile size_t n;  // # of entries published by the owner thread
+  size_t consumed;    // # of entries already written out
+  sync_op_entry entries[RDTSC_CHUNK_ENTRIES];
+};
+
+struct rdtsc_thread {
+  unsigned tid;
+  rdtsc_chunk *head;  // advanced only by process_rdtsc_log()
+  rdtsc_chunk *tail;  // advanced only by the owner thread
+};
+
+static rdtsc_thread rdtsc_threads[RDTSC_MAX_THREADS];
+static volatile unsigned rdtsc_nthreads = 0;
+static __thread rdtsc_thread *rdtsc_self = NULL;
+static volatile int rdtsc_inited = 0;
+static volatile int rdtsc_processing = 0;
+
+static rdtsc_chunk *new_rdtsc_chunk(void) {
+  void *p = mmap(0, sizeof(rdtsc_chunk), PROT_READ|PROT_WRITE,
+                 MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  assert(p != MAP_FAILED && "can't allocate rdtsc log chunk!");
+  return (rdtsc_chunk*)p; // zero-filled
+}
+
+static void rdtsc_signal_handler(int sig) {
+  process_rdtsc_log();
+}
+
+static void init_rdtsc_log(void) {
+  if (__sync_bool_compare_and_swap(&rdtsc_inited, 0, 1)) {
+    atexit(process_rdtsc_log);
+    if (options::rdtsc_dump_signal > 0) {
+      struct sigaction sa;
+      memset(&sa, 0, sizeof(sa));
+      sa.sa_handler = rdtsc_signal_handler;
+      sigemptyset(&sa.sa_mask);
+      sa.sa_flags = SA_RESTART;
+      sigaction(options::rdtsc_dump_signal, &sa, NULL);
+    }
+  }
+}
+
+static rdtsc_thread *register_rdtsc_thread(void) {
+  init_rdtsc_log();
+  unsigned i = __sync_fetch_and_add(&rdtsc_nthreads, 1);
+  if (i >= RDTSC_MAX_THREADS) {
+    fprintf(stderr, "rdtsc log: too many threads, thread %u not traced\n",
+            (unsigned)pthread_self());
+    rdtsc_self = (rdtsc_thread*)-1;
+    return NULL;
+  }
+  rdtsc_thread *t = &rdtsc_threads[i];
+  rdtsc_chunk *ch = new_rdtsc_chunk();
+  t->tid = (unsigned)pthread_self();
+  t->tail = ch;
+  // process_rdtsc_log() skips threads whose head is not set yet
+  __sync_synchronize();
+  t->head = ch;
+  rdtsc_self = t;
+  return t;
+}
+
+/// min-heap of per-thread cursors, keyed by the clock of the next entry.
+/// Static so that the merge is safe to run from a signal handler.
+struct rdtsc_cursor {
+  rdtsc_chunk *chunk;
+  size_t idx, end;
+};
+static rdtsc_cursor rdtsc_cursors[RDTSC_MAX_THREADS];
+static unsigned rdtsc_heap[RDTSC_MAX_THREADS];
+
+static inline unsigned long long cursor_clock(unsigned c) {
+  return rdtsc_cursors[c].chunk->entries[rdtsc_cursors[c].idx].clock;
+}
+
+static void heap_down(unsigned *heap, unsigned n, unsigned i) {
+  while (true) {
+    unsigned l = 2*i + 1, r = l + 1, m = i;
+    if (l < n && cursor_clock(heap[l]) < cursor_clock(heap[m]))
+      m = l;
+    if (r < n && cursor_clock(heap[r]) < cursor_clock(heap[m]))
+      m = r;
+    if (m == i)
+      return;
+    unsigned tmp = heap[i];
+    heap[i] = heap[m];
+    heap[m] = tmp;
+    i = m;
+  }
+}
+
+/// position cursor @c at the first unconsumed entry of thread @t; returns
+/// false if the thread has nothing new.
+static bool init_cursor(unsigned c, rdtsc_thread *t) {
+  rdtsc_chunk *ch = t->head;
+  while (ch) {
+    size_t n = ch->n;
+    if (ch->consumed < n) {
+      rdtsc_cursors[c].chunk = ch;
+      rdtsc_cursors[c].idx = ch->consumed;
+      rdtsc_cursors[c].end = n;
+      return true;
+    }
+    ch = ch->next;
+  }
+  return false;
+}
+
+static bool advance_cursor(unsigned c) {
+  rdtsc_cursor &cur = rdtsc_cursors[c];
+  if (++ cur.idx < cur.end)
+    return true;
+  cur.chunk->consumed = cur.end;
+  // only move on to the next chunk if this one is full; the owner may
+  // still be appending to it otherwise.
+  if (cur.end < RDTSC_CHUNK_ENTRIES || !cur.chunk->next)
+    return false;
+  cur.chunk = cur.chunk->next;
+  cur.idx = cur.chunk->consumed;
+  cur.end = cur.chunk->n;
+  return cur.idx < cur.end;
+}
+
+/// output buffer of process_rdtsc_log().  The log is formatted by hand and
+/// written with write(), because the dump may run in a signal handler
+/// where stdio and snprintf() are not safe.
+static char rdtsc_out[64*1024];
+static size_t rdtsc_out_len;
+
+static void out_flush(int fd) {
+  size_t off = 0;
+  while (off < rdtsc_out_len) {
+    ssize_t n = write(fd, rdtsc_out + off, rdtsc_out_len - off);
+    if (n <= 0)
+      break;
+    off += n;
+  }
+  rdtsc_out_len = 0;
+}
+
+static void out_str(int fd, const char *s) {
+  for (; *s; ++s) {
+    if (rdtsc_out_len == sizeof(rdtsc_out))
+      out_flush(fd);
+    rdtsc_out[rdtsc_out_len++] = *s;
+  }
+}
+
+static void out_num(int fd, unsigned long long v, unsigned base) {
+  char digits[24];
+  int i = sizeof(digits) - 1;
+  digits[i] = 0;
+  do {
+    digits[--i] = "0123456789abcdef"[v % base];
+    v /= base;
+  } while (v);
+  out_str(fd, digits + i);
+}
 
 void process_rdtsc_log(void) {
-  fprintf(stderr, "Storing rdtsc log...\n");fflush(stderr);
-  char log_path[1024];
-  memset(log_path, 0, 1024);
-  snprintf(log_path, 1024, "%s/pself-pid-%u.txt", options::rdtsc_output_dir.c_str(), (unsigned)getpid());
-  mkdir(options::rdtsc_output_dir.c_str(), 0777);
-  FILE *f = fopen(log_path, "a+");
-  assert(f);
+  // at exit and from the dump signal; the second caller just returns
+  if (!__sync_bool_compare_and_swap(&rdtsc_processing, 0, 1))
+    return;
+  const char storing[] = "Storing rdtsc log...\n";
+  ssize_t ignored = write(2, storing, sizeof(storing) - 1);
+  (void)ignored;
+  const char *dir = options::rdtsc_output_dir.c_str();
+  mkdir(dir, 0777);
+  // build "<dir>/pself-pid-<pid>.txt" in the output buffer
+  rdtsc_out_len = 0;
+  out_str(-1, dir);
+  out_str(-1, "/pself-pid-");
+  out_num(-1, (unsigned)getpid(), 10);
+  out_str(-1, ".txt");
+  if (rdtsc_out_len >= sizeof(rdtsc_out)) {
+    rdtsc_processing = 0;
+    return;
+  }
+  rdtsc_out[rdtsc_out_len] = 0;
+  int fd = open(rdtsc_out, O_WRONLY|O_CREAT|O_APPEND, 0666);
+  rdtsc_out_len = 0;
+  if (fd < 0) {
+    rdtsc_processing = 0;
+    return;
+  }
 
   const char *opdeps[3] = {"", "----", "--------"};
 
-  for (size_t i = 0; i < rdtsc_index; i++) {
-    struct sync_op_entry *entry = rdtsc_log[i];
+  unsigned nthreads = rdtsc_nthreads;
+  if (nthreads > RDTSC_MAX_THREADS)
+    nthreads = RDTSC_MAX_THREADS;
+  __sync_synchronize();
+
+  unsigned n = 0;
+  for (unsigned i = 0; i < nthreads; ++i) {
+    rdtsc_thread *t = &rdtsc_threads[i];
+    if (t->head && init_cursor(i, t))
+      rdtsc_heap[n++] = i;
+  }
+  for (int i = (int)n/2 - 1; i >= 0; --i)
+    heap_down(rdtsc_heap, n, i);
+
+  while (n) {
+    unsigned c = rdtsc_heap[0];
+    const sync_op_entry *entry = &rdtsc_cursors[c].chunk->entries[rdtsc_cursors[c].idx];
     assert(entry->op_print_depth < 3);
-    fprintf(f, "%u %s%s %s %llu %p\n", entry->tid, opdeps[entry->op_print_depth], entry->op, entry->op_suffix, entry->clock, entry->eip);
-    delete entry;
+    // same format as "%u %s%s %s %llu %p\n"
+    out_num(fd, entry->tid, 10);
+    out_str(fd, " ");
+    out_str(fd, opdeps[entry->op_print_depth]);
+    out_str(fd, entry->op);
+    out_str(fd, " ");
+    out_str(fd, entry->op_suffix);
+    out_str(fd, " ");
+    out_num(fd, entry->clock, 10);
+    if (entry->eip) {
+      out_str(fd, " 0x");
+      out_num(fd, (unsigned long)entry->eip, 16);
+      out_str(fd, "\n");
+    } else
+      out_str(fd, " (nil)\n");
+    if (!advance_cursor(c))
+      rdtsc_heap[0] = rdtsc_heap[--n];
+    heap_down(rdtsc_heap, n, 0);
   }
-  rdtsc_log.clear();
-  fflush(f);
-  fclose(f);
-  rdtsc_index = 0;
+
+  // give back chunks that are full and fully written out
+  for (unsigned i = 0; i < nthreads; ++i) {
+    rdtsc_thread *t = &rdtsc_threads[i];
+    while (t->head && t->head->next
+           && t->head->consumed == RDTSC_CHUNK_ENTRIES) {
+      rdtsc_chunk *ch = t->head;
+      t->head = ch->next;
+      munmap(ch, sizeof(rdtsc_chunk));
+    }
+  }
+
+  out_flush(fd);
+  close(fd);
+  rdtsc_processing = 0;
 }
 
 void record_rdtsc_op(const char *op_name, const char *op_suffix, int print_depth, void *eip) {
   if (options::record_rdtsc) {
-    if (rdtsc_index == (size_t)-1) {
-      pthread_spin_init(&rdtsc_lock, 0);
-      //printf("At exit...\n");
-      atexit(process_rdtsc_log);
-      rdtsc_log.reserve (max_v_size);
-      rdtsc_index = 0;
+    rdtsc_thread *t = rdtsc_self;
+    if (!t)
+      t = register_rdtsc_thread();
+    if (!t || t == (rdtsc_thread*)-1)
+      return;
+
+    rdtsc_chunk *ch = t->tail;
+    size_t n = ch->n;
+    if (n == RDTSC_CHUNK_ENTRIES) {
+      rdtsc_chunk *next = new_rdtsc_chunk();
+      ch->next = next;
+      __sync_synchronize();
+      t->tail = ch = next;
+      n = 0;
     }
 
-    struct sync_op_entry *entry = new struct sync_op_entry;    
-    entry->tid = (unsigned)pthread_self();
-    
+    sync_op_entry *entry = &ch->entries[n];
+    entry->tid = t->tid;
     entry->op = op_name;
     entry->op_suffix = op_suffix;
     entry->op_print_depth = (unsigned)print_depth;
     entry->eip = eip;
-
-    pthread_spin_lock(&rdtsc_lock);
-    //assert(rdtsc_index < max_v_size && "Please pre-allocated a bigger vector size for rdtsc log.");
-    if (rdtsc_index%1000000 == 0)
-      fprintf(stderr, "rdtsc_index %u\n", (unsigned)rdtsc_index);
-    if (rdtsc_index >= max_v_size) {
-      process_rdtsc_log();
-    }
-    entry->clock = rdtsc(); // Put this into critical section, so the log is sorted.
-    rdtsc_log[rdtsc_index] = entry;
-    rdtsc_index++;
-    pthread_spin_unlock(&rdtsc_lock);
+    entry->clock = rdtsc();
+    // publish the entry only after it is complete
+    __sync_synchronize();
+    ch->n = n + 1;
   }
   //fprintf(stderr, "%u : %s %s %llu\n", (unsigned)pthread_self(), op_name, op_suffix, rdtsc());
 }
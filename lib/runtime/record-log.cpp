@@ -29,6 +29,8 @@
 #include <string.h>
 #include <time.h>
 #include <pthread.h>
+#include <sched.h>
+#include <deque>
 #include <iostream>
 #include <iomanip>
 #include "tern/runtime/scheduler.h"
@@ -62,7 +64,7 @@ void TxtLogger::print_header()
 }
 
 void TxtLogger::logSync(unsigned insid, unsigned short sync,
-                        unsigned turn, 
+                        uint64_t turn, 
                         timespec time1, 
                         timespec time2, timespec sched_time, 
                         bool after, ...) {
@@ -113,132 +115,17 @@ void TxtLogger::logSync(unsigned insid, unsigned short sync,
   va_list args;
   va_start(args, after);
 
-  switch(sync) {
-    // log nothing, mostly for sched point. 
-  case syncfunc::accept4:
-  case syncfunc::recv:
-  case syncfunc::recvfrom:
-  case syncfunc::recvmsg:
-  case syncfunc::select:
-  case syncfunc::poll:
-  case syncfunc::bind:
-  case syncfunc::listen:
-  case syncfunc::getsockopt:
-  case syncfunc::setsockopt:
-  case syncfunc::pipe:
-  case syncfunc::fcntl:
-  case syncfunc::shutdown:
-  case syncfunc::gethostbyname:
-  case syncfunc::gethostbyname_r:
-  case syncfunc::getaddrinfo:
-  case syncfunc::freeaddrinfo:
-  case syncfunc::gethostbyaddr:
-  case syncfunc::inet_ntoa:
-  case syncfunc::strtok:
-  case syncfunc::epoll_wait:
-  case syncfunc::epoll_create:
-  case syncfunc::epoll_ctl:
-  case syncfunc::sigwait:
-  case syncfunc::fgets:
-  case syncfunc::kill:
-  case syncfunc::fork:
-  case syncfunc::execv:
-  case syncfunc::sched_yield:
-  case syncfunc::wait:
-  case syncfunc::waitpid:
-  case syncfunc::tern_idle:
-  case syncfunc::tern_non_det_start:
-  case syncfunc::tern_non_det_end:
-    break;
-    // log one sync var (common case)
-  case syncfunc::pthread_mutex_init:
-  case syncfunc::pthread_mutex_destroy:
-  case syncfunc::pthread_mutex_lock:
-  case syncfunc::pthread_mutex_unlock:
-  case syncfunc::pthread_barrier_wait:
-  case syncfunc::pthread_barrier_destroy:
-  case syncfunc::pthread_cond_signal:
-  case syncfunc::pthread_cond_broadcast:
-  case syncfunc::sem_wait:
-  case syncfunc::sem_init:
-  case syncfunc::sem_post:
-  case syncfunc::pthread_join:
-  case syncfunc::pthread_detach:
-  case syncfunc::sleep:
-  case syncfunc::usleep:
-  case syncfunc::nanosleep:
-  case syncfunc::pthread_rwlock_rdlock:
-  case syncfunc::pthread_rwlock_wrlock:
-  case syncfunc::tern_lineup_start:
-  case syncfunc::tern_lineup_end:
-  case syncfunc::tern_lineup_destroy:
-    ouf << hex << " 0x" << va_arg(args, uint64_t) << dec;
-    break;
-
-    // log two sync vars for cond_*wait
-  case syncfunc::pthread_mutex_timedlock:
-  case syncfunc::pthread_cond_wait:
-  case syncfunc::pthread_barrier_init:
-  case syncfunc::pthread_create:
-  case syncfunc::pthread_mutex_trylock:
-  case syncfunc::sem_trywait:
-  case syncfunc::sem_timedwait:
-  case syncfunc::pthread_rwlock_tryrdlock:  //  rwlock, ret
-  case syncfunc::pthread_rwlock_trywrlock:
-  case syncfunc::pthread_rwlock_unlock:  //  rwlock, ret
-    {
-      //  notice "<<" operator is expanded from right to left.
-      uint64_t a = va_arg(args, uint64_t);
-      uint64_t b = va_arg(args, uint64_t);
-
-    ouf << hex
-        << " 0x" << a
-        << " 0x" << b
-        << dec;
-    }
-    break;
-    // log three sync vars
-  case syncfunc::pthread_cond_timedwait:  //  cv, mu, ret
-  case syncfunc::read:  //  sig, fd, ret
-  case syncfunc::pread:  //  sig, fd, ret
-  case syncfunc::accept:  //  sock(ret), from_port, to_port
-  case syncfunc::write: //  sig, fd, ret
-  case syncfunc::pwrite: //  sig, fd, ret
-  case syncfunc::tern_lineup_init:
-    {
-      //  notice "<<" operator is explained from right to left.
-      uint64_t a = va_arg(args, uint64_t);
-      uint64_t b = va_arg(args, uint64_t);
-      uint64_t c = va_arg(args, uint64_t);
-
-    ouf << hex
-        << " 0x" << a
-        << " 0x" << b
-        << " 0x" << c
-        << dec;
-    }
-    break;
-  case syncfunc::connect: //  fd, from_port, to_port, ret
-    {
-      //  notice "<<" operator is explained from right to left.
-      uint64_t a = va_arg(args, uint64_t);
-      uint64_t b = va_arg(args, uint64_t);
-      uint64_t c = va_arg(args, uint64_t);
-      uint64_t d = va_arg(args, uint64_t);
-
-    ouf << hex
-        << " 0x" << a
-        << " 0x" << b
-        << " 0x" << c
-        << " 0x" << d
-        << dec;
-    }
-    break;
-
-  default:
+  int nargs = NumLoggedSyncArgs(sync);
+  if (nargs < 0) {
     cerr << "sync " << syncfunc::getName(sync) << " is not yet handled!\n";
     assert(0);
   }
+  //  one va_arg per statement; the order "<<" evaluates operands in is
+  //  unspecified.
+  for (int i = 0; i < nargs; ++i) {
+    uint64_t a = va_arg(args, uint64_t);
+    ouf << hex << " 0x" << a << dec;
+  }
 
   va_end(args);
   ouf << "\n";
@@ -263,35 +150,35 @@ TxtLogger::~TxtLogger()
 void BinLogger::logInsid(unsigned insid) {
   checkAndGrowLogSize();
 
-  InsidRec *rec = (InsidRec*)(buf+off);
+  InsidRec *rec = (InsidRec*)cur;
   rec->setInsid(insid);
   rec->type = InsidRecTy;
 
-  off += RECORD_SIZE;
+  cur += RECORD_SIZE;
 }
 
 void BinLogger::logLoad(unsigned insid, char* addr, uint64_t data) {
   checkAndGrowLogSize();
 
-  LoadRec *rec = (LoadRec*)(buf+off);
+  LoadRec *rec = (LoadRec*)cur;
   rec->setInsid(insid);
   rec->type = LoadRecTy;
   rec->addr = addr;
   rec->data = data;
 
-  off += RECORD_SIZE;
+  cur += RECORD_SIZE;
 }
 
 void BinLogger::logStore(unsigned insid, char* addr, uint64_t data) {
   checkAndGrowLogSize();
 
-  StoreRec *rec = (StoreRec*)(buf+off);
+  StoreRec *rec = (StoreRec*)cur;
   rec->setInsid(insid);
   rec->type = StoreRecTy;
   rec->addr = addr;
   rec->data = data;
 
-  off += RECORD_SIZE;
+  cur += RECORD_SIZE;
 }
 
 void BinLogger::logCall(uint8_t flags, unsigned insid,
@@ -316,7 +203,7 @@ void BinLogger::logCall(uint8_t flags, unsigned insid,
   short nextra = NumExtraArgsRecords(narg);
   short seq = 0;
 
-  CallRec *call = (CallRec*)(buf+off);
+  CallRec *call = (CallRec*)cur;
   call->setInsid(insid);
   call->type = CallRecTy;
   call->flags = flags;
@@ -331,13 +218,13 @@ void BinLogger::logCall(uint8_t flags, unsigned insid,
   for(i=0; i<rec_narg; ++i)
     call->args[i] = va_arg(vl, uint64_t);
 
-  off += RECORD_SIZE;
+  cur += RECORD_SIZE;
 
   // extra args
   for(++seq; seq<=nextra; ++seq) {
     checkAndGrowLogSize();
 
-    ExtraArgsRec *extra = (ExtraArgsRec*)(buf+off);
+    ExtraArgsRec *extra = (ExtraArgsRec*)cur;
     extra->setInsid(insid);
     extra->type = ExtraArgsRecTy;
     extra->seq = seq;
@@ -350,7 +237,7 @@ void BinLogger::logCall(uint8_t flags, unsigned insid,
       ++ rec_i;
       ++ i;
     }
-    off += RECORD_SIZE;
+    cur += RECORD_SIZE;
   }
 }
 
@@ -377,7 +264,7 @@ void BinLogger::logRet(uint8_t flags, unsigned insid,
 
   short seq = NumExtraArgsRecords(narg) + 1;
 
-  ReturnRec *ret = (ReturnRec*)(buf+off);
+  ReturnRec *ret = (ReturnRec*)cur;
   ret->setInsid(insid);
   ret->type = ReturnRecTy;
   ret->flags = flags;
@@ -386,12 +273,12 @@ void BinLogger::logRet(uint8_t flags, unsigned insid,
   ret->funcid = funcs[func];
   ret->data = data;
 
-  off += RECORD_SIZE;
+  cur += RECORD_SIZE;
 }
 
 // TODO: record ret->timedout
 void BinLogger::logSync(unsigned insid, unsigned short sync,
-                     unsigned turn, 
+                     uint64_t turn, 
                      timespec time1, 
                      timespec time2, timespec sched_time, 
                      bool after, ...) {
@@ -399,7 +286,7 @@ void BinLogger::logSync(unsigned insid, unsigned short sync,
   assert(sync >= syncfunc::first_sync && sync < syncfunc::num_syncs
     && "trying to log unknown synchronization operation!");
 
-  SyncRec *rec = (SyncRec*)(buf+off);
+  SyncRec *rec = (SyncRec*)cur;
   rec->setInsid(insid);
   rec->type = SyncRecTy;
   rec->sync = sync;
@@ -414,7 +301,108 @@ void BinLogger::logSync(unsigned insid, unsigned short sync,
     rec->args[i] = va_arg(args, uint64_t);
   va_end(args);
 
-  off += RECORD_SIZE;
+  cur += RECORD_SIZE;
+}
+
+/// background thread that maps and unmaps BinLogger segments, so that
+/// the page-table work of a 1GB mmap/munmap never happens under the turn.
+/// It is created with the libc pthread_create() from Sys space, so it is
+/// not a tern thread.
+struct BinLogMapper {
+  struct req_t {
+    BinLogger *lg; // map the next segment of lg, or
+    char *addr;    // drop and unmap addr if lg is NULL
+  };
+
+  static void post(BinLogger *lg, char *addr) {
+    req_t r = {lg, addr};
+    pthread_mutex_lock(&mu);
+    if (!started) {
+      pthread_t th;
+      int ret = pthread_create(&th, NULL, run, NULL);
+      assert(ret == 0 && "can't create BinLogger mapper thread!");
+      (void)ret;
+      pthread_detach(th);
+      started = true;
+    }
+    reqs.push_back(r);
+    pthread_cond_signal(&cv);
+    pthread_mutex_unlock(&mu);
+  }
+
+  static void *run(void *arg) {
+    while (true) {
+      pthread_mutex_lock(&mu);
+      while (reqs.empty())
+        pthread_cond_wait(&cv, &mu);
+      req_t r = reqs.front();
+      reqs.pop_front();
+      in_flight = r.lg;
+      pthread_mutex_unlock(&mu);
+
+      if (r.lg)
+        mapNext(r.lg);
+      else
+        unmap(r.addr);
+
+      pthread_mutex_lock(&mu);
+      in_flight = NULL;
+      pthread_mutex_unlock(&mu);
+    }
+    return NULL;
+  }
+
+  static void mapNext(BinLogger *lg) {
+    // grow the file before mapping past its end
+    int err = ftruncate(lg->fd, lg->foff + TRUNK_SIZE);
+    assert(err == 0 && "can't resize log file!");
+    (void)err;
+    char *p = (char*)mmap(0, TRUNK_SIZE, PROT_WRITE|PROT_READ,
+                          MAP_SHARED, lg->fd, lg->foff);
+    assert(p!=MAP_FAILED && "can't map log file using mmap()!");
+    dprintf("BinLogMapper: mmapped %p, size %u\n", p, TRUNK_SIZE);
+    lg->next_buf = p;
+    __sync_synchronize();
+    lg->next_pending = false;
+  }
+
+  static void unmap(char *p) {
+    // the data stays in the page cache; we only drop our mapping of it
+    madvise(p, TRUNK_SIZE, MADV_DONTNEED);
+    munmap(p, TRUNK_SIZE);
+    dprintf("BinLogMapper: unmmapped %p, size %u\n", p, TRUNK_SIZE);
+  }
+
+  /// in the child after fork(), the mapper thread is gone.  Requests it
+  /// had not finished are dropped; their loggers map synchronously.
+  static void childForkReturn(void) {
+    pthread_mutex_init(&mu, NULL);
+    pthread_cond_init(&cv, NULL);
+    for (std::deque<req_t>::iterator it = reqs.begin(); it != reqs.end(); ++it)
+      if (it->lg)
+        it->lg->next_pending = false;
+    if (in_flight)
+      in_flight->next_pending = false;
+    reqs.clear();
+    in_flight = NULL;
+    started = false;
+  }
+
+  static pthread_mutex_t mu;
+  static pthread_cond_t cv;
+  static std::deque<req_t> reqs;
+  static BinLogger *in_flight;
+  static bool started;
+};
+
+pthread_mutex_t BinLogMapper::mu = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t BinLogMapper::cv = PTHREAD_COND_INITIALIZER;
+std::deque<BinLogMapper::req_t> BinLogMapper::reqs;
+BinLogger *BinLogMapper::in_flight = NULL;
+bool BinLogMapper::started = false;
+
+void BinLogger::childForkReturn(void) {
+  BinLogMapper::childForkReturn();
 }
 
 BinLogger::BinLogger(int tid) {
@@ -425,46 +413,83 @@ BinLogger::BinLogger(int tid) {
   fd = open(logFile, O_RDWR|O_CREAT, 0600);
   dprintf("logFile = %s\n", logFile);
   assert(fd >= 0 && "can't open log file!");
-  assert(ftruncate(fd, LOG_SIZE) == 0);
+  int err = ftruncate(fd, LOG_SIZE);
+  assert(err == 0 && "can't resize log file!");
+  (void)err;
 
   buf = NULL;
+  next_buf = NULL;
+  next_pending = false;
   mapLogTrunk();
 }
 
 BinLogger::~BinLogger() {
+  // the mapper may still be writing next_buf
+  while (next_pending)
+    sched_yield();
+  if (next_buf)
+    munmap(next_buf, TRUNK_SIZE);
   if(buf)
     munmap(buf, TRUNK_SIZE);
 
   dprintf("unmmapped %p, size %u\n", buf, TRUNK_SIZE);
 
   // truncate unused portion of log
-  off_t size = foff - TRUNK_SIZE + off;
-  assert(ftruncate(fd, size) == 0);
+  off_t size = foff - TRUNK_SIZE + (cur - buf);
+  int err = ftruncate(fd, size);
+  assert(err == 0 && "can't resize log file!");
+  (void)err;
 
   if(fd >= 0)
     close(fd);
 
-  buf = NULL;
-  off = 0;
+  buf = cur = limit = next_buf = NULL;
   fd = -1;
   foff = 0;
 }
 
+void BinLogger::growLog(void) {
+  if (cur < buf + TRUNK_SIZE) {
+    // half way through the current segment; map the next one ahead
+    limit = buf + TRUNK_SIZE;
+    next_pending = true;
+    BinLogMapper::post(this, NULL);
+    return;
+  }
+  mapLogTrunk();
+}
+
 void BinLogger::mapLogTrunk(void) {
-  if(buf)
-    munmap(buf, TRUNK_SIZE);
+  while (next_pending)
+    sched_yield();
+  __sync_synchronize();
 
-  buf = (char*)mmap(0, TRUNK_SIZE, PROT_WRITE|PROT_READ,
-                     MAP_SHARED, fd, foff);
-  assert(buf!=MAP_FAILED && "can't map log file using mmap()!");
-  dprintf("BinLogger: mmapped %p, size %u\n", buf, TRUNK_SIZE);
-  off = 0;
+  if(buf)
+    BinLogMapper::post(NULL, buf);
+
+  if (next_buf) {
+    buf = next_buf;
+    next_buf = NULL;
+  } else {
+    // first segment, or the mapper lost our request across fork()
+    if (foff + TRUNK_SIZE > LOG_SIZE) {
+      int err = ftruncate(fd, foff + TRUNK_SIZE);
+      assert(err == 0 && "can't resize log file!");
+      (void)err;
+    }
+    buf = (char*)mmap(0, TRUNK_SIZE, PROT_WRITE|PROT_READ,
+                      MAP_SHARED, fd, foff);
+    assert(buf!=MAP_FAILED && "can't map log file using mmap()!");
+    dprintf("BinLogger: mmapped %p, size %u\n", buf, TRUNK_SIZE);
+  }
+  cur = buf;
+  limit = buf + TRUNK_SIZE / 2;
   foff += TRUNK_SIZE;
 }
 
 
 void TestLogger::logSync(unsigned insid, unsigned short sync,
-                        unsigned turn, 
+                        uint64_t turn, 
                        timespec time1, 
                        timespec time2, timespec sched_time, 
                         bool after, ...) {
@@ -517,132 +542,17 @@ void TestLogger::logSync(unsigned insid, unsigned short sync,
   va_list args;
   va_start(args, after);
 
-  switch(sync) {
-    // log nothing, mostly for sched point. 
-  case syncfunc::accept4:
-  case syncfunc::recv:
-  case syncfunc::recvfrom:
-  case syncfunc::recvmsg:
-  case syncfunc::select:
-  case syncfunc::poll:
-  case syncfunc::bind:
-  case syncfunc::listen:
-  case syncfunc::getsockopt:
-  case syncfunc::setsockopt:
-  case syncfunc::pipe:
-  case syncfunc::fcntl:
-  case syncfunc::shutdown:
-  case syncfunc::gethostbyname:
-  case syncfunc::gethostbyname_r:
-  case syncfunc::getaddrinfo:
-  case syncfunc::freeaddrinfo:
-  case syncfunc::gethostbyaddr:
-  case syncfunc::inet_ntoa:
-  case syncfunc::strtok:
-  case syncfunc::epoll_wait:
-  case syncfunc::epoll_create:
-  case syncfunc::epoll_ctl:
-  case syncfunc::sigwait:
-  case syncfunc::fgets:
-  case syncfunc::kill:
-  case syncfunc::fork:
-  case syncfunc::execv:
-  case syncfunc::sched_yield:
-  case syncfunc::wait:
-  case syncfunc::waitpid:
-  case syncfunc::tern_idle:
-  case syncfunc::tern_non_det_start:
-  case syncfunc::tern_non_det_end:
-    break;
-    // log one sync var (common case)
-  case syncfunc::pthread_mutex_init:
-  case syncfunc::pthread_mutex_destroy:
-  case syncfunc::pthread_mutex_lock:
-  case syncfunc::pthread_mutex_unlock:
-  case syncfunc::pthread_barrier_wait:
-  case syncfunc::pthread_barrier_destroy:
-  case syncfunc::pthread_cond_signal:
-  case syncfunc::pthread_cond_broadcast:
-  case syncfunc::sem_wait:
-  case syncfunc::sem_init:
-  case syncfunc::sem_post:
-  case syncfunc::pthread_join:
-  case syncfunc::pthread_detach:
-  case syncfunc::sleep:
-  case syncfunc::usleep:
-  case syncfunc::nanosleep:
-  case syncfunc::pthread_rwlock_rdlock:
-  case syncfunc::pthread_rwlock_wrlock:
-  case syncfunc::tern_lineup_start:
-  case syncfunc::tern_lineup_end:
-  case syncfunc::tern_lineup_destroy:
-    ouf << hex << " 0x" << va_arg(args, uint64_t) << dec;
-    break;
-
-    // log two sync vars for cond_*wait
-  case syncfunc::pthread_mutex_timedlock:
-  case syncfunc::pthread_cond_wait:
-  case syncfunc::pthread_barrier_init:
-  case syncfunc::pthread_create:
-  case syncfunc::pthread_mutex_trylock:
-  case syncfunc::sem_trywait:
-  case syncfunc::sem_timedwait:
-  case syncfunc::pthread_rwlock_tryrdlock:  //  rwlock, ret
-  case syncfunc::pthread_rwlock_trywrlock:
-  case syncfunc::pthread_rwlock_unlock:  //  rwlock, ret
-    {
-      //  notice "<<" operator is expanded from right to left.
-      uint64_t a = va_arg(args, uint64_t);
-      uint64_t b = va_arg(args, uint64_t);
-
-    ouf << hex
-        << " 0x" << a
-        << " 0x" << b
-        << dec;
-    }
-    break;
-    // log three sync vars
-  case syncfunc::pthread_cond_timedwait:  //  cv, mu, ret
-  case syncfunc::read:  //  sig, fd, ret
-  case syncfunc::pread:  //  sig, fd, ret
-  case syncfunc::accept:  //  sock(ret), from_port, to_port
-  case syncfunc::write: //  sig, fd, ret
-  case syncfunc::pwrite: //  sig, fd, ret
-  case syncfunc::tern_lineup_init:
-    {
-      //  notice "<<" operator is explained from right to left.
-      uint64_t a = va_arg(args, uint64_t);
-      uint64_t b = va_arg(args, uint64_t);
-      uint64_t c = va_arg(args, uint64_t);
-
-    ouf << hex
-        << " 0x" << a
-        << " 0x" << b
-        << " 0x" << c
-        << dec;
-    }
-    break;
-  case syncfunc::connect: //  fd, from_port, to_port, ret
-    {
-      //  notice "<<" operator is explained from right to left.
-      uint64_t a = va_arg(args, uint64_t);
-      uint64_t b = va_arg(args, uint64_t);
-      uint64_t c = va_arg(args, uint64_t);
-      uint64_t d = va_arg(args, uint64_t);
-
-    ouf << hex
-        << " 0x" << a
-        << " 0x" << b
-        << " 0x" << c
-        << " 0x" << d
-        << dec;
-    }
-    break;
-
-  default:
+  int nargs = NumLoggedSyncArgs(sync);
+  if (nargs < 0) {
     cerr << "sync " << syncfunc::getName(sync) << " is not yet handled!\n";
     assert(0);
   }
+  //  one va_arg per statement; the order "<<" evaluates operands in is
+  //  unspecified.
+  for (int i = 0; i < nargs; ++i) {
+    uint64_t a = va_arg(args, uint64_t);
+    ouf << hex << " 0x" << a << dec;
+  }
 
   va_end(args);
   ouf << "\n";
@@ -676,6 +586,10 @@ void Logger::threadBegin(int tid) {
       the = new BinLogger(tid);
     } else if(options::log_type == "test") {
       the = new TestLogger(tid);
+    } else if(options::log_type == "async") {
+      the = new AsyncLogger(tid);
+    } else if(options::log_type == "compact") {
+      the = new CompactLogger(tid);
     } else
       assert (0 && "unknown log_type");
 
@@ -693,10 +607,20 @@ void Logger::progBegin(void) {
   tern_funcs_call_logged();
   if (options::log_sync)
     mkdir(options::output_dir.c_str(), 0777);
+  if (options::log_sync && options::log_type == "async")
+    AsyncLogger::progBegin();
 }
 
 void Logger::progEnd(void) {
-  // nothing yet
+  if (options::log_sync && options::log_type == "async")
+    AsyncLogger::progEnd();
+}
+
+void Logger::childForkReturn(void) {
+  if (options::log_sync && options::log_type == "async")
+    AsyncLogger::childForkReturn();
+  if (options::log_sync && options::log_type == "bin")
+    BinLogger::childForkReturn();
 }
 
 } // namespace tern
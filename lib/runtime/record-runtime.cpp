@@ -56,6 +56,7 @@
 #include <string.h>
 #include <errno.h>
 #include <poll.h>
+#include <fcntl.h>
 #include <sched.h>
 #include "tern/runtime/record-log.h"
 #include "tern/runtime/record-runtime.h"
@@ -66,6 +67,12 @@
 #include "tern/options.h"
 #include "tern/hooks.h"
 #include "tern/runtime/rdtsc.h"
+#include "tern/runtime/tsc-clock.h"
+#include "tern/runtime/live-stat.h"
+#include "tern/runtime/latency-hist.h"
+#include "tern/runtime/turn-hog.h"
+#include "tern/runtime/schedule-fingerprint.h"
+#include "tern/runtime/probes.h"
 
 #include <fstream>
 #include <map>
@@ -143,6 +150,18 @@ deterministic physical time interval, so that this interval can be
 deterministically converted to logical time interval. **/
 static __thread timespec my_base_time = {0, 0};
 
+/** This var works with tern_coalesce_next().  It holds the insid of the
+next sync op that eval/sync-instr found to be followed by another sync op
+in straight-line code; only such an op may keep the turn (see
+options::coalesce_ops).  0 if none. **/
+static __thread unsigned my_coalesce_ins = 0;
+
+/** When the current op (last) got the turn, in TscClock ns; 0 if neither
+latency_hist nor turn_hog_profile nor the live stat needs it.  turnWait()
+restarts it, so an op that parks in the middle is not charged for the time
+other threads held the turn. **/
+static __thread uint64_t my_turn_start = 0;
+
 timespec time_diff(const timespec &start, const timespec &end)
 {
   timespec tmp;
@@ -156,10 +175,19 @@ timespec time_diff(const timespec &start, const timespec &end)
   return tmp;
 }
 
+static __thread uint64_t my_time_ns;
+
 timespec update_time()
 {
   timespec start_time;
-  if (options::log_sync) {
+  if (options::log_sync && options::log_tsc_time) {
+    uint64_t now = TscClock::now();
+    uint64_t d = now - my_time_ns;
+    my_time_ns = now;
+    start_time.tv_sec = d / 1000000000ULL;
+    start_time.tv_nsec = d % 1000000000ULL;
+    return start_time;
+  } else if (options::log_sync) {
     clock_gettime(CLOCK_REALTIME , &start_time);
     timespec ret = time_diff(my_time, start_time);
     my_time = start_time; 
@@ -178,23 +206,101 @@ void check_options()
       "non-determinism on regular file I/O!!\n");
 }
 
-void InstallRuntime() {
-  check_options();
-  Runtime::the = new RecorderRT<RRScheduler>;
+template <typename _S>
+static Runtime *createRecorderRT(bool instrumented) {
+  if (instrumented)
+    return new RecorderRT<_S>;
+  return new RecorderRT<_S, false>;
 }
 
-template <typename _S>
-int RecorderRT<_S>::syncWait(void *chan, unsigned timeout) {
+// RecorderRT specializes many members for RecordSerializer only, so it
+// has just the instrumented instantiation
+static Runtime *createSerializerRT(bool instrumented) {
+  return new RecorderRT<RecordSerializer>;
+}
+
+/// options::scheduler -> runtime
+static const struct {
+  const char *name;
+  Runtime *(*create)(bool instrumented);
+} schedulers[] = {
+  { "rr",          createRecorderRT<RRScheduler> },
+  { "random",      createRecorderRT<RandomScheduler> },
+  { "serializer",  createSerializerRT },
+  { "passthrough", createRecorderRT<PassthroughScheduler> },
+};
+
+void InstallRuntime() {
+  check_options();
+  if ((options::log_sync && options::log_tsc_time) || options::live_stat
+      || options::latency_hist || options::turn_hog_profile)
+    TscClock::init();
+  // the options are fixed from here on, so pick the instantiation once
+  bool instrumented = options::log_sync || options::record_runtime_stat
+    || options::record_rdtsc || options::live_stat || options::latency_hist
+    || options::turn_hog_profile || options::schedule_fingerprint;
+  for (unsigned i = 0; i < sizeof(schedulers)/sizeof(schedulers[0]); ++i)
+    if (options::scheduler == schedulers[i].name) {
+      Runtime::the = schedulers[i].create(instrumented);
+      return;
+    }
+  fprintf(stderr, "ERROR: unknown scheduler '%s'; options are", 
+          options::scheduler.c_str());
+  for (unsigned i = 0; i < sizeof(schedulers)/sizeof(schedulers[0]); ++i)
+    fprintf(stderr, " %s", schedulers[i].name);
+  fprintf(stderr, "\n");
+  exit(1);
+}
+
+/// Guards for instrumentation inside RecorderRT members; they are constant
+/// false in RecorderRT<_S, false>, see record-runtime.h.
+#define INSTR(cond) (instrumented && (cond))
+#define INSTR_TIME() (instrumented ? update_time() : timespec())
+#define INSTR_RDTSC_OP(...) \
+  do { if (instrumented) record_rdtsc_op(__VA_ARGS__); } while (0)
+
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::syncWait(void *chan, uint64_t timeout) {
 #ifdef XTERN_PLUS_DBUG
     dprintf("Parrot pid %d, tid %d self %u dbug waiting...\n", getpid(), _S::self(), (unsigned)pthread_self());
   Runtime::__thread_waiting();
 #endif
-  return _S::wait(chan, timeout);
+  if (!INSTR(LiveStat::shm))
+    return turnWait(chan, timeout);
+  uint64_t start = TscClock::now();
+  int ret = turnWait(chan, timeout);
+  LiveStat::objWaited(chan, TscClock::now() - start);
+  return ret;
 }
 
-template <typename _S>
-void RecorderRT<_S>::syncSignal(void *chan, bool all) {
+/// _S::wait() in the middle of an op: the turn goes to other threads and
+/// comes back when @chan is signaled or @timeout fires.
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::turnWait(void *chan, uint64_t timeout) {
+  if (INSTR(options::turn_hog_profile))
+    TurnHogProfiler::yield(my_turn_start);
+  int ret = _S::wait(chan, timeout);
+  if (my_turn_start)
+    my_turn_start = TscClock::now();
+  return ret;
+}
+
+/// count one turn taken by the current thread and the time it waited
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::liveStatTurn(uint64_t wait_ns) {
+  LiveThreadStat *st = LiveStat::thread(_S::self());
+  if (pthread_self() == idle_th)
+    st->idle_turns++;
+  else
+    st->turns++;
+  st->turn_wait_ns += wait_ns;
+}
+
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::syncSignal(void *chan, bool all) {
   std::list<int> signal_list = _S::signal(chan, all);
+  if (INSTR(LiveStat::shm) && !signal_list.empty())
+    LiveStat::thread(_S::self())->wakeups += signal_list.size();
 #ifdef XTERN_PLUS_DBUG
   std::list<int>::iterator itr;
   for (itr = signal_list.begin(); itr != signal_list.end(); itr++) {
@@ -206,14 +312,14 @@ void RecorderRT<_S>::syncSignal(void *chan, bool all) {
 #endif
 }
 
-template <typename _S>
-int RecorderRT<_S>::absTimeToTurn(const struct timespec *abstime)
+template <typename _S, bool _I>
+uint64_t RecorderRT<_S, _I>::absTimeToTurn(const struct timespec *abstime)
 {
   // TODO: convert physical time to logical time (number of turns)
   return _S::getTurnCount() + 30; //rand() % 10;
 }
 
-int time2turn(uint64_t nsec)
+uint64_t time2turn(uint64_t nsec)
 {
   if (!options::launch_idle_thread) {
     fprintf(stderr, "WARN: converting phyiscal time to logical time \
@@ -224,62 +330,66 @@ int time2turn(uint64_t nsec)
 
   const uint64_t MAX_REL = (1000000); // maximum number of turns to wait
 
-  uint64_t ret64 = nsec / options::nanosec_per_turn;
+  uint64_t ret = nsec / options::nanosec_per_turn;
 
   // if result too large, return MAX_REL
-  int ret = (ret64 > MAX_REL) ? MAX_REL : (int) ret64;
-
-  return ret;
+  return (ret > MAX_REL) ? MAX_REL : ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::relTimeToTurn(const struct timespec *reltime)
+template <typename _S, bool _I>
+uint64_t RecorderRT<_S, _I>::relTimeToTurn(const struct timespec *reltime)
 {
   if (!reltime) return 0;
 
-  int ret;
+  uint64_t ret, min_ret = 5 * _S::nthread + 1;
   int64_t ns;
 
   ns = reltime->tv_sec;
   ns = ns * (1000000000) + reltime->tv_nsec;
-  ret = time2turn(ns);
+  ret = (ns > 0) ? time2turn(ns) : 0;
 
   // if result too small or negative, return only (5 * nthread + 1)
-  ret = (ret < 5 * _S::nthread + 1) ? (5 * _S::nthread + 1) : ret;
-  dprintf("computed turn = %d\n", ret);
+  ret = (ret < min_ret) ? min_ret : ret;
+  dprintf("computed turn = %llu\n", (unsigned long long)ret);
   return ret;
 }
 
-template <typename _S>
-void RecorderRT<_S>::progBegin(void) {
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::progBegin(void) {
   Logger::progBegin();
+  LiveStat::progBegin();
 }
 
-template <typename _S>
-void RecorderRT<_S>::progEnd(void) {
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::progEnd(void) {
   Logger::progEnd();
+  LiveStat::progEnd();
+  if (INSTR(options::latency_hist))
+    LatencyStat::dump();
+  if (INSTR(options::turn_hog_profile))
+    TurnHogProfiler::dump();
+  if (INSTR(options::schedule_fingerprint))
+    ScheduleFingerprint::progEnd();
 }
 
 /*
  *  This is a fake API function that advances clock when all the threads  
  *  are blocked. 
  */
-template <typename _S>
-void RecorderRT<_S>::idle_sleep(void) {
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::idle_sleep(void) {
   _S::getTurn();
-  int turn = _S::incTurnCount();
-  assert(turn >= 0);
+  uint64_t turn = _S::incTurnCount();
   timespec ts;
-  if (options::log_sync)
+  if (INSTR(options::log_sync))
     Logger::the->logSync(0, syncfunc::tern_idle, turn, ts, ts, ts, true);
   _S::putTurn();
 }
 
-template <typename _S>
-void RecorderRT<_S>::idle_cond_wait(void) {
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::idle_cond_wait(void) {
   _S::getTurn();
-  int turn = _S::incTurnCount();
-  assert(turn >= 0);
+  _S::incTurnCount();
 
   /* Currently idle thread must be in runq since it has grabbed the idle_mutex,
     so >=2 means there is at least one real thread in runq as well. */
@@ -289,6 +399,38 @@ void RecorderRT<_S>::idle_cond_wait(void) {
     _S::putTurn();
 }
 
+/* Neither the serializer nor passthrough has a run queue for the idle
+   thread to park in; it just ticks the turn count so that timed waits
+   still expire. */
+static void idle_tick(void) {
+  unsigned usec = options::nanosec_per_turn / 1000;
+  ::usleep(usec ? usec : 1);
+}
+
+template <>
+void RecorderRT<RecordSerializer>::idle_cond_wait(void) {
+  RecordSerializer::getTurn();
+  RecordSerializer::incTurnCount();
+  RecordSerializer::putTurn();
+  idle_tick();
+}
+
+template <>
+void RecorderRT<PassthroughScheduler>::idle_cond_wait(void) {
+  PassthroughScheduler::getTurn();
+  PassthroughScheduler::incTurnCount();
+  PassthroughScheduler::putTurn();
+  idle_tick();
+}
+
+template <>
+void RecorderRT<PassthroughScheduler, false>::idle_cond_wait(void) {
+  PassthroughScheduler::getTurn();
+  PassthroughScheduler::incTurnCount();
+  PassthroughScheduler::putTurn();
+  idle_tick();
+}
+
 /*
 template <>
 void RecorderRT<RecordSerializer>::idle_sleep(void) {
@@ -297,14 +439,18 @@ void RecorderRT<RecordSerializer>::idle_sleep(void) {
 */
 
 #define BLOCK_TIMER_START(sync_op, ...) \
-  if (options::record_runtime_stat) \
+  if (INSTR(options::record_runtime_stat)) \
     stat.nInterProcSyncOp++; \
+  if (INSTR(LiveStat::shm)) \
+    LiveStat::thread(_S::self())->block_ops++; \
   if (options::enforce_non_det_annotations && inNonDet) { \
     return Runtime::__##sync_op(__VA_ARGS__); \
   } \
   if (_S::interProStart()) { \
     _S::block(); \
   } \
+  uint64_t block_start = INSTR(options::latency_hist) ? TscClock::now() : 0; \
+  XTERN_PROBE3(block_enter, _S::self(), syncfunc::sync_op, ins); \
   Runtime::__attach_self_to_dbug(__FUNCTION__);
   //fprintf(stderr, "\n\nBLOCK_TIMER_START ins %p, pid %d, self %u, tid %d, turnCount %u, function %s\n", (void *)ins, getpid(), (unsigned)pthread_self(), _S::self(), _S::turnCount, __FUNCTION__);
 // At this moment, since self-thread is ahead of the run queue, so this block() should be very fast.
@@ -314,6 +460,9 @@ void RecorderRT<RecordSerializer>::idle_sleep(void) {
 #define BLOCK_TIMER_END(syncop, ...) \
   Runtime::__detach_self_from_dbug(__FUNCTION__); \
   int backup_errno = errno; \
+  XTERN_PROBE3(block_exit, _S::self(), (syncop), ins); \
+  if (INSTR(options::latency_hist)) \
+    LatencyStat::record(LAT_SYSCALL, (syncop), ins, TscClock::now() - block_start); \
   if (_S::interProEnd()) { \
     _S::wakeup(); \
   } \
@@ -321,28 +470,60 @@ void RecorderRT<RecordSerializer>::idle_sleep(void) {
   //fprintf(stderr, "\n\nBLOCK_TIMER_END ins %p, pid %d, self %u, tid %d, turnCount %u, function %s\n", (void *)ins, getpid(), (unsigned)pthread_self(), _S::self(), _S::turnCount, __FUNCTION__);
 
 #define SCHED_TIMER_START \
-  unsigned nturn; \
+  uint64_t nturn; \
   if (options::enforce_non_det_annotations) \
      assert(!inNonDet); \
-  timespec app_time = update_time(); \
-  record_rdtsc_op("GET_TURN", "START", 2, NULL); \
+  timespec app_time = INSTR_TIME(); \
+  uint64_t turn_wait_start = (INSTR(LiveStat::shm) || INSTR(options::latency_hist) \
+    || INSTR(options::turn_hog_profile)) ? TscClock::now() : 0; \
+  if (INSTR(options::turn_hog_profile)) \
+    TurnHogProfiler::arrive(); \
+  XTERN_PROBE2(get_turn_enter, _S::self(), ins); \
+  INSTR_RDTSC_OP("GET_TURN", "START", 2, NULL); \
   _S::getTurn(); \
-  record_rdtsc_op("GET_TURN", "END", 2, NULL); \
-  if (options::record_runtime_stat && pthread_self() != idle_th) \
+  INSTR_RDTSC_OP("GET_TURN", "END", 2, NULL); \
+  XTERN_PROBE3(get_turn_exit, _S::self(), ins, _S::getTurnCount()); \
+  uint64_t turn_start = turn_wait_start ? TscClock::now() : 0; \
+  my_turn_start = turn_start; \
+  unsigned hog_waiters = 0; \
+  uint64_t hog_stall = INSTR(options::turn_hog_profile) ? \
+    TurnHogProfiler::grant(turn_wait_start, turn_start, hog_waiters) : 0; \
+  if (INSTR(options::record_runtime_stat) && pthread_self() != idle_th) \
      stat.nDetPthreadSyncOp++; \
-  timespec sched_time = update_time();
+  if (INSTR(LiveStat::shm)) \
+    liveStatTurn(turn_start - turn_wait_start); \
+  timespec sched_time = INSTR_TIME();
   //if (_S::self() != 1)
     //fprintf(stderr, "\n\nSCHED_TIMER_START ins %p, pid %d, self %u, tid %d, turnCount %u, function %s\n", (void *)ins, getpid(), (unsigned)pthread_self(), _S::self(), _S::turnCount, __FUNCTION__);
 
 #define SCHED_TIMER_END_COMMON(syncop, ...) \
   int backup_errno = errno; \
-  timespec syscall_time = update_time(); \
+  timespec syscall_time = INSTR_TIME(); \
   nturn = _S::incTurnCount(); \
-  if (options::log_sync) \
+  XTERN_PROBE4(sched_op, _S::self(), (syncop), nturn, ins); \
+  if (INSTR(LiveStat::shm)) \
+    LiveStat::shm->turn = nturn; \
+  if (INSTR(options::latency_hist)) { \
+    LatencyStat::record(LAT_TURN_WAIT, (syncop), ins, turn_start - turn_wait_start); \
+    LatencyStat::record(LAT_IN_TURN, (syncop), ins, TscClock::now() - my_turn_start); \
+  } \
+  if (INSTR(options::turn_hog_profile)) { \
+    TurnHogProfiler::release((syncop), ins, hog_stall, hog_waiters, my_turn_start); \
+    hog_stall = 0; \
+  } \
+  if (INSTR(options::schedule_fingerprint)) \
+    ScheduleFingerprint::update(nturn, _S::self(), (syncop), \
+                                fingerprintObj(__VA_ARGS__)); \
+  if (INSTR(options::log_sync)) \
     Logger::the->logSync(ins, (syncop), nturn = _S::getTurnCount(), app_time, syscall_time, sched_time, true, __VA_ARGS__);
    
 #define SCHED_TIMER_END(syncop, ...) \
   SCHED_TIMER_END_COMMON(syncop, __VA_ARGS__); \
+  if (my_coalesce_ins) { \
+    if (options::coalesce_ops && my_coalesce_ins == ins) \
+      _S::coalesce(syncop); \
+    my_coalesce_ins = 0; \
+  } \
   _S::putTurn();\
   errno = backup_errno;
   //if (_S::self() != 1)
@@ -355,23 +536,47 @@ void RecorderRT<RecordSerializer>::idle_sleep(void) {
   
 #define SCHED_TIMER_FAKE_END(syncop, ...) \
   nturn = _S::incTurnCount(); \
-  timespec fake_time = update_time(); \
-  if (options::log_sync) \
+  XTERN_PROBE4(sched_op, _S::self(), (syncop), nturn, ins); \
+  if (INSTR(options::turn_hog_profile)) { \
+    TurnHogProfiler::release((syncop), ins, hog_stall, hog_waiters, my_turn_start); \
+    hog_stall = 0; \
+  } \
+  if (INSTR(options::schedule_fingerprint)) \
+    ScheduleFingerprint::update(nturn, _S::self(), (syncop), \
+                                fingerprintObj(__VA_ARGS__)); \
+  timespec fake_time = INSTR_TIME(); \
+  if (INSTR(options::log_sync)) \
     Logger::the->logSync(ins, syncop, nturn, app_time, fake_time, sched_time, /* before */ false, __VA_ARGS__); 
 
-template <typename _S>
-void RecorderRT<_S>::printStat(){
+/// Takes the turn again after SCHED_TIMER_FAKE_END and _S::putTurn(), for
+/// an op that made a blocking call off the turn in between; the op's turn
+/// clocks start over, as if from SCHED_TIMER_START.
+#define SCHED_TIMER_REGET \
+  app_time = INSTR_TIME(); \
+  turn_wait_start = (INSTR(LiveStat::shm) || INSTR(options::latency_hist) \
+    || INSTR(options::turn_hog_profile)) ? TscClock::now() : 0; \
+  if (INSTR(options::turn_hog_profile)) \
+    TurnHogProfiler::arrive(); \
+  _S::getTurn(); \
+  turn_start = turn_wait_start ? TscClock::now() : 0; \
+  my_turn_start = turn_start; \
+  if (INSTR(options::turn_hog_profile)) \
+    hog_stall = TurnHogProfiler::grant(turn_wait_start, turn_start, hog_waiters); \
+  sched_time = INSTR_TIME();
+
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::printStat(){
   // We must get turn, and print, and then put turn. This is a solid way of 
   // getting deterministic runtime stat.
   _S::getTurn();
-  if (options::record_runtime_stat)
+  if (INSTR(options::record_runtime_stat))
     stat.print();
   _S::incTurnCount();
   _S::putTurn();
 }
   
-template <typename _S>
-void RecorderRT<_S>::threadBegin(void) {
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::threadBegin(void) {
   pthread_t th = pthread_self();
   unsigned ins = INVALID_INSID;
 
@@ -390,8 +595,8 @@ void RecorderRT<_S>::threadBegin(void) {
   SCHED_TIMER_END(syncfunc::tern_thread_begin, (uint64_t)th);
 }
 
-template <typename _S>
-void RecorderRT<_S>::threadEnd(unsigned ins) {
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::threadEnd(unsigned ins) {
   SCHED_TIMER_START;
   pthread_t th = pthread_self();
 
@@ -463,8 +668,8 @@ void RecorderRT<_S>::threadEnd(unsigned ins) {
 /// multiple sem_down in different ways.  We solve this problem using
 /// another semaphore, thread_begin_done_sem.
 ///
-template <typename _S>
-int RecorderRT<_S>::pthreadCreate(unsigned ins, int &error, pthread_t *thread,
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadCreate(unsigned ins, int &error, pthread_t *thread,
          pthread_attr_t *attr, void *(*thread_func)(void*), void *arg) {
   int ret;
   SCHED_TIMER_START;
@@ -481,8 +686,8 @@ int RecorderRT<_S>::pthreadCreate(unsigned ins, int &error, pthread_t *thread,
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::pthreadJoin(unsigned ins, int &error, pthread_t th, void **rv) {
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadJoin(unsigned ins, int &error, pthread_t th, void **rv) {
   int ret;
 
 #ifdef XTERN_PLUS_DBUG
@@ -513,7 +718,7 @@ int RecorderRT<_S>::pthreadJoin(unsigned ins, int &error, pthread_t th, void **r
   while(!_S::zombie(th)) {
     /* Don't call syncWait here, but this scheduler wait, because there is a pairwise 
       signal() in putTurn with thread_end. */
-    _S::wait((void*)th);
+    turnWait((void*)th);
   }
   errno = error;
 
@@ -546,20 +751,20 @@ int RecorderRT<_S>::pthreadJoin(unsigned ins, int &error, pthread_t th, void **r
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__pthread_detach(unsigned insid, int &error, pthread_t th) {
-  BLOCK_TIMER_START(pthread_detach, insid, error, th);
-  int ret = Runtime::__pthread_detach(insid, error, th);
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__pthread_detach(unsigned ins, int &error, pthread_t th) {
+  BLOCK_TIMER_START(pthread_detach, ins, error, th);
+  int ret = Runtime::__pthread_detach(ins, error, th);
   BLOCK_TIMER_END(syncfunc::pthread_detach, (uint64_t)ret);
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::pthreadMutexInit(unsigned ins, int &error, pthread_mutex_t *mutex, const  pthread_mutexattr_t *mutexattr)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadMutexInit(unsigned ins, int &error, pthread_mutex_t *mutex, const  pthread_mutexattr_t *mutexattr)
 {
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)mutex);
     dprintf("Thread tid %d, self %u is calling non-det pthread_mutex_init.\n", _S::self(), (unsigned)pthread_self());
@@ -573,12 +778,12 @@ int RecorderRT<_S>::pthreadMutexInit(unsigned ins, int &error, pthread_mutex_t *
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::pthreadMutexDestroy(unsigned ins, int &error, pthread_mutex_t *mutex)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadMutexDestroy(unsigned ins, int &error, pthread_mutex_t *mutex)
 {
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)mutex);
     return Runtime::__pthread_mutex_destroy(ins, error, mutex);
@@ -591,8 +796,8 @@ int RecorderRT<_S>::pthreadMutexDestroy(unsigned ins, int &error, pthread_mutex_
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::pthreadMutexLockHelper(pthread_mutex_t *mu, unsigned timeout) {
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadMutexLockHelper(pthread_mutex_t *mu, uint64_t timeout) {
   int ret;
   while((ret=pthread_mutex_trylock(mu))) {
     assert(ret==EBUSY && "failed sync calls are not yet supported!");
@@ -603,8 +808,8 @@ int RecorderRT<_S>::pthreadMutexLockHelper(pthread_mutex_t *mu, unsigned timeout
   return 0;
 }
 
-template <typename _S>
-int RecorderRT<_S>::pthreadRWLockWrLockHelper(pthread_rwlock_t *rwlock, unsigned timeout) {
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadRWLockWrLockHelper(pthread_rwlock_t *rwlock, uint64_t timeout) {
   int ret;
   while((ret=pthread_rwlock_trywrlock(rwlock))) {
     assert(ret==EBUSY && "failed sync calls are not yet supported!");
@@ -615,8 +820,8 @@ int RecorderRT<_S>::pthreadRWLockWrLockHelper(pthread_rwlock_t *rwlock, unsigned
   return 0;
 }
 
-template <typename _S>
-int RecorderRT<_S>::pthreadRWLockRdLockHelper(pthread_rwlock_t *rwlock, unsigned timeout) {
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadRWLockRdLockHelper(pthread_rwlock_t *rwlock, uint64_t timeout) {
   int ret;
   while((ret=pthread_rwlock_tryrdlock(rwlock))) {
     assert(ret==EBUSY && "failed sync calls are not yet supported!");
@@ -627,10 +832,10 @@ int RecorderRT<_S>::pthreadRWLockRdLockHelper(pthread_rwlock_t *rwlock, unsigned
   return 0;
 }
 
-template <typename _S>
-int RecorderRT<_S>::pthreadMutexLock(unsigned ins, int &error, pthread_mutex_t *mu) {
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadMutexLock(unsigned ins, int &error, pthread_mutex_t *mu) {
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)mu);
     dprintf("Ins %p :   Thread tid %d, self %u is calling non-det pthread_mutex_lock.\n", (void *)ins, _S::self(), (unsigned)pthread_self());
@@ -644,11 +849,11 @@ int RecorderRT<_S>::pthreadMutexLock(unsigned ins, int &error, pthread_mutex_t *
   return 0;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__pthread_rwlock_rdlock(unsigned ins, int &error, pthread_rwlock_t *rwlock)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__pthread_rwlock_rdlock(unsigned ins, int &error, pthread_rwlock_t *rwlock)
 {
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)rwlock);
     return pthread_rwlock_rdlock(rwlock);
@@ -661,11 +866,11 @@ int RecorderRT<_S>::__pthread_rwlock_rdlock(unsigned ins, int &error, pthread_rw
   return 0;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__pthread_rwlock_wrlock(unsigned ins, int &error, pthread_rwlock_t *rwlock)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__pthread_rwlock_wrlock(unsigned ins, int &error, pthread_rwlock_t *rwlock)
 {
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)rwlock);
     return pthread_rwlock_wrlock(rwlock);
@@ -678,11 +883,11 @@ int RecorderRT<_S>::__pthread_rwlock_wrlock(unsigned ins, int &error, pthread_rw
   return 0;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__pthread_rwlock_tryrdlock(unsigned ins, int &error, pthread_rwlock_t *rwlock)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__pthread_rwlock_tryrdlock(unsigned ins, int &error, pthread_rwlock_t *rwlock)
 {
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)rwlock);
     return pthread_rwlock_tryrdlock(rwlock);
@@ -695,11 +900,11 @@ int RecorderRT<_S>::__pthread_rwlock_tryrdlock(unsigned ins, int &error, pthread
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__pthread_rwlock_trywrlock(unsigned ins, int &error, pthread_rwlock_t *rwlock)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__pthread_rwlock_trywrlock(unsigned ins, int &error, pthread_rwlock_t *rwlock)
 {
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)rwlock);
     return pthread_rwlock_trywrlock(rwlock);
@@ -712,12 +917,12 @@ int RecorderRT<_S>::__pthread_rwlock_trywrlock(unsigned ins, int &error, pthread
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__pthread_rwlock_unlock(unsigned ins, int &error, pthread_rwlock_t *rwlock)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__pthread_rwlock_unlock(unsigned ins, int &error, pthread_rwlock_t *rwlock)
 {
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)rwlock);
     return pthread_rwlock_unlock(rwlock);
@@ -734,10 +939,10 @@ int RecorderRT<_S>::__pthread_rwlock_unlock(unsigned ins, int &error, pthread_rw
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__pthread_rwlock_destroy(unsigned ins, int &error, pthread_rwlock_t *rwlock) {
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__pthread_rwlock_destroy(unsigned ins, int &error, pthread_rwlock_t *rwlock) {
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)rwlock);
     return pthread_rwlock_destroy(rwlock);
@@ -750,10 +955,10 @@ int RecorderRT<_S>::__pthread_rwlock_destroy(unsigned ins, int &error, pthread_r
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__pthread_rwlock_init(unsigned ins, int &error, pthread_rwlock_t *rwlock, const pthread_rwlockattr_t *attr) {
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__pthread_rwlock_init(unsigned ins, int &error, pthread_rwlock_t *rwlock, const pthread_rwlockattr_t *attr) {
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)rwlock);
     return pthread_rwlock_init(rwlock, attr);
@@ -769,11 +974,11 @@ int RecorderRT<_S>::__pthread_rwlock_init(unsigned ins, int &error, pthread_rwlo
 /// instead of looping to get lock as how we implement the regular lock(),
 /// here just trylock once and return.  this preserves the semantics of
 /// trylock().
-template <typename _S>
-int RecorderRT<_S>::pthreadMutexTryLock(unsigned ins, int &error, pthread_mutex_t *mu) {
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadMutexTryLock(unsigned ins, int &error, pthread_mutex_t *mu) {
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)mu);
     return pthread_mutex_trylock(mu);
@@ -788,11 +993,11 @@ int RecorderRT<_S>::pthreadMutexTryLock(unsigned ins, int &error, pthread_mutex_
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::pthreadMutexTimedLock(unsigned ins, int &error, pthread_mutex_t *mu,
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadMutexTimedLock(unsigned ins, int &error, pthread_mutex_t *mu,
                                                 const struct timespec *abstime) {
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)mu);
     return pthread_mutex_timedlock(mu, abstime);
@@ -812,7 +1017,7 @@ int RecorderRT<_S>::pthreadMutexTimedLock(unsigned ins, int &error, pthread_mute
   rel_time = time_diff(cur_time, *abstime);
 
   SCHED_TIMER_START;
-  unsigned timeout = _S::getTurnCount() + relTimeToTurn(&rel_time);
+  uint64_t timeout = _S::getTurnCount() + relTimeToTurn(&rel_time);
   errno = error;
   int ret = pthreadMutexLockHelper(mu, timeout);
   error = errno;
@@ -821,11 +1026,11 @@ int RecorderRT<_S>::pthreadMutexTimedLock(unsigned ins, int &error, pthread_mute
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::pthreadMutexUnlock(unsigned ins, int &error, pthread_mutex_t *mu){
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadMutexUnlock(unsigned ins, int &error, pthread_mutex_t *mu){
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)mu);
     dprintf("Thread tid %d, self %u is calling non-det pthread_mutex_unlock.\n", _S::self(), (unsigned)pthread_self());
@@ -846,12 +1051,12 @@ int RecorderRT<_S>::pthreadMutexUnlock(unsigned ins, int &error, pthread_mutex_t
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::pthreadBarrierInit(unsigned ins, int &error, pthread_barrier_t *barrier,
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadBarrierInit(unsigned ins, int &error, pthread_barrier_t *barrier,
                                        unsigned count) {
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)barrier);
     return pthread_barrier_init(barrier, NULL, count);
@@ -880,8 +1085,8 @@ int RecorderRT<_S>::pthreadBarrierInit(unsigned ins, int &error, pthread_barrier
 /// last thread arriving at the barrier can figure out that it is the last
 /// thread, and wakes up all other threads.
 ///
-template <typename _S>
-int RecorderRT<_S>::pthreadBarrierWait(unsigned ins, int &error, 
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadBarrierWait(unsigned ins, int &error, 
                                        pthread_barrier_t *barrier) {
   /// Note: the syncSignal() operation has to be done while the thread has the
   /// turn; otherwise two independent syncSignal() operations on two
@@ -906,7 +1111,7 @@ int RecorderRT<_S>::pthreadBarrierWait(unsigned ins, int &error,
   
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)barrier);
     return pthread_barrier_wait(barrier);
@@ -946,7 +1151,7 @@ int RecorderRT<_S>::pthreadBarrierWait(unsigned ins, int &error,
     ret = 0;
     syncWait(barrier);
   }
-  sched_time = update_time();
+  sched_time = INSTR_TIME();
 #ifdef xxx
   fprintf(stderr, "thread %d leaves barrier\n", _S::self());
   fflush(stderr);
@@ -958,12 +1163,12 @@ int RecorderRT<_S>::pthreadBarrierWait(unsigned ins, int &error,
 }
 
 // FIXME: the handling of the EBUSY case seems gross
-template <typename _S>
-int RecorderRT<_S>::pthreadBarrierDestroy(unsigned ins, int &error, 
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadBarrierDestroy(unsigned ins, int &error, 
                                           pthread_barrier_t *barrier) {
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)barrier);
     return pthread_barrier_destroy(barrier);
@@ -1208,11 +1413,11 @@ int RecorderRT<_S>::pthreadBarrierDestroy(unsigned ins, int &error,
 ///
 ///  solution 5: probably not worth it
 ///
-template <typename _S>
-int RecorderRT<_S>::pthreadCondWait(unsigned ins, int &error, 
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadCondWait(unsigned ins, int &error, 
                                     pthread_cond_t *cv, pthread_mutex_t *mu){
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)cv);
     add_non_det_var((void *)mu);
@@ -1224,7 +1429,7 @@ int RecorderRT<_S>::pthreadCondWait(unsigned ins, int &error,
 
   SCHED_TIMER_FAKE_END(syncfunc::pthread_cond_wait, (uint64_t)cv, (uint64_t)mu);
   syncWait(cv);
-  sched_time = update_time();
+  sched_time = INSTR_TIME();
   errno = error;
   pthreadMutexLockHelper(mu);
   error = errno;
@@ -1233,8 +1438,8 @@ int RecorderRT<_S>::pthreadCondWait(unsigned ins, int &error,
   return 0;
 }
 
-template <typename _S>
-int RecorderRT<_S>::pthreadCondTimedWait(unsigned ins, int &error, 
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadCondTimedWait(unsigned ins, int &error, 
     pthread_cond_t *cv, pthread_mutex_t *mu, const struct timespec *abstime){
 
   int saved_ret = 0;
@@ -1255,7 +1460,7 @@ int RecorderRT<_S>::pthreadCondTimedWait(unsigned ins, int &error,
 
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)cv);
     add_non_det_var((void *)mu);
@@ -1267,14 +1472,15 @@ int RecorderRT<_S>::pthreadCondTimedWait(unsigned ins, int &error,
   SCHED_TIMER_FAKE_END(syncfunc::pthread_cond_timedwait, (uint64_t)cv, (uint64_t)mu, (uint64_t) 0);
 
   syncSignal(mu);
-  unsigned nTurns = relTimeToTurn(&rel_time);
-  dprintf("Tid %d pthreadCondTimedWait physical time interval %ld.%ld, logical turns %u\n",
-    _S::self(), (long)rel_time.tv_sec, (long)rel_time.tv_nsec, nTurns);
-  unsigned timeout = _S::getTurnCount() + nTurns;
+  uint64_t nTurns = relTimeToTurn(&rel_time);
+  dprintf("Tid %d pthreadCondTimedWait physical time interval %ld.%ld, logical turns %llu\n",
+    _S::self(), (long)rel_time.tv_sec, (long)rel_time.tv_nsec, (unsigned long long)nTurns);
+  uint64_t timeout = _S::getTurnCount() + nTurns;
   saved_ret = ret = syncWait(cv, timeout);
-  dprintf("timedwait return = %d, after %d turns\n", ret, _S::getTurnCount() - nturn);
+  dprintf("timedwait return = %d, after %llu turns\n", ret,
+          (unsigned long long)(_S::getTurnCount() - nturn));
 
-  sched_time = update_time();
+  sched_time = INSTR_TIME();
   errno = error;
   pthreadMutexLockHelper(mu);
   error = errno;
@@ -1283,10 +1489,10 @@ int RecorderRT<_S>::pthreadCondTimedWait(unsigned ins, int &error,
   return saved_ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::pthreadCondSignal(unsigned ins, int &error, pthread_cond_t *cv){
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadCondSignal(unsigned ins, int &error, pthread_cond_t *cv){
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)cv);
     return pthread_cond_signal(cv);
@@ -1301,10 +1507,10 @@ int RecorderRT<_S>::pthreadCondSignal(unsigned ins, int &error, pthread_cond_t *
   return 0;
 }
 
-template <typename _S>
-int RecorderRT<_S>::pthreadCondBroadcast(unsigned ins, int &error, pthread_cond_t*cv){
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::pthreadCondBroadcast(unsigned ins, int &error, pthread_cond_t*cv){
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)cv);
     return pthread_cond_broadcast(cv);
@@ -1315,11 +1521,11 @@ int RecorderRT<_S>::pthreadCondBroadcast(unsigned ins, int &error, pthread_cond_
   return 0;
 }
 
-template <typename _S>
-int RecorderRT<_S>::semWait(unsigned ins, int &error, sem_t *sem) {
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::semWait(unsigned ins, int &error, sem_t *sem) {
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)sem);
     //fprintf(stderr, "non det sem wait...\n");
@@ -1338,11 +1544,11 @@ int RecorderRT<_S>::semWait(unsigned ins, int &error, sem_t *sem) {
   return 0;
 }
 
-template <typename _S>
-int RecorderRT<_S>::semTryWait(unsigned ins, int &error, sem_t *sem) {
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::semTryWait(unsigned ins, int &error, sem_t *sem) {
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)sem);
     return sem_trywait(sem);
@@ -1358,8 +1564,8 @@ int RecorderRT<_S>::semTryWait(unsigned ins, int &error, sem_t *sem) {
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::semTimedWait(unsigned ins, int &error, sem_t *sem,
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::semTimedWait(unsigned ins, int &error, sem_t *sem,
                                      const struct timespec *abstime) {
   int saved_err = 0;
   if(abstime == NULL)
@@ -1378,14 +1584,14 @@ int RecorderRT<_S>::semTimedWait(unsigned ins, int &error, sem_t *sem,
   
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)sem);
     return sem_timedwait(sem, abstime);
   }
   SCHED_TIMER_START;
   
-  unsigned timeout = _S::getTurnCount() + relTimeToTurn(&rel_time);
+  uint64_t timeout = _S::getTurnCount() + relTimeToTurn(&rel_time);
   while((ret=sem_trywait(sem))) {
     assert(errno==EAGAIN && "failed sync calls are not yet supported!");
     ret = syncWait(sem, timeout);
@@ -1402,11 +1608,11 @@ int RecorderRT<_S>::semTimedWait(unsigned ins, int &error, sem_t *sem,
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::semPost(unsigned ins, int &error, sem_t *sem){
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::semPost(unsigned ins, int &error, sem_t *sem){
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)sem);
     return Runtime::__sem_post(ins, error, sem);
@@ -1420,11 +1626,11 @@ int RecorderRT<_S>::semPost(unsigned ins, int &error, sem_t *sem){
   return 0;
 }
 
-template <typename _S>
-int RecorderRT<_S>::semInit(unsigned ins, int &error, sem_t *sem, int pshared, unsigned int value){
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::semInit(unsigned ins, int &error, sem_t *sem, int pshared, unsigned int value){
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)sem);
     return Runtime::__sem_init(ins, error, sem, pshared, value);
@@ -1437,11 +1643,11 @@ int RecorderRT<_S>::semInit(unsigned ins, int &error, sem_t *sem, int pshared, u
   return 0;
 }
 
-template <typename _S>
-void RecorderRT<_S>::lineupInit(long opaque_type, unsigned count, unsigned timeout_turns) {
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::lineupInit(long opaque_type, unsigned count, unsigned timeout_turns) {
   unsigned ins = opaque_type;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)opaque_type);
     return;
@@ -1459,11 +1665,11 @@ void RecorderRT<_S>::lineupInit(long opaque_type, unsigned count, unsigned timeo
   SCHED_TIMER_END(syncfunc::tern_lineup_init, (uint64_t)opaque_type, (uint64_t) count, (uint64_t) timeout_turns);
 }
 
-template <typename _S>
-void RecorderRT<_S>::lineupDestroy(long opaque_type) {
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::lineupDestroy(long opaque_type) {
   unsigned ins = opaque_type;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)opaque_type);
     return;
@@ -1481,18 +1687,18 @@ void RecorderRT<_S>::lineupDestroy(long opaque_type) {
   SCHED_TIMER_END(syncfunc::tern_lineup_destroy, (uint64_t)opaque_type);
 }
 
-template <typename _S>
-void RecorderRT<_S>::lineupStart(long opaque_type) {
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::lineupStart(long opaque_type) {
   unsigned ins = opaque_type;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)opaque_type);
     return;
   }
   //fprintf(stderr, "lineupStart opaque_type %p, tid %d, waiting for turn...\n", (void *)opaque_type, _S::self());
 
-  record_rdtsc_op(__FUNCTION__, "START", 1, NULL); // Record rdtsc start, disabled by default.
+  INSTR_RDTSC_OP(__FUNCTION__, "START", 1, NULL); // Record rdtsc start, disabled by default.
 
   SCHED_TIMER_START;
   refcnt_bar_map::iterator bi = refcnt_bars.find(opaque_type);
@@ -1508,8 +1714,11 @@ void RecorderRT<_S>::lineupStart(long opaque_type) {
       if (b.nSuccess%1000 == 0)
         fprintf(stderr, "lineupStart opaque_type %p, tid %d, full and success (%ld:%ld)!\n",
           (void *)opaque_type, _S::self(), b.nSuccess, b.nTimeout);*/
-      if (options::record_runtime_stat)
+      if (INSTR(options::record_runtime_stat))
         stat.nLineupSucc++;
+      if (INSTR(LiveStat::shm))
+        LiveStat::thread(_S::self())->lineup_succ++;
+      XTERN_PROBE2(lineup_success, _S::self(), opaque_type);
       b.setLeaving();
       syncSignal(&b, true); // Signal all threads blocking on this barrier.
     } else {
@@ -1525,8 +1734,11 @@ void RecorderRT<_S>::lineupStart(long opaque_type) {
         /*b.nTimeout++;
         fprintf(stderr, "lineupStart opaque_type %p, tid %d, timeout  (%ld:%ld)!\n",
           (void *)opaque_type, _S::self(), b.nSuccess, b.nTimeout);*/
-        if (options::record_runtime_stat)
+        if (INSTR(options::record_runtime_stat))
           stat.nLineupTimeout++;
+        if (INSTR(LiveStat::shm))
+          LiveStat::thread(_S::self())->lineup_timeout++;
+        XTERN_PROBE2(lineup_timeout, _S::self(), opaque_type);
         b.setLeaving();
         syncSignal(&b, true); // Signal all threads blocking on this barrier.
       }
@@ -1537,14 +1749,14 @@ void RecorderRT<_S>::lineupStart(long opaque_type) {
    
   SCHED_TIMER_END(syncfunc::tern_lineup_start, (uint64_t)opaque_type);
 
-  record_rdtsc_op(__FUNCTION__, "END", 1, NULL); // Record rdtsc start, disabled by default.
+  INSTR_RDTSC_OP(__FUNCTION__, "END", 1, NULL); // Record rdtsc start, disabled by default.
 }
 
-template <typename _S>
-void RecorderRT<_S>::lineupEnd(long opaque_type) {
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::lineupEnd(long opaque_type) {
   unsigned ins = opaque_type;
   if (options::enforce_non_det_annotations && inNonDet) {
-    if (options::record_runtime_stat)
+    if (INSTR(options::record_runtime_stat))
       stat.nNonDetPthreadSync++;
     add_non_det_var((void *)opaque_type);
     return;
@@ -1561,13 +1773,15 @@ void RecorderRT<_S>::lineupEnd(long opaque_type) {
   SCHED_TIMER_END(syncfunc::tern_lineup_end, (uint64_t)opaque_type);
 }
 
-template <typename _S>
-void RecorderRT<_S>::nonDetStart() {
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::nonDetStart() {
   unsigned ins = 0;
   dprintf("nonDetStart, tid %d, self %u\n", _S::self(), (unsigned)pthread_self());
   SCHED_TIMER_START;
-  if (options::record_runtime_stat)
+  if (INSTR(options::record_runtime_stat))
     stat.nNonDetRegions++;
+  if (INSTR(LiveStat::shm))
+    LiveStat::thread(_S::self())->nondet_entries++;
 
   nNonDetWait++;
   /** Although at this moment current thread is still in the xtern runq, we pre-attach it to dbug,
@@ -1582,9 +1796,9 @@ void RecorderRT<_S>::nonDetStart() {
   i.e., all valid (except idle thread) xtern threads are paused.
   This wait works like a lineup with unlimited timeout, which is for 
   maximizing the non-det regions. **/
-  /* Do not call the wait() here, but _S::wait(), because we do not want to 
+  /* Do not call syncWait() here, but turnWait(), because we do not want to 
   involved dbug_thread_waiting/active here. */
-  _S::wait(&nonDetCV);
+  turnWait(&nonDetCV);
 
   nNonDetWait--;
 
@@ -1592,13 +1806,14 @@ void RecorderRT<_S>::nonDetStart() {
   /** Reuse existing xtern API. Get turn, remove myself from runq, and then pass turn. This 
   operation is determinisitc since we get turn. **/
   _S::block();
-  dprintf("nonDetStart is done, tid %d, self %u, turnCount %u\n", _S::self(), (unsigned)pthread_self(), _S::turnCount);
+  dprintf("nonDetStart is done, tid %d, self %u, turnCount %llu\n", _S::self(), (unsigned)pthread_self(),
+          (unsigned long long)_S::turnCount);
   assert(!inNonDet);
   inNonDet = true;
 }
 
-template <typename _S>
-void RecorderRT<_S>::nonDetEnd() {
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::nonDetEnd() {
   dprintf("nonDetEnd, tid %d, self %u\n", _S::self(), (unsigned)pthread_self());
   assert(options::enforce_non_det_annotations == 1);
   assert(inNonDet);
@@ -1618,15 +1833,15 @@ void RecorderRT<_S>::nonDetEnd() {
                             status of the thread is still runnable. **/
 }
 
-template <typename _S>
-void RecorderRT<_S>::threadDetach() {
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::threadDetach() {
 #ifdef XTERN_PLUS_DBUG
   Runtime::__thread_detach();
 #endif
 }
 
-template <typename _S>
-void RecorderRT<_S>::nonDetBarrierEnd(int bar_id, int cnt) {
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::nonDetBarrierEnd(int bar_id, int cnt) {
   dprintf("nonDetBarrierEnd, tid %d, self %u\n", _S::self(), (unsigned)pthread_self());
   assert(options::enforce_non_det_annotations == 1);
   assert(inNonDet);
@@ -1646,8 +1861,17 @@ void RecorderRT<_S>::nonDetBarrierEnd(int bar_id, int cnt) {
                             status of the thread is still runnable. **/
 }
 
-template <typename _S>
-void RecorderRT<_S>::setBaseTime(struct timespec *ts) {
+/// the sync op at @insid, which this thread calls next, is followed by
+/// another sync op with no calls or branches in between, so it may keep
+/// the turn.
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::coalesceNext(unsigned insid) {
+  // Do not need to enforce any turn here.
+  my_coalesce_ins = insid;
+}
+
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::setBaseTime(struct timespec *ts) {
   // Do not need to enforce any turn here.
   dprintf("setBaseTime, tid %d, base time %ld.%ld\n", _S::self(), (long)ts->tv_sec, (long)ts->tv_nsec);
   assert(ts);
@@ -1655,8 +1879,8 @@ void RecorderRT<_S>::setBaseTime(struct timespec *ts) {
   my_base_time.tv_nsec = ts->tv_nsec;
 }
 
-template <typename _S>
-void RecorderRT<_S>::symbolic(unsigned ins, int &error, void *addr,
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::symbolic(unsigned ins, int &error, void *addr,
                               int nbyte, const char *name){
   SCHED_TIMER_START;
   SCHED_TIMER_END(syncfunc::tern_symbolic, (uint64_t)addr, (uint64_t)nbyte);
@@ -1778,9 +2002,9 @@ int RecorderRT<RecordSerializer>::pthreadBarrierWait(unsigned ins, int &error,
   assert((!ret || ret==PTHREAD_BARRIER_SERIAL_THREAD)
          && "failed sync calls are not yet supported!");
 
-  //timespec app_time = update_time();
+  //timespec app_time = INSTR_TIME();
   _S::getTurn();
-  sched_time = update_time();
+  sched_time = INSTR_TIME();
   SCHED_TIMER_END(syncfunc::pthread_barrier_wait, (uint64_t)barrier, (uint64_t)ret);
 
   return ret;
@@ -1824,7 +2048,7 @@ int RecorderRT<RecordSerializer>::pthreadCondWait(unsigned ins, int &error,
   errno = error;
   pthread_cond_wait(cv, RecordSerializer::getLock());
   error = errno;
-  sched_time = update_time();
+  sched_time = INSTR_TIME();
 
   while((ret=pthread_mutex_trylock(mu))) {
     assert(ret==EBUSY && "failed sync calls are not yet supported!");
@@ -1886,22 +2110,155 @@ int RecorderRT<RecordSerializer>::pthreadCondBroadcast(unsigned ins, int &error,
   return 0;
 }
 
-template <typename _S>
-bool RecorderRT<_S>::regularFile(int fd) {
+template <typename _S, bool _I>
+bool RecorderRT<_S, _I>::regularFile(int fd) {
   struct stat st;
   fstat(fd, &st);
   // If it is neither a socket, nor a fifo, then it is regular file (not a inter-process communication media).
   return ((S_IFSOCK != (st.st_mode & S_IFMT)) && (S_IFIFO != (st.st_mode & S_IFMT)));
 }
 
-template <typename _S>
-int RecorderRT<_S>::__accept(unsigned ins, int &error, int sockfd, struct sockaddr *cliaddr, socklen_t *addrlen)
+/// hand out the oldest drained connection of @batch.  The connection was
+/// accepted with SOCK_NONBLOCK, so fix up its flags to what the caller
+/// asked for.
+///
+/// @before with turn
+/// @after with turn
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::popAcceptedConn(accept_batch_t &batch, struct sockaddr *cliaddr,
+                                    socklen_t *addrlen, int flags)
+{
+  assert(!batch.conns.empty());
+  accept_batch_t::conn_t &c = batch.conns.front();
+  int fd = c.fd;
+  if (cliaddr && addrlen) {
+    memcpy(cliaddr, &c.addr, std::min(*addrlen, c.addrlen));
+    *addrlen = c.addrlen;
+  }
+  batch.conns.pop_front();
+
+  if (!(flags & SOCK_NONBLOCK)) {
+    int fl = fcntl(fd, F_GETFL);
+    fcntl(fd, F_SETFL, fl & ~O_NONBLOCK);
+  }
+  if (flags & SOCK_CLOEXEC)
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  return fd;
+}
+
+/// accept() with batching: instead of every accept() caller on a shared
+/// listening socket going through its own block()/wakeup() cycle, only
+/// one thread (the acceptor) blocks in the kernel.  Once it gets a
+/// connection and the turn back, it drains at most as many queued
+/// connections as there are threads parked on the socket, publishes them
+/// and wakes these threads up.  They take connections in the order the
+/// scheduler wakes them up, so N connections cost one block()/wakeup()
+/// cycle instead of N.
+///
+/// Draining is done with the turn held so the number of parked threads is
+/// stable, and never goes beyond it: a connection pulled out of the kernel
+/// backlog is invisible to poll()/select() on the listening socket, so an
+/// extra one could be stranded in the batch.  Callers on an O_NONBLOCK
+/// listener never park; they get EAGAIN while another thread is the
+/// acceptor.
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::acceptBatchHelper(unsigned ins, int &error, unsigned short syncop, int sockfd,
+                                      struct sockaddr *cliaddr, socklen_t *addrlen, int flags)
+{
+  int ret;
+  SCHED_TIMER_START;
+  accept_batch_t &batch = accept_batches[sockfd];
+  if (batch.conns.empty() && batch.draining && (fcntl(sockfd, F_GETFL) & O_NONBLOCK)) {
+    error = EAGAIN;
+    SCHED_TIMER_END(syncop, (uint64_t)-1, (uint64_t)0, (uint64_t)0);
+    return -1;
+  }
+  while (batch.conns.empty() && batch.draining) {
+    batch.nwaiters++;
+    syncWait(&batch);
+    batch.nwaiters--;
+  }
+  if (!batch.conns.empty()) {
+    ret = popAcceptedConn(batch, cliaddr, addrlen, flags);
+    SCHED_TIMER_END(syncop, (uint64_t)ret, (uint64_t)0, (uint64_t)0);
+    return ret;
+  }
+
+  // Nobody is blocked on this socket, so we become the acceptor.
+  batch.draining = true;
+  SCHED_TIMER_FAKE_END(syncop, (uint64_t)sockfd, (uint64_t)0, (uint64_t)0);
+  _S::putTurn();
+
+  if (_S::interProStart())
+    _S::block();
+  Runtime::__attach_self_to_dbug(__FUNCTION__);
+  ret = Runtime::__accept4(ins, error, sockfd, cliaddr, addrlen, flags);
+  Runtime::__detach_self_from_dbug(__FUNCTION__);
+  if (_S::interProEnd())
+    _S::wakeup();
+
+  SCHED_TIMER_REGET;
+  int ndrained = 0;
+  if (ret >= 0) {
+    struct pollfd pfd;
+    pfd.fd = sockfd;
+    pfd.events = POLLIN;
+    while ((int)batch.conns.size() < std::min(batch.nwaiters, options::accept_batch_size)) {
+      // Only take what is already queued; the listening socket may be in
+      // blocking mode and we hold the turn.
+      pfd.revents = 0;
+      if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & POLLIN))
+        break;
+      accept_batch_t::conn_t c;
+      c.addrlen = sizeof(c.addr);
+      c.fd = accept4(sockfd, (struct sockaddr *)&c.addr, &c.addrlen, SOCK_NONBLOCK);
+      if (c.fd < 0)
+        break;
+      batch.conns.push_back(c);
+      ndrained++;
+    }
+  }
+  batch.draining = false;
+  if (INSTR(options::record_runtime_stat))
+    stat.nAcceptBatched += ndrained;
+  // Wake up all waiters even if we got an error, so one of them can take
+  // over as the acceptor.
+  syncSignal(&batch, /*all=*/true);
+  SCHED_TIMER_END(syncop, (uint64_t)ret, (uint64_t)0, (uint64_t)0);
+  return ret;
+}
+
+/// a listening socket was (re)created on @sockfd; drop connections left
+/// over from an earlier socket with the same descriptor.
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::resetAcceptBatch(int sockfd)
 {
+  _S::getTurn();
+  accept_batch_map::iterator it = accept_batches.find(sockfd);
+  if (it != accept_batches.end()) {
+    accept_batch_t &batch = it->second;
+    while (!batch.conns.empty()) {
+      close(batch.conns.front().fd);
+      batch.conns.pop_front();
+    }
+    // the acceptor and parked threads hold a reference to the entry
+    if (!batch.draining && batch.nwaiters == 0)
+      accept_batches.erase(it);
+  }
+  _S::incTurnCount();
+  _S::putTurn();
+}
+
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__accept(unsigned ins, int &error, int sockfd, struct sockaddr *cliaddr, socklen_t *addrlen)
+{
+  if (options::accept_batching && !(options::enforce_non_det_annotations && inNonDet))
+    return acceptBatchHelper(ins, error, syncfunc::accept, sockfd, cliaddr, addrlen, 0);
   BLOCK_TIMER_START(accept, ins, error, sockfd, cliaddr, addrlen);
   int ret = Runtime::__accept(ins, error, sockfd, cliaddr, addrlen);
   int from_port = 0;
   int to_port = 0;
-  if (options::log_sync) {
+  if (INSTR(options::log_sync)) {
     to_port = ((struct sockaddr_in *)cliaddr)->sin_port;
     struct sockaddr_in servaddr;
     socklen_t len = sizeof(servaddr);
@@ -1913,23 +2270,25 @@ int RecorderRT<_S>::__accept(unsigned ins, int &error, int sockfd, struct sockad
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__accept4(unsigned ins, int &error, int sockfd, struct sockaddr *cliaddr, socklen_t *addrlen, int flags)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__accept4(unsigned ins, int &error, int sockfd, struct sockaddr *cliaddr, socklen_t *addrlen, int flags)
 {
+  if (options::accept_batching && !(options::enforce_non_det_annotations && inNonDet))
+    return acceptBatchHelper(ins, error, syncfunc::accept4, sockfd, cliaddr, addrlen, flags);
   BLOCK_TIMER_START(accept4, ins, error, sockfd, cliaddr, addrlen, flags);
   int ret = Runtime::__accept4(ins, error, sockfd, cliaddr, addrlen, flags);
   BLOCK_TIMER_END(syncfunc::accept4, (uint64_t) ret);
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__connect(unsigned ins, int &error, int sockfd, const struct sockaddr *serv_addr, socklen_t addrlen)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__connect(unsigned ins, int &error, int sockfd, const struct sockaddr *serv_addr, socklen_t addrlen)
 {
   BLOCK_TIMER_START(connect, ins, error, sockfd, serv_addr, addrlen);
   int ret = Runtime::__connect(ins, error, sockfd, serv_addr, addrlen);
   int from_port = 0;
   int to_port = 0;
-  if (options::log_sync) {
+  if (INSTR(options::log_sync)) {
     from_port = ((const struct sockaddr_in*) serv_addr)->sin_port;
     struct sockaddr_in cliaddr;
     socklen_t len = sizeof(cliaddr);
@@ -1941,8 +2300,8 @@ int RecorderRT<_S>::__connect(unsigned ins, int &error, int sockfd, const struct
   return ret;
 }
 
-template <typename _S>
-ssize_t RecorderRT<_S>::__send(unsigned ins, int &error, int sockfd, const void *buf, size_t len, int flags)
+template <typename _S, bool _I>
+ssize_t RecorderRT<_S, _I>::__send(unsigned ins, int &error, int sockfd, const void *buf, size_t len, int flags)
 {
   /* Even it is non-blocking operation, we use BLOCK_* instead of SCHED_*, 
     because this operation can be involved by other systematic testing tools to 
@@ -1953,8 +2312,8 @@ ssize_t RecorderRT<_S>::__send(unsigned ins, int &error, int sockfd, const void
   return ret;
 }
 
-template <typename _S>
-ssize_t RecorderRT<_S>::__sendto(unsigned ins, int &error, int sockfd, const void *buf, size_t len, int flags, const struct sockaddr *dest_addr, socklen_t addrlen)
+template <typename _S, bool _I>
+ssize_t RecorderRT<_S, _I>::__sendto(unsigned ins, int &error, int sockfd, const void *buf, size_t len, int flags, const struct sockaddr *dest_addr, socklen_t addrlen)
 {
   BLOCK_TIMER_START(sendto, ins, error, sockfd, buf, len, flags, dest_addr, addrlen);
   int ret = Runtime::__sendto(ins, error, sockfd, buf, len, flags, dest_addr, addrlen);
@@ -1962,8 +2321,8 @@ ssize_t RecorderRT<_S>::__sendto(unsigned ins, int &error, int sockfd, const voi
   return ret;
 }
 
-template <typename _S>
-ssize_t RecorderRT<_S>::__sendmsg(unsigned ins, int &error, int sockfd, const struct msghdr *msg, int flags)
+template <typename _S, bool _I>
+ssize_t RecorderRT<_S, _I>::__sendmsg(unsigned ins, int &error, int sockfd, const struct msghdr *msg, int flags)
 {
   BLOCK_TIMER_START(sendmsg, ins, error, sockfd, msg, flags);
   int ret = Runtime::__sendmsg(ins, error, sockfd, msg, flags);
@@ -1971,8 +2330,8 @@ ssize_t RecorderRT<_S>::__sendmsg(unsigned ins, int &error, int sockfd, const st
   return ret;
 }
 
-template <typename _S>
-ssize_t RecorderRT<_S>::__recv(unsigned ins, int &error, int sockfd, void *buf, size_t len, int flags)
+template <typename _S, bool _I>
+ssize_t RecorderRT<_S, _I>::__recv(unsigned ins, int &error, int sockfd, void *buf, size_t len, int flags)
 {
   BLOCK_TIMER_START(recv, ins, error, sockfd, buf, len, flags);
   ssize_t ret = Runtime::__recv(ins, error, sockfd, buf, len, flags);
@@ -1980,8 +2339,8 @@ ssize_t RecorderRT<_S>::__recv(unsigned ins, int &error, int sockfd, void *buf,
   return ret;
 }
 
-template <typename _S>
-ssize_t RecorderRT<_S>::__recvfrom(unsigned ins, int &error, int sockfd, void *buf, size_t len, int flags, struct sockaddr *src_addr, socklen_t *addrlen)
+template <typename _S, bool _I>
+ssize_t RecorderRT<_S, _I>::__recvfrom(unsigned ins, int &error, int sockfd, void *buf, size_t len, int flags, struct sockaddr *src_addr, socklen_t *addrlen)
 {
   BLOCK_TIMER_START(recvfrom, ins, error, sockfd, buf, len, flags, src_addr, addrlen);
   ssize_t ret = Runtime::__recvfrom(ins, error, sockfd, buf, len, flags, src_addr, addrlen);
@@ -1989,8 +2348,8 @@ ssize_t RecorderRT<_S>::__recvfrom(unsigned ins, int &error, int sockfd, void *b
   return ret;
 }
 
-template <typename _S>
-ssize_t RecorderRT<_S>::__recvmsg(unsigned ins, int &error, int sockfd, struct msghdr *msg, int flags)
+template <typename _S, bool _I>
+ssize_t RecorderRT<_S, _I>::__recvmsg(unsigned ins, int &error, int sockfd, struct msghdr *msg, int flags)
 {
   BLOCK_TIMER_START(recvmsg, ins, error, sockfd, msg, flags);
   ssize_t ret = Runtime::__recvmsg(ins, error, sockfd, msg, flags);
@@ -1998,8 +2357,8 @@ ssize_t RecorderRT<_S>::__recvmsg(unsigned ins, int &error, int sockfd, struct m
   return ret;
 }
 
-template <typename _S>
-ssize_t RecorderRT<_S>::__read(unsigned ins, int &error, int fd, void *buf, size_t count)
+template <typename _S, bool _I>
+ssize_t RecorderRT<_S, _I>::__read(unsigned ins, int &error, int fd, void *buf, size_t count)
 {
   // First, handle regular IO.
   if (options::RR_ignore_rw_regular_file && regularFile(fd))
@@ -2012,12 +2371,12 @@ ssize_t RecorderRT<_S>::__read(unsigned ins, int &error, int fd, void *buf, size
   return ret;
 }
 
-template <typename _S>
-ssize_t RecorderRT<_S>::__write(unsigned ins, int &error, int fd, const void *buf, size_t count)
+template <typename _S, bool _I>
+ssize_t RecorderRT<_S, _I>::__write(unsigned ins, int &error, int fd, const void *buf, size_t count)
 {
   // First, handle regular IO.
   if (options::RR_ignore_rw_regular_file && regularFile(fd)) {
-    dprintf("RecorderRT<_S>::__write ignores regular file %d\n", fd);
+    dprintf("RecorderRT<_S, _I>::__write ignores regular file %d\n", fd);
     return write(fd, buf, count);  // Directly call the libc write() for regular IO.
   }
 
@@ -2026,14 +2385,14 @@ ssize_t RecorderRT<_S>::__write(unsigned ins, int &error, int fd, const void *bu
     because this operation can be involved by other systematic testing tools to 
     explore non-deterministic order. */
   BLOCK_TIMER_START(write, ins, error, fd, buf, count);
-  dprintf("RecorderRT<_S>::__write handles inter-process file %d\n", fd);
+  dprintf("RecorderRT<_S, _I>::__write handles inter-process file %d\n", fd);
   ssize_t ret = Runtime::__write(ins, error, fd, buf, count);
   BLOCK_TIMER_END(syncfunc::write, (uint64_t) fd, (uint64_t) ret);
   return ret;
 }
 
-template <typename _S>
-ssize_t RecorderRT<_S>::__pread(unsigned ins, int &error, int fd, void *buf, size_t count, off_t offset)
+template <typename _S, bool _I>
+ssize_t RecorderRT<_S, _I>::__pread(unsigned ins, int &error, int fd, void *buf, size_t count, off_t offset)
 {
   // First, handle regular IO.
   if (options::RR_ignore_rw_regular_file && regularFile(fd))
@@ -2046,8 +2405,8 @@ ssize_t RecorderRT<_S>::__pread(unsigned ins, int &error, int fd, void *buf, siz
   return ret;
 }
 
-template <typename _S>
-ssize_t RecorderRT<_S>::__pwrite(unsigned ins, int &error, int fd, const void *buf, size_t count, off_t offset)
+template <typename _S, bool _I>
+ssize_t RecorderRT<_S, _I>::__pwrite(unsigned ins, int &error, int fd, const void *buf, size_t count, off_t offset)
 {
   // First, handle regular IO.
   if (options::RR_ignore_rw_regular_file && regularFile(fd))
@@ -2060,8 +2419,8 @@ ssize_t RecorderRT<_S>::__pwrite(unsigned ins, int &error, int fd, const void *b
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__select(unsigned ins, int &error, int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__select(unsigned ins, int &error, int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout)
 {
   BLOCK_TIMER_START(select, ins, error, nfds, readfds, writefds, exceptfds, timeout);
   int ret = Runtime::__select(ins, error, nfds, readfds, writefds, exceptfds, timeout);
@@ -2069,8 +2428,8 @@ int RecorderRT<_S>::__select(unsigned ins, int &error, int nfds, fd_set *readfds
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__epoll_wait(unsigned ins, int &error, int epfd, struct epoll_event *events, int maxevents, int timeout)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__epoll_wait(unsigned ins, int &error, int epfd, struct epoll_event *events, int maxevents, int timeout)
 {  
   BLOCK_TIMER_START(epoll_wait, ins, error, epfd, events, maxevents, timeout);
   int ret = Runtime::__epoll_wait(ins, error, epfd, events, maxevents, timeout);
@@ -2078,8 +2437,8 @@ int RecorderRT<_S>::__epoll_wait(unsigned ins, int &error, int epfd, struct epol
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__epoll_create(unsigned ins, int &error, int size)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__epoll_create(unsigned ins, int &error, int size)
 {  
   BLOCK_TIMER_START(epoll_create, ins, error, size);
   int ret = Runtime::__epoll_create(ins, error, size);
@@ -2087,8 +2446,8 @@ int RecorderRT<_S>::__epoll_create(unsigned ins, int &error, int size)
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__epoll_ctl(unsigned ins, int &error, int epfd, int op, int fd, struct epoll_event *event)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__epoll_ctl(unsigned ins, int &error, int epfd, int op, int fd, struct epoll_event *event)
 {  
   BLOCK_TIMER_START(epoll_ctl, ins, error, epfd, op, fd, event);
   int ret = Runtime::__epoll_ctl(ins, error, epfd, op, fd, event);
@@ -2096,8 +2455,8 @@ int RecorderRT<_S>::__epoll_ctl(unsigned ins, int &error, int epfd, int op, int
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__poll(unsigned ins, int &error, struct pollfd *fds, nfds_t nfds, int timeout)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__poll(unsigned ins, int &error, struct pollfd *fds, nfds_t nfds, int timeout)
 {
   BLOCK_TIMER_START(poll, ins, error, fds, nfds, timeout);
   int ret = Runtime::__poll(ins, error, fds, nfds, timeout);
@@ -2105,8 +2464,8 @@ int RecorderRT<_S>::__poll(unsigned ins, int &error, struct pollfd *fds, nfds_t
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__bind(unsigned ins, int &error, int socket, const struct sockaddr *address, socklen_t address_len)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__bind(unsigned ins, int &error, int socket, const struct sockaddr *address, socklen_t address_len)
 {
   BLOCK_TIMER_START(bind, ins, error, socket, address, address_len);
   int ret = Runtime::__bind(ins, error, socket, address, address_len);
@@ -2114,8 +2473,8 @@ int RecorderRT<_S>::__bind(unsigned ins, int &error, int socket, const struct so
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__sigwait(unsigned ins, int &error, const sigset_t *set, int *sig)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__sigwait(unsigned ins, int &error, const sigset_t *set, int *sig)
 {
   BLOCK_TIMER_START(sigwait, ins, error, set, sig);
   int ret = Runtime::__sigwait(ins, error, set, sig);
@@ -2123,8 +2482,8 @@ int RecorderRT<_S>::__sigwait(unsigned ins, int &error, const sigset_t *set, int
   return ret;
 }
 
-template <typename _S>
-char *RecorderRT<_S>::__fgets(unsigned ins, int &error, char *s, int size, FILE *stream)
+template <typename _S, bool _I>
+char *RecorderRT<_S, _I>::__fgets(unsigned ins, int &error, char *s, int size, FILE *stream)
 {
   // First, handle regular IO.
   if (options::RR_ignore_rw_regular_file && regularFile(fileno(stream)))
@@ -2137,8 +2496,8 @@ char *RecorderRT<_S>::__fgets(unsigned ins, int &error, char *s, int size, FILE
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__kill(unsigned ins, int &error, pid_t pid, int sig)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__kill(unsigned ins, int &error, pid_t pid, int sig)
 {
   BLOCK_TIMER_START(kill, ins, error, pid, sig);
   int ret = Runtime::__kill(ins, error, pid, sig);
@@ -2146,13 +2505,13 @@ int RecorderRT<_S>::__kill(unsigned ins, int &error, pid_t pid, int sig)
   return ret;
 }
 
-template <typename _S>
-pid_t RecorderRT<_S>::__fork(unsigned ins, int &error)
+template <typename _S, bool _I>
+pid_t RecorderRT<_S, _I>::__fork(unsigned ins, int &error)
 {
   dprintf("pid %d enters fork\n", getpid());
   pid_t ret;
 
-  if (options::log_sync)
+  if (INSTR(options::log_sync))
     Logger::the->flush(); // so child process won't write it again
 
   /* Although this is inter-process operation, and we need to involve dbug
@@ -2166,6 +2525,8 @@ pid_t RecorderRT<_S>::__fork(unsigned ins, int &error)
   ret = Runtime::__fork(ins, error);
   if(ret == 0) {
     // child process returns from fork; re-initializes scheduler and logger state
+    Logger::childForkReturn();
+    LiveStat::childForkReturn();
     Logger::threadEnd(); // close log
     Logger::threadBegin(_S::self()); // re-open log
     assert(!sem_init(&thread_begin_sem, 0, 0));
@@ -2189,23 +2550,24 @@ pid_t RecorderRT<_S>::__fork(unsigned ins, int &error)
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__execv(unsigned ins, int &error, const char *path, char *const argv[])
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__execv(unsigned ins, int &error, const char *path, char *const argv[])
 {
-  if (options::log_sync)
+  if (INSTR(options::log_sync))
     Logger::the->flush(); // so child process won't write it again
     
   int ret = 0;
   SCHED_TIMER_START;
   nturn = 0; // Just avoid compiler warning.
+  (void)hog_stall;
   ret = Runtime::__execv(ins, error, path, argv);
   assert(false && "execv failed.");
 
   return ret;
 }
 
-template <typename _S>
-pid_t RecorderRT<_S>::__wait(unsigned ins, int &error, int *status)
+template <typename _S, bool _I>
+pid_t RecorderRT<_S, _I>::__wait(unsigned ins, int &error, int *status)
 {
   BLOCK_TIMER_START(wait, ins, error, status);
   pid_t ret = Runtime::__wait(ins, error, status);
@@ -2213,8 +2575,8 @@ pid_t RecorderRT<_S>::__wait(unsigned ins, int &error, int *status)
   return ret;
 }
 
-template <typename _S>
-pid_t RecorderRT<_S>::__waitpid(unsigned ins, int &error, pid_t pid, int *status, int options)
+template <typename _S, bool _I>
+pid_t RecorderRT<_S, _I>::__waitpid(unsigned ins, int &error, pid_t pid, int *status, int options)
 {
   BLOCK_TIMER_START(waitpid, ins, error, pid, status, options);
   pid_t ret = Runtime::__waitpid(ins, error, pid, status, options);
@@ -2223,8 +2585,8 @@ pid_t RecorderRT<_S>::__waitpid(unsigned ins, int &error, pid_t pid, int *status
 }
 
 
-template <typename _S>
-int RecorderRT<_S>::schedYield(unsigned ins, int &error)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::schedYield(unsigned ins, int &error)
 {
   int ret;
   if (options::enforce_non_det_annotations && inNonDet) {
@@ -2242,8 +2604,8 @@ int RecorderRT<_S>::schedYield(unsigned ins, int &error)
 
 // TODO: right now we treat sleep functions just as a turn; should convert
 // real time to logical time
-template <typename _S>
-unsigned int RecorderRT<_S>::__sleep(unsigned ins, int &error, unsigned int seconds)
+template <typename _S, bool _I>
+unsigned int RecorderRT<_S, _I>::__sleep(unsigned ins, int &error, unsigned int seconds)
 {
 #ifdef XTERN_PLUS_DBUG
   BLOCK_TIMER_START(sleep, ins, error, seconds);
@@ -2254,8 +2616,8 @@ unsigned int RecorderRT<_S>::__sleep(unsigned ins, int &error, unsigned int seco
   struct timespec ts = {seconds, 0};
   SCHED_TIMER_START;
   // must call _S::getTurnCount with turn held
-  unsigned timeout = _S::getTurnCount() + relTimeToTurn(&ts);
-  _S::wait(NULL, timeout);
+  uint64_t timeout = _S::getTurnCount() + relTimeToTurn(&ts);
+  turnWait(NULL, timeout);
   SCHED_TIMER_END(syncfunc::sleep, (uint64_t) seconds * 1000000000);
   if (options::exec_sleep)
     ::sleep(seconds);
@@ -2263,8 +2625,8 @@ unsigned int RecorderRT<_S>::__sleep(unsigned ins, int &error, unsigned int seco
 #endif
 }
 
-template <typename _S>
-int RecorderRT<_S>::__usleep(unsigned ins, int &error, useconds_t usec)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__usleep(unsigned ins, int &error, useconds_t usec)
 {
 #ifdef XTERN_PLUS_DBUG
   BLOCK_TIMER_START(usleep, ins, error, usec);
@@ -2276,8 +2638,8 @@ int RecorderRT<_S>::__usleep(unsigned ins, int &error, useconds_t usec)
   struct timespec ts = {0, 1000*usec};
   SCHED_TIMER_START;
   // must call _S::getTurnCount with turn held
-  unsigned timeout = _S::getTurnCount() + relTimeToTurn(&ts);
-  _S::wait(NULL, timeout);
+  uint64_t timeout = _S::getTurnCount() + relTimeToTurn(&ts);
+  turnWait(NULL, timeout);
   SCHED_TIMER_END(syncfunc::usleep, (uint64_t) usec * 1000);
   if (options::exec_sleep)
     ::usleep(usec);
@@ -2285,8 +2647,8 @@ int RecorderRT<_S>::__usleep(unsigned ins, int &error, useconds_t usec)
 #endif
 }
 
-template <typename _S>
-int RecorderRT<_S>::__nanosleep(unsigned ins, int &error, 
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__nanosleep(unsigned ins, int &error, 
                               const struct timespec *req,
                               struct timespec *rem)
 {
@@ -2299,8 +2661,8 @@ int RecorderRT<_S>::__nanosleep(unsigned ins, int &error,
 #else
  SCHED_TIMER_START;
    // must call _S::getTurnCount with turn held
-  unsigned timeout = _S::getTurnCount() + relTimeToTurn(req);
-  _S::wait(NULL, timeout);
+  uint64_t timeout = _S::getTurnCount() + relTimeToTurn(req);
+  turnWait(NULL, timeout);
   uint64_t nsec = !req ? 0 : (req->tv_sec * 1000000000 + req->tv_nsec); 
   SCHED_TIMER_END(syncfunc::nanosleep, (uint64_t) nsec);
   if (options::exec_sleep)
@@ -2309,8 +2671,8 @@ int RecorderRT<_S>::__nanosleep(unsigned ins, int &error,
 #endif
 }
 
-template <typename _S>
-int RecorderRT<_S>::__socket(unsigned ins, int &error, int domain, int type, int protocol)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__socket(unsigned ins, int &error, int domain, int type, int protocol)
 {
   BLOCK_TIMER_START(socket, ins, error, domain, type, protocol);
   int ret = Runtime::__socket(ins, error, domain, type, protocol);
@@ -2318,17 +2680,19 @@ int RecorderRT<_S>::__socket(unsigned ins, int &error, int domain, int type, int
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__listen(unsigned ins, int &error, int sockfd, int backlog)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__listen(unsigned ins, int &error, int sockfd, int backlog)
 {
   BLOCK_TIMER_START(listen, ins, error, sockfd, backlog);
   int ret = Runtime::__listen(ins, error, sockfd, backlog);
   BLOCK_TIMER_END(syncfunc::listen, (uint64_t)sockfd, (uint64_t)backlog, (uint64_t)ret);
+  if (options::accept_batching && ret == 0)
+    resetAcceptBatch(sockfd);
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__shutdown(unsigned ins, int &error, int sockfd, int how)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__shutdown(unsigned ins, int &error, int sockfd, int how)
 {
   BLOCK_TIMER_START(shutdown, ins, error, sockfd, how);
   int ret = Runtime::__shutdown(ins, error, sockfd, how);
@@ -2336,14 +2700,14 @@ int RecorderRT<_S>::__shutdown(unsigned ins, int &error, int sockfd, int how)
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__getpeername(unsigned ins, int &error, int sockfd, struct sockaddr *addr, socklen_t *addrlen)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__getpeername(unsigned ins, int &error, int sockfd, struct sockaddr *addr, socklen_t *addrlen)
 {
   return Runtime::__getpeername(ins, error, sockfd, addr, addrlen);
 }
 
-template <typename _S>
-int RecorderRT<_S>::__getsockopt(unsigned ins, int &error, int sockfd, int level, int optname,
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__getsockopt(unsigned ins, int &error, int sockfd, int level, int optname,
                       void *optval, socklen_t *optlen)
 {
   BLOCK_TIMER_START(getsockopt, ins, error, sockfd, level, optname, optval, optlen);
@@ -2352,8 +2716,8 @@ int RecorderRT<_S>::__getsockopt(unsigned ins, int &error, int sockfd, int level
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__setsockopt(unsigned ins, int &error, int sockfd, int level, int optname,
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__setsockopt(unsigned ins, int &error, int sockfd, int level, int optname,
                       const void *optval, socklen_t optlen)
 {
   BLOCK_TIMER_START(setsockopt, ins, error, sockfd, level, optname, optval, optlen);
@@ -2362,8 +2726,8 @@ int RecorderRT<_S>::__setsockopt(unsigned ins, int &error, int sockfd, int level
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__pipe(unsigned ins, int &error, int pipefd[2])
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__pipe(unsigned ins, int &error, int pipefd[2])
 {
   BLOCK_TIMER_START(pipe, ins, error, pipefd);
   int ret = Runtime::__pipe(ins, error, pipefd);
@@ -2371,8 +2735,8 @@ int RecorderRT<_S>::__pipe(unsigned ins, int &error, int pipefd[2])
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__fcntl(unsigned ins, int &error, int fd, int cmd, void *arg)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__fcntl(unsigned ins, int &error, int fd, int cmd, void *arg)
 {
   BLOCK_TIMER_START(fcntl, ins, error, fd, cmd, arg);
   int ret = Runtime::__fcntl(ins, error, fd, cmd, arg);
@@ -2381,8 +2745,8 @@ int RecorderRT<_S>::__fcntl(unsigned ins, int &error, int fd, int cmd, void *arg
 }
 
 
-template <typename _S>
-int RecorderRT<_S>::__close(unsigned ins, int &error, int fd)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__close(unsigned ins, int &error, int fd)
 {
   // First, handle regular IO.
   if (options::RR_ignore_rw_regular_file && regularFile(fd))
@@ -2393,7 +2757,7 @@ int RecorderRT<_S>::__close(unsigned ins, int &error, int fd)
   int ret = Runtime::__close(ins, error, fd);
   BLOCK_TIMER_END(syncfunc::close, (uint64_t)fd, (uint64_t)ret);
   // For servers, print stat here, at this point it could be non-det but it is fine, network is non-det anyway.
-  if (options::record_runtime_stat)
+  if (INSTR(options::record_runtime_stat))
     stat.print();  
   return ret;
 }
@@ -2421,81 +2785,195 @@ int RecorderRT<RecordSerializer>::__nanosleep(unsigned ins, int &error,
   return _P::__nanosleep(ins, error, req, rem);
 }
 
-template <typename _S>
-time_t RecorderRT<_S>::__time(unsigned ins, int &error, time_t *t)
+template <typename _S, bool _I>
+time_t RecorderRT<_S, _I>::__time(unsigned ins, int &error, time_t *t)
 {
   return Runtime::__time(ins, error, t);
 }
 
-template <typename _S>
-int RecorderRT<_S>::__clock_getres(unsigned ins, int &error, clockid_t clk_id, struct timespec *res)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__clock_getres(unsigned ins, int &error, clockid_t clk_id, struct timespec *res)
 {
   return Runtime::__clock_getres(ins, error, clk_id, res);
 }
 
-template <typename _S>
-int RecorderRT<_S>::__clock_gettime(unsigned ins, int &error, clockid_t clk_id, struct timespec *tp)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__clock_gettime(unsigned ins, int &error, clockid_t clk_id, struct timespec *tp)
 {
   return Runtime::__clock_gettime(ins, error, clk_id, tp);
 }
 
-template <typename _S>
-int RecorderRT<_S>::__clock_settime(unsigned ins, int &error, clockid_t clk_id, const struct timespec *tp)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__clock_settime(unsigned ins, int &error, clockid_t clk_id, const struct timespec *tp)
 {
   return Runtime::__clock_settime(ins, error, clk_id, tp);
 }
 
-template <typename _S>
-int RecorderRT<_S>::__gettimeofday(unsigned ins, int &error, struct timeval *tv, struct timezone *tz)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__gettimeofday(unsigned ins, int &error, struct timeval *tv, struct timezone *tz)
 {
   return Runtime::__gettimeofday(ins, error, tv, tz);
 }
 
-template <typename _S>
-int RecorderRT<_S>::__settimeofday(unsigned ins, int &error, const struct timeval *tv, const struct timezone *tz)
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__settimeofday(unsigned ins, int &error, const struct timeval *tv, const struct timezone *tz)
 {
   return Runtime::__settimeofday(ins, error, tv, tz);
 }
 
-template <typename _S>
-struct hostent *RecorderRT<_S>::__gethostbyname(unsigned ins, int &error, const char *name)
+/// getaddrinfo() through the dns cache.  A hit is served with the turn
+/// held, without going out to nsswitch or the resolver.  On a miss, the
+/// thread gives up the turn and resolves as a blocking op, just like the
+/// uncached path, then takes the turn again to publish the answer.  If
+/// another thread published the same key in the meantime, its answer wins
+/// so that every caller sees the first answer.  Failed resolutions are not
+/// cached since they are often transient (EAI_AGAIN).
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::getaddrinfoCached(unsigned ins, int &error, const char *node, const char *service,
+                                      const struct addrinfo *hints, struct addrinfo **res)
+{
+  int ret = 0;
+  SCHED_TIMER_START;
+  if (dns_cache.lookupAddrInfo(node, service, hints, res)) {
+    SCHED_TIMER_END(syncfunc::getaddrinfo, (uint64_t)ret, (uint64_t)1);
+    return ret;
+  }
+  SCHED_TIMER_FAKE_END(syncfunc::getaddrinfo, (uint64_t)0, (uint64_t)0);
+  _S::putTurn();
+
+  if (_S::interProStart())
+    _S::block();
+  Runtime::__attach_self_to_dbug(__FUNCTION__);
+  struct addrinfo *ai = NULL;
+  ret = Runtime::__getaddrinfo(ins, error, node, service, hints, &ai);
+  Runtime::__detach_self_from_dbug(__FUNCTION__);
+  if (_S::interProEnd())
+    _S::wakeup();
+
+  SCHED_TIMER_REGET;
+  if (ret == 0) {
+    dns_cache.insertAddrInfo(node, service, hints, ai, res);
+    Runtime::__freeaddrinfo(ins, error, ai);
+  }
+  SCHED_TIMER_END(syncfunc::getaddrinfo, (uint64_t)ret, (uint64_t)0);
+  return ret;
+}
+
+/// gethostbyname() through the dns cache; see getaddrinfoCached().  The
+/// returned hostent lives as long as the cache, which is no worse than the
+/// static buffer libc returns.
+template <typename _S, bool _I>
+struct hostent *RecorderRT<_S, _I>::gethostbynameCached(unsigned ins, int &error, const char *name)
+{
+  struct hostent *ret;
+  SCHED_TIMER_START;
+  if ((ret = dns_cache.lookupHost(name))) {
+    SCHED_TIMER_END(syncfunc::gethostbyname, (uint64_t)ret, (uint64_t)1);
+    return ret;
+  }
+  SCHED_TIMER_FAKE_END(syncfunc::gethostbyname, (uint64_t)0, (uint64_t)0);
+  _S::putTurn();
+
+  if (_S::interProStart())
+    _S::block();
+  Runtime::__attach_self_to_dbug(__FUNCTION__);
+  ret = Runtime::__gethostbyname(ins, error, name);
+  Runtime::__detach_self_from_dbug(__FUNCTION__);
+  if (_S::interProEnd())
+    _S::wakeup();
+
+  SCHED_TIMER_REGET;
+  if (ret)
+    ret = dns_cache.insertHost(name, ret);
+  SCHED_TIMER_END(syncfunc::gethostbyname, (uint64_t)ret, (uint64_t)0);
+  return ret;
+}
+
+/// gethostbyname_r() through the dns cache; see getaddrinfoCached().
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::gethostbynameRCached(unsigned ins, int &error, const char *name, struct hostent *ret,
+                                         char *buf, size_t buflen, struct hostent **result, int *h_errnop)
 {
+  int ret2 = 0;
+  struct hostent *cached;
+  SCHED_TIMER_START;
+  if ((cached = dns_cache.lookupHost(name))) {
+    ret2 = DnsCache::copyHost(cached, ret, buf, buflen);
+    *result = ret2 ? NULL : ret;
+    SCHED_TIMER_END(syncfunc::gethostbyname_r, (uint64_t)ret2, (uint64_t)1);
+    return ret2;
+  }
+  SCHED_TIMER_FAKE_END(syncfunc::gethostbyname_r, (uint64_t)0, (uint64_t)0);
+  _S::putTurn();
+
+  if (_S::interProStart())
+    _S::block();
+  Runtime::__attach_self_to_dbug(__FUNCTION__);
+  ret2 = Runtime::__gethostbyname_r(ins, error, name, ret, buf, buflen, result, h_errnop);
+  Runtime::__detach_self_from_dbug(__FUNCTION__);
+  if (_S::interProEnd())
+    _S::wakeup();
+
+  SCHED_TIMER_REGET;
+  if (ret2 == 0 && *result) {
+    cached = dns_cache.insertHost(name, *result);
+    // another thread may have cached a different answer first
+    ret2 = DnsCache::copyHost(cached, ret, buf, buflen);
+    *result = ret2 ? NULL : ret;
+  }
+  SCHED_TIMER_END(syncfunc::gethostbyname_r, (uint64_t)ret2, (uint64_t)0);
+  return ret2;
+}
+
+template <typename _S, bool _I>
+struct hostent *RecorderRT<_S, _I>::__gethostbyname(unsigned ins, int &error, const char *name)
+{
+  if (options::dns_cache && !(options::enforce_non_det_annotations && inNonDet))
+    return gethostbynameCached(ins, error, name);
   BLOCK_TIMER_START(gethostbyname, ins, error, name);
   struct hostent *ret = Runtime::__gethostbyname(ins, error, name);
   BLOCK_TIMER_END(syncfunc::gethostbyname, (uint64_t)ret);
   return ret;
 }
 
-template <typename _S>
-int RecorderRT<_S>::__gethostbyname_r(unsigned ins, int &error, const char *name, struct hostent *ret,
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__gethostbyname_r(unsigned ins, int &error, const char *name, struct hostent *ret,
   char *buf, size_t buflen, struct hostent **result, int *h_errnop)
 {
-  BLOCK_TIMER_START(gethostbyname_r, ins, error, name, ret, buf, buflen, result, h_errnop);
-  int ret2 = Runtime::__gethostbyname_r(ins, error, name, ret, buf, buflen, result, h_errnop);
-  BLOCK_TIMER_END(syncfunc::gethostbyname_r, (uint64_t)ret2);
-  return ret2;
+  if (options::dns_cache && !(options::enforce_non_det_annotations && inNonDet))
+    return gethostbynameRCached(ins, error, name, ret, buf, buflen, result, h_errnop);
+  // without the cache, this call goes straight to libc, unscheduled.
+  return Runtime::__gethostbyname_r(ins, error, name, ret, buf, buflen, result, h_errnop);
 }
 
-template <typename _S>
-int RecorderRT<_S>::__getaddrinfo(unsigned ins, int &error, const char *node, const char *service, const struct addrinfo *hints,
+template <typename _S, bool _I>
+int RecorderRT<_S, _I>::__getaddrinfo(unsigned ins, int &error, const char *node, const char *service, const struct addrinfo *hints,
 struct addrinfo **res)
 {
-  BLOCK_TIMER_START(getaddrinfo, ins, error, node, service, hints, res);
-  int ret2 = Runtime::__getaddrinfo(ins, error, node, service, hints, res);
-  BLOCK_TIMER_END(syncfunc::getaddrinfo, (uint64_t)ret2);
-  return ret2;
+  if (options::dns_cache && !(options::enforce_non_det_annotations && inNonDet))
+    return getaddrinfoCached(ins, error, node, service, hints, res);
+  // without the cache, this call goes straight to libc, unscheduled.
+  return Runtime::__getaddrinfo(ins, error, node, service, hints, res);
 }
 
-template <typename _S>
-void RecorderRT<_S>::__freeaddrinfo(unsigned ins, int &error, struct addrinfo *res)
+template <typename _S, bool _I>
+void RecorderRT<_S, _I>::__freeaddrinfo(unsigned ins, int &error, struct addrinfo *res)
 {
-  BLOCK_TIMER_START(freeaddrinfo, ins, error, res);
+  if (options::dns_cache && !(options::enforce_non_det_annotations && inNonDet)) {
+    // lists from the cache are shared; only drop a reference.  Other
+    // lists (e.g., resolved in a non-det region) go back to libc.
+    SCHED_TIMER_START;
+    bool cached = dns_cache.releaseAddrInfo(res);
+    if (!cached)
+      Runtime::__freeaddrinfo(ins, error, res);
+    SCHED_TIMER_END(syncfunc::freeaddrinfo, (uint64_t)res, (uint64_t)cached);
+    return;
+  }
   Runtime::__freeaddrinfo(ins, error, res);
-  BLOCK_TIMER_END(syncfunc::freeaddrinfo, (uint64_t)ret2);
 }
 
-template <typename _S>
-struct hostent *RecorderRT<_S>::__gethostbyaddr(unsigned ins, int &error, const void *addr, int len, int type)
+template <typename _S, bool _I>
+struct hostent *RecorderRT<_S, _I>::__gethostbyaddr(unsigned ins, int &error, const void *addr, int len, int type)
 {
   BLOCK_TIMER_START(gethostbyaddr, ins, error, addr, len, type);
   struct hostent *ret = Runtime::__gethostbyaddr(ins, error, addr, len, type);
@@ -2503,16 +2981,16 @@ struct hostent *RecorderRT<_S>::__gethostbyaddr(unsigned ins, int &error, const
   return ret;
 }
 
-template <typename _S>
-char *RecorderRT<_S>::__inet_ntoa(unsigned ins, int &error, struct in_addr in) {
+template <typename _S, bool _I>
+char *RecorderRT<_S, _I>::__inet_ntoa(unsigned ins, int &error, struct in_addr in) {
   BLOCK_TIMER_START(inet_ntoa, ins, error, in);
   char * ret = Runtime::__inet_ntoa(ins, error, in);
   BLOCK_TIMER_END(syncfunc::inet_ntoa, (uint64_t)ret);
   return ret;
 }
 
-template <typename _S>
-char *RecorderRT<_S>::__strtok(unsigned ins, int &error, char * str, const char * delimiters) {
+template <typename _S, bool _I>
+char *RecorderRT<_S, _I>::__strtok(unsigned ins, int &error, char * str, const char * delimiters) {
   BLOCK_TIMER_START(strtok, ins, error, str, delimiters);
   char * ret = Runtime::__strtok(ins, error, str, delimiters);
   BLOCK_TIMER_END(syncfunc::strtok, (uint64_t)ret);
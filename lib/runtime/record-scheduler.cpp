@@ -30,7 +30,9 @@
 #include <algorithm>
 #include <sched.h>
 #include "tern/options.h"
+#include "tern/syncfuncs.h"
 #include "tern/runtime/rdtsc.h"
+#include "tern/runtime/probes.h"
 
 using namespace std;
 using namespace tern;
@@ -116,9 +118,9 @@ void RRScheduler::wait_t::post() {
 
 //@before with turn
 //@after with turn
-unsigned RRScheduler::nextTimeout()
+uint64_t RRScheduler::nextTimeout()
 {
-  unsigned next_timeout = FOREVER;
+  uint64_t next_timeout = FOREVER;
   list<int>::iterator i;
   for(i=waitq.begin(); i!=waitq.end(); ++i) {
     int t = *i;
@@ -141,8 +143,9 @@ int RRScheduler::fireTimeouts()
     int tid = *prv;
     assert(tid >=0 && tid < Scheduler::nthread);
     if(waits[tid].timeout < turnCount) {
-      dprintf("RRScheduler: %d timed out (%p, %u)\n",
-              tid, waits[tid].chan, waits[tid].timeout);
+      dprintf("RRScheduler: %d timed out (%p, %llu)\n",
+              tid, waits[tid].chan, (unsigned long long)waits[tid].timeout);
+      XTERN_PROBE3(timeout, tid, waits[tid].chan, waits[tid].timeout);
       waits[tid].reset(ETIMEDOUT);
       waitq.erase(prv);
       runq.push_back(tid);
@@ -163,8 +166,9 @@ void RRScheduler::check_wakeup()
       if (!runq.in(*itr)) {
         runq.push_back(*itr);
         if (options::enforce_non_det_clock_bound) {
-          dprintf("check_wakeup: current logical clock %u, first non det tid %d, my tid %d, non det logical clock %u, \
-            the system is within bounded non-determinism.\n", turnCount, *itr, self(), non_det_thds.get_clock(*itr));
+          dprintf("check_wakeup: current logical clock %llu, first non det tid %d, my tid %d, non det logical clock %llu, \
+            the system is within bounded non-determinism.\n", (unsigned long long)turnCount, *itr, self(),
+            (unsigned long long)non_det_thds.get_clock(*itr));
           non_det_thds.erase(*itr); // This operation is required by the bounded non-determinism mechanism.
         }
       }
@@ -181,6 +185,8 @@ void RRScheduler::next(bool at_thread_end, bool hasPoppedFront)
 {
   int tid = self();
   int next_tid;
+  // the turn leaves this thread, which ends any run of kept turns
+  coalesce_left[tid] = options::coalesce_ops;
   if (!hasPoppedFront) {
     // Update the status of the head element.
     struct run_queue::runq_elem *my = runq.get_my_elem(tid);
@@ -274,7 +280,7 @@ void RRScheduler::getTurn()
   SELFCHECK;
 }
 
-int RRScheduler::block()
+void RRScheduler::block()
 {
   getTurn();
   int tid = self();
@@ -283,9 +289,8 @@ int RRScheduler::block()
   assert(tid>=0 && tid < Scheduler::nthread);
   assert(tid == runq.front());
   dprintf("RRScheduler: %d blocks\n", self());
-  int ret = incTurnCount();
+  incTurnCount();
   next();
-  return ret;
 }
 
 void RRScheduler::wakeup()
@@ -309,6 +314,17 @@ void RRScheduler::putTurn(bool at_thread_end)
     signal((void*)pthread_self());
     Parent::zombify(pthread_self());
     dprintf("RRScheduler: %d ends\n", self());
+  } else if (keep_turn) {
+    // stay at the head of runq with the turn handed to ourselves, the
+    // same state as a thread that was given the turn and has not yet
+    // called getTurn(); block(), wait() and interProStart() handle it
+    keep_turn = false;
+    -- coalesce_left[tid];
+    checkNonDetBound();
+    XTERN_PROBE2(put_turn, tid, turnCount);
+    dprintf("RRScheduler: %d keeps turn\n", self());
+    waits[tid].post();
+    return;
   } else {
     // Check and modify "my" run queue element. No need to grab element spinlock since I am the head.
     struct run_queue::runq_elem *my = runq.get_my_elem(tid);
@@ -320,19 +336,20 @@ void RRScheduler::putTurn(bool at_thread_end)
     // Process run queue structure.
     runq.pop_front();
     hasPoppedFront = true;
-    runq.push_back(tid);
+    requeue(tid);
     dprintf("RRScheduler: %d puts turn\n", self());
   }
 
   // Enforce bounded non-determinism.
   checkNonDetBound();
 
+  XTERN_PROBE2(put_turn, tid, turnCount);
   next(at_thread_end, hasPoppedFront);
 }
 
 //@before with turn
 //@after with turn
-int RRScheduler::wait(void *chan, unsigned nturn)
+int RRScheduler::wait(void *chan, uint64_t nturn)
 {
   record_rdtsc_op("RRScheduler::wait", "START", 2, NULL); // record rdtsc, disabled by default, no performance impact.
   incTurnCount();
@@ -342,7 +359,9 @@ int RRScheduler::wait(void *chan, unsigned nturn)
   waits[tid].chan = chan;
   waits[tid].timeout = nturn;
   waitq.push_back(tid);
-  dprintf("RRScheduler: %d waits on (%p, %u)\n", tid, chan, nturn);
+  dprintf("RRScheduler: %d waits on (%p, %llu)\n", tid, chan,
+          (unsigned long long)nturn);
+  XTERN_PROBE3(wait, tid, chan, nturn);
 
   next();
 
@@ -373,6 +392,7 @@ std::list<int> RRScheduler::signal(void *chan, bool all)
       signal_list.push_back(tid);
 #endif
       dprintf("RRScheduler: %d signals %d(%p)\n", self(), tid, chan);
+      XTERN_PROBE3(signal, self(), tid, chan);
       waits[tid].reset();
       waitq.erase(prv);
       runq.push_back(tid);
@@ -386,23 +406,47 @@ std::list<int> RRScheduler::signal(void *chan, bool all)
 
 //@before with turn
 //@after with turn
-unsigned RRScheduler::incTurnCount(void)
+uint64_t RRScheduler::incTurnCount(void)
 {
-  unsigned ret = Serializer::incTurnCount();
+  uint64_t ret = Serializer::incTurnCount();
   fireTimeouts();
   check_wakeup();
   return ret;
 }
 
-unsigned RRScheduler::getTurnCount(void)
+uint64_t RRScheduler::getTurnCount(void)
 {
   return Serializer::getTurnCount();
 }
 
 void RRScheduler::childForkReturn() {
   Parent::childForkReturn();
-  for(int i=0; i<MAX_THREAD_NUM; ++i)
+  for(int i=0; i<MAX_THREAD_NUM; ++i) {
     waits[i].reset();
+    coalesce_left[i] = options::coalesce_ops;
+  }
+  keep_turn = false;
+}
+
+//@before with turn
+//@after with turn
+void RRScheduler::coalesce(unsigned syncop)
+{
+  if (coalesce_left[self()] <= 0)
+    return;
+  switch (syncop) {
+  case syncfunc::pthread_mutex_unlock:
+  case syncfunc::pthread_mutex_trylock:
+  case syncfunc::pthread_rwlock_unlock:
+  case syncfunc::pthread_rwlock_tryrdlock:
+  case syncfunc::pthread_rwlock_trywrlock:
+  case syncfunc::pthread_cond_signal:
+  case syncfunc::pthread_cond_broadcast:
+  case syncfunc::sem_post:
+  case syncfunc::sem_trywait:
+    keep_turn = true;
+    break;
+  }
 }
 
 
@@ -420,6 +464,10 @@ RRScheduler::RRScheduler()
   inter_pro_wakeup_tids.clear();
   inter_pro_wakeup_flag = 0;
   pthread_mutex_init(&inter_pro_wakeup_mutex, NULL);
+
+  keep_turn = false;
+  for (int i = 0; i < MAX_THREAD_NUM; ++i)
+    coalesce_left[i] = options::coalesce_ops;
 }
 
 void RRScheduler::selfcheck(void)
@@ -598,14 +646,111 @@ bool RRScheduler::tryPutTurn() {
 void RRScheduler::checkNonDetBound() { 
   if (options::enforce_non_det_clock_bound && non_det_thds.size() > 0) {
     int tid = non_det_thds.first_thread();
-    unsigned clock = non_det_thds.get_clock(tid);
+    uint64_t clock = non_det_thds.get_clock(tid);
     if (turnCount > clock + options::non_det_clock_bound) {
       //assert(!runq.in(tid));
       runq.push_back(tid);
       non_det_thds.erase(tid);
-      dprintf("checkNonDetBound: current logical clock %u, first non det tid %d, my tid %d, non det logical clock %u, \
-        try to block the deterministict part of the system.\n", turnCount, tid, self(), clock);
+      dprintf("checkNonDetBound: current logical clock %llu, first non det tid %d, my tid %d, non det logical clock %llu, \
+        try to block the deterministict part of the system.\n", (unsigned long long)turnCount, tid, self(),
+        (unsigned long long)clock);
+    }
+  }
+}
+
+RandomScheduler::RandomScheduler()
+{
+  rng.srand(options::scheduler_seed);
+}
+
+//@before with turn
+void RandomScheduler::requeue(int tid)
+{
+  if (rng.rand(1))
+    runq.push_front(tid);
+  else
+    runq.push_back(tid);
+}
+
+PassthroughScheduler::PassthroughScheduler()
+{
+  pthread_mutex_init(&lock, NULL);
+}
+
+//@before with turn
+//@after without turn
+void PassthroughScheduler::putTurn(bool at_thread_end)
+{
+  if (at_thread_end) {
+    signal((void*)pthread_self());
+    zombify(pthread_self());
+  }
+  pthread_mutex_unlock(&lock);
+}
+
+//@before with turn
+//@after with turn
+int PassthroughScheduler::wait(void *chan, uint64_t nturn)
+{
+  incTurnCount();
+  int tid = self();
+  assert(tid>=0 && tid < MAX_THREAD_NUM);
+  wait_t &w = waits[tid];
+  w.chan = chan;
+  w.timeout = nturn;
+  w.status = 0;
+  w.waiting = true;
+  waitq.push_back(tid);
+  while (w.waiting)
+    pthread_cond_wait(&w.cond, &lock);
+  return w.status;
+}
+
+//@before with turn
+//@after with turn
+std::list<int> PassthroughScheduler::signal(void *chan, bool all)
+{
+  std::list<int> signal_list;
+  list<int>::iterator prv, cur;
+  for(cur=waitq.begin(); cur!=waitq.end();) {
+    prv = cur ++;
+    int tid = *prv;
+    if(waits[tid].chan == chan) {
+      signal_list.push_back(tid);
+      waits[tid].waiting = false;
+      waitq.erase(prv);
+      pthread_cond_signal(&waits[tid].cond);
+      if(!all)
+        break;
     }
   }
+  return signal_list;
+}
+
+//@before with turn
+//@after with turn
+uint64_t PassthroughScheduler::incTurnCount(void)
+{
+  uint64_t ret = Serializer::incTurnCount();
+  list<int>::iterator prv, cur;
+  for(cur=waitq.begin(); cur!=waitq.end();) {
+    prv = cur ++;
+    int tid = *prv;
+    if(waits[tid].timeout < turnCount) {
+      waits[tid].status = ETIMEDOUT;
+      waits[tid].waiting = false;
+      waitq.erase(prv);
+      pthread_cond_signal(&waits[tid].cond);
+    }
+  }
+  return ret;
 }
 
+void PassthroughScheduler::childForkReturn() {
+  Parent::childForkReturn();
+  waitq.clear();
+  for(int i=0; i<MAX_THREAD_NUM; ++i) {
+    waits[i].waiting = false;
+    pthread_cond_init(&waits[i].cond, NULL);
+  }
+}
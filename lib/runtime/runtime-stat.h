@@ -31,6 +31,7 @@ public:
   long nLineupTimeout; /* Number of lineup timeouts. */
   long nNonDetRegions;  /* Number of times all threads entering the non-det regions (and exiting the regions must be the same value). */
   long nNonDetPthreadSync; /* Number of non-det pthread sync operations called within a non-det region. */
+  long nAcceptBatched; /* Number of connections drained by a batching acceptor and handed out without a block/wakeup cycle. */
   
 public:
   RuntimeStat() {
@@ -40,12 +41,13 @@ public:
     nLineupTimeout = 0;
     nNonDetRegions = 0;
     nNonDetPthreadSync = 0;    
+    nAcceptBatched = 0;
   }
   void print() {
     std::cout << "\n\nRuntimeStat:\n"
-      << "nDetPthreadSyncOp\t" << "nInterProcSyncOp\t" << "nLineupSucc\t" << "nLineupTimeout\t" << "nNonDetRegions\t" << "nNonDetPthreadSync\t" << "\n"    
+      << "nDetPthreadSyncOp\t" << "nInterProcSyncOp\t" << "nLineupSucc\t" << "nLineupTimeout\t" << "nNonDetRegions\t" << "nNonDetPthreadSync\t" << "nAcceptBatched\t" << "\n"    
       << "RUNTIME_STAT: "
-      << nDetPthreadSyncOp << "\t" << nInterProcSyncOp << "\t" << nLineupSucc << "\t" << nLineupTimeout << "\t" << nNonDetRegions << "\t" << nNonDetPthreadSync
+      << nDetPthreadSyncOp << "\t" << nInterProcSyncOp << "\t" << nLineupSucc << "\t" << nLineupTimeout << "\t" << nNonDetRegions << "\t" << nNonDetPthreadSync << "\t" << nAcceptBatched
       << "\n\n" << std::flush;
   }
 
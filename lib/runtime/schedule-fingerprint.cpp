@@ -0,0 +1,129 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <tr1/unordered_map>
+#include "tern/options.h"
+#include "tern/syncfuncs.h"
+#include "tern/runtime/schedule-fingerprint.h"
+
+using namespace std;
+
+namespace tern {
+
+typedef tr1::unordered_map<uint64_t, uint64_t> canon_map_t;
+
+// only touched with the turn held
+static canon_map_t canon_ids;
+static uint64_t next_canon_id = 1;
+static FILE *checkpoint_file = NULL;
+static pid_t checkpoint_pid = 0;
+
+uint64_t ScheduleFingerprint::hash = 0;
+uint64_t ScheduleFingerprint::nops = 0;
+
+// the splitmix64 finalizer; cheap and every input bit reaches every
+// output bit, so swapping two ops changes the result
+static inline uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static bool ends_lifetime(unsigned short op) {
+  return op == syncfunc::pthread_join
+    || op == syncfunc::pthread_rwlock_destroy
+    || op == syncfunc::pthread_barrier_destroy;
+}
+
+static uint64_t canonicalize(unsigned short op, uint64_t obj) {
+  if (!syncfunc::isSync(op))
+    return 0;
+  canon_map_t::iterator it = canon_ids.find(obj);
+  uint64_t id;
+  if (it == canon_ids.end()) {
+    id = next_canon_id ++;
+    if (!ends_lifetime(op))
+      canon_ids[obj] = id;
+  } else {
+    id = it->second;
+    // a later object at the same address must not reuse this id
+    if (ends_lifetime(op))
+      canon_ids.erase(it);
+  }
+  return id;
+}
+
+static void checkpoint(uint64_t turn) {
+  if (!checkpoint_file || checkpoint_pid != getpid()) {
+    char path[1024];
+    mkdir(options::output_dir.c_str(), 0777);
+    snprintf(path, sizeof(path), "%s/fingerprint-%d.txt",
+             options::output_dir.c_str(), (int)getpid());
+    checkpoint_file = fopen(path, "w");
+    checkpoint_pid = getpid();
+    if (!checkpoint_file) {
+      perror(path);
+      options::schedule_fingerprint_interval = 0;
+      return;
+    }
+  }
+  fprintf(checkpoint_file, "turn %llu ops %llu fingerprint %016llx\n",
+          (unsigned long long)turn,
+          (unsigned long long)ScheduleFingerprint::nops,
+          (unsigned long long)ScheduleFingerprint::hash);
+  fflush(checkpoint_file);
+}
+
+void ScheduleFingerprint::update(uint64_t turn, int tid, unsigned short op,
+                                 uint64_t obj) {
+  uint64_t id = canonicalize(op, obj);
+  // rotate rather than shift so turns past 2^32 still count, while
+  // fingerprints of shorter runs stay what they were
+  uint64_t h = mix64(((turn << 32) | (turn >> 32))
+                     ^ ((uint64_t)(unsigned)tid << 16) ^ op);
+  hash = mix64(hash ^ h ^ mix64(id));
+  ++ nops;
+  if (options::schedule_fingerprint_interval > 0
+      && turn % options::schedule_fingerprint_interval == 0)
+    checkpoint(turn);
+}
+
+void ScheduleFingerprint::reset(void) {
+  canon_ids.clear();
+  next_canon_id = 1;
+  hash = 0;
+  nops = 0;
+}
+
+void ScheduleFingerprint::progEnd(void) {
+  fprintf(stderr, "xtern schedule fingerprint: %016llx (%llu ops, %llu objects)\n",
+          (unsigned long long)hash, (unsigned long long)nops,
+          (unsigned long long)(next_canon_id - 1));
+  if (checkpoint_file && checkpoint_pid == getpid())
+    fprintf(checkpoint_file, "end ops %llu fingerprint %016llx\n",
+            (unsigned long long)nops, (unsigned long long)hash);
+}
+
+}
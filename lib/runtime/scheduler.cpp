@@ -53,13 +53,15 @@ Serializer::Serializer():
   }
 }
 
-unsigned Serializer::incTurnCount(void) { 
-  int ret = turnCount++;  
+const uint64_t Serializer::FOREVER;
+
+uint64_t Serializer::incTurnCount(void) { 
+  uint64_t ret = turnCount++;  
   if (options::log_sync)
-    fprintf(logger, "%d %d\n", (int) self(), ret);
+    fprintf(logger, "%d %llu\n", (int) self(), (unsigned long long)ret);
   return ret;
 }
 
-unsigned Serializer::getTurnCount(void) { 
+uint64_t Serializer::getTurnCount(void) { 
   return turnCount - 1; 
 }
@@ -0,0 +1,88 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <stdio.h>
+#include <time.h>
+#include "tern/runtime/tsc-clock.h"
+
+namespace tern {
+
+bool     TscClock::use_tsc = false;
+bool     TscClock::inited = false;
+uint64_t TscClock::mult = 0;
+unsigned TscClock::shift = 24;
+
+static void cpuid(unsigned leaf, unsigned &a, unsigned &b,
+                  unsigned &c, unsigned &d) {
+#if defined(__i386__) || defined(__x86_64__)
+  __asm__ __volatile__ ("cpuid"
+                        : "=a"(a), "=b"(b), "=c"(c), "=d"(d) : "a"(leaf), "c"(0));
+#else
+  a = b = c = d = 0;
+#endif
+}
+
+/// invariant TSC (ticks at a constant rate in all C/P states) and rdtscp
+static bool have_invariant_tsc(void) {
+  unsigned a, b, c, d;
+  cpuid(0x80000000, a, b, c, d);
+  if (a < 0x80000007)
+    return false;
+  cpuid(0x80000001, a, b, c, d);
+  if (!(d & (1U << 27)))      // rdtscp
+    return false;
+  cpuid(0x80000007, a, b, c, d);
+  return d & (1U << 8);       // invariant TSC
+}
+
+void TscClock::init(bool force_fallback) {
+  if (inited && !force_fallback)
+    return;
+  inited = !force_fallback; // a later init() picks the TSC again
+  use_tsc = false;
+  if (force_fallback || !have_invariant_tsc())
+    return;
+
+  // Calibrate over ~20ms of CLOCK_MONOTONIC_RAW, which is not slewed by
+  // NTP.  Take the best of a few rounds so that a preemption in between
+  // two reads does not skew the ratio.
+  double best = 0;
+  uint64_t best_err = ~0ULL;
+  for (int round = 0; round < 3; ++round) {
+    uint64_t t0 = monotonicRaw(), c0 = readTsc(), t0b = monotonicRaw();
+    struct timespec ts = {0, 20000000};
+    nanosleep(&ts, NULL);
+    uint64_t t1 = monotonicRaw(), c1 = readTsc(), t1b = monotonicRaw();
+    uint64_t err = (t0b - t0) + (t1b - t1);
+    if (c1 <= c0 || t1 <= t0)
+      continue;
+    if (err < best_err) {
+      best_err = err;
+      best = (double)((t1 + t1b) / 2 - (t0 + t0b) / 2) / (double)(c1 - c0);
+    }
+  }
+  if (best <= 0) {
+    fprintf(stderr, "TscClock: calibration failed, using CLOCK_MONOTONIC_RAW\n");
+    return;
+  }
+  mult = (uint64_t)(best * (double)(1ULL << shift) + 0.5);
+  use_tsc = true;
+}
+
+}
@@ -0,0 +1,178 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "tern/options.h"
+#include "tern/syncfuncs.h"
+#include "tern/runtime/turn-hog.h"
+#include "tern/runtime/tsc-clock.h"
+
+using namespace std;
+
+namespace tern {
+
+enum {
+  HOG_MAX_REGIONS = 4096,   // the last slot collects the rest
+  HOG_TOP         = 50
+};
+
+struct hog_region {
+  unsigned short from_op, to_op; /// to_op == 0: slot unused
+  unsigned from_ins, to_ins;
+  uint64_t count;
+  uint64_t stall_ns;         /// turn idle, waiting for this region
+  uint64_t blocked_ns;       /// stall_ns weighted by # of queued threads
+  uint64_t max_stall_ns;
+  uint64_t in_op_blocked_ns; /// turn held in to_op, weighted likewise
+};
+
+// only touched with the turn held
+static hog_region hog_regions[HOG_MAX_REGIONS];
+static __thread unsigned short hog_last_op = 0;
+static __thread unsigned hog_last_ins = 0;
+static __thread uint64_t hog_in_op_ns = 0; /// before yield()s in this op
+
+volatile int TurnHogProfiler::nwaiting = 0;
+volatile uint64_t TurnHogProfiler::last_release_ns = 0;
+
+uint64_t TurnHogProfiler::grant(uint64_t arrive_ns, uint64_t grant_ns,
+                                unsigned &waiters) {
+  int others = __sync_sub_and_fetch(&nwaiting, 1);
+  waiters = others > 0 ? others : 0;
+  // the turn was free from the last release until we showed up; if we
+  // were already waiting, someone else held the turn and it is theirs.
+  uint64_t rel = last_release_ns;
+  if (rel == 0 || arrive_ns <= rel)
+    return 0;
+  return arrive_ns - rel;
+}
+
+static hog_region *find_region(unsigned short from_op, unsigned from_ins,
+                               unsigned short to_op, unsigned to_ins) {
+  unsigned h = (from_ins * 2654435761U) ^ (to_ins * 40503U)
+    ^ ((unsigned)from_op << 16) ^ to_op;
+  h %= HOG_MAX_REGIONS - 1;
+  for (unsigned i = 0; i < HOG_MAX_REGIONS - 1; ++i) {
+    hog_region *r = &hog_regions[(h + i) % (HOG_MAX_REGIONS - 1)];
+    if (r->to_op == 0) {
+      r->from_op = from_op;
+      r->from_ins = from_ins;
+      r->to_op = to_op;
+      r->to_ins = to_ins;
+      return r;
+    }
+    if (r->from_op == from_op && r->from_ins == from_ins
+        && r->to_op == to_op && r->to_ins == to_ins)
+      return r;
+  }
+  return &hog_regions[HOG_MAX_REGIONS - 1];
+}
+
+void TurnHogProfiler::release(unsigned short op, unsigned insid,
+                              uint64_t stall_ns, unsigned waiters,
+                              uint64_t grant_ns) {
+  uint64_t now = TscClock::now();
+  hog_region *r = find_region(hog_last_op, hog_last_ins, op, insid);
+  ++ r->count;
+  r->stall_ns += stall_ns;
+  r->blocked_ns += stall_ns * waiters;
+  if (stall_ns > r->max_stall_ns)
+    r->max_stall_ns = stall_ns;
+  r->in_op_blocked_ns += hog_in_op_ns;
+  hog_in_op_ns = 0;
+  if (grant_ns && now > grant_ns) {
+    int queued = nwaiting;
+    if (queued > 0)
+      r->in_op_blocked_ns += (now - grant_ns) * queued;
+  }
+  hog_last_op = op;
+  hog_last_ins = insid;
+  last_release_ns = now;
+}
+
+void TurnHogProfiler::yield(uint64_t grant_ns) {
+  uint64_t now = TscClock::now();
+  if (grant_ns && now > grant_ns) {
+    int queued = nwaiting;
+    if (queued > 0)
+      hog_in_op_ns += (now - grant_ns) * queued;
+  }
+  // the turn is free from here; whoever gets it next did not stall it
+  last_release_ns = now;
+}
+
+static const char *op_name(unsigned short op) {
+  if (op == 0)
+    return "thread_start";
+  if (op >= syncfunc::first_sync && op < syncfunc::num_syncs)
+    return syncfunc::getName(op);
+  return "other";
+}
+
+static bool more_blocked(const hog_region *a, const hog_region *b) {
+  return a->blocked_ns + a->in_op_blocked_ns
+    > b->blocked_ns + b->in_op_blocked_ns;
+}
+
+void TurnHogProfiler::dump(void) {
+  vector<hog_region*> regions;
+  for (unsigned i = 0; i < HOG_MAX_REGIONS; ++i)
+    if (hog_regions[i].count)
+      regions.push_back(&hog_regions[i]);
+  if (regions.empty())
+    return;
+  sort(regions.begin(), regions.end(), more_blocked);
+
+  char path[1024];
+  mkdir(options::output_dir.c_str(), 0777);
+  snprintf(path, sizeof(path), "%s/turn-hogs-%d.txt",
+           options::output_dir.c_str(), (int)getpid());
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    perror(path);
+    return;
+  }
+  fprintf(f, "# regions that ran between two sync ops while other threads "
+          "queued for the turn,\n# by thread-time blocked (ms)\n");
+  fprintf(f, "%-4s %12s %12s %10s %10s %10s  %s\n", "rank", "blocked_ms",
+          "in_op_ms", "stall_ms", "max_us", "count", "region");
+  for (size_t i = 0; i < regions.size() && i < HOG_TOP; ++i) {
+    const hog_region *r = regions[i];
+    if (r == &hog_regions[HOG_MAX_REGIONS - 1])
+      fprintf(f, "%-4u %12.3f %12.3f %10.3f %10.1f %10llu  (other regions)\n",
+              (unsigned)i + 1, r->blocked_ns / 1e6, r->in_op_blocked_ns / 1e6,
+              r->stall_ns / 1e6, r->max_stall_ns / 1e3,
+              (unsigned long long)r->count);
+    else
+      fprintf(f, "%-4u %12.3f %12.3f %10.3f %10.1f %10llu  %s@0x%x -> %s@0x%x\n",
+              (unsigned)i + 1, r->blocked_ns / 1e6, r->in_op_blocked_ns / 1e6,
+              r->stall_ns / 1e6, r->max_stall_ns / 1e3,
+              (unsigned long long)r->count,
+              op_name(r->from_op), r->from_ins, op_name(r->to_op), r->to_ins);
+  }
+  fclose(f);
+}
+
+}
@@ -0,0 +1,198 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime" -nondet -options accept_batching=1:accept_batch_size=4
+// RUN: env ACCEPT_TEST=poll %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime" -nondet -options accept_batching=1:accept_batch_size=4
+// RUN: env ACCEPT_TEST=backlog %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime" -nondet -options accept_batching=1:accept_batch_size=4:record_runtime_stat=1 -prefix STAT
+
+// Several server threads accept() on one listening socket while clients
+// connect, so the batching acceptor drains the backlog and hands the
+// connections out to the other server threads.  $ACCEPT_TEST picks how:
+//
+//   (unset)  the servers call accept() and a burst of clients connects.
+//   poll     an event-driven server: the listening socket is O_NONBLOCK
+//            and the servers poll() it before accept(), retrying on
+//            EAGAIN.  Batching must never pull a connection out of the
+//            kernel backlog that no accept() caller is waiting for, or
+//            poll() would not report it and the client would hang.
+//   backlog  the clients connect before any server calls accept(), and
+//            the servers line up on a barrier first, so while the
+//            acceptor is in the kernel the others are parked on the
+//            socket and it has to drain connections for them
+//            (nAcceptBatched, the last RUNTIME_STAT column, is not 0).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <semaphore.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+
+#define NSERVER (4)
+#define NCLIENT (16)
+
+void error(const char *msg)
+{
+    perror(msg);
+    exit(1);
+}
+
+int listenfd;
+int portno;
+int nserved = 0;
+bool use_poll = false;
+bool backlog = false;
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_barrier_t bar;
+sem_t connected;
+
+int served()
+{
+    pthread_mutex_lock(&mutex);
+    int n = nserved;
+    pthread_mutex_unlock(&mutex);
+    return n;
+}
+
+void serve(int fd)
+{
+    // accept() does not inherit O_NONBLOCK from the listener on Linux.
+    char c;
+    if (read(fd, &c, 1) != 1)
+      error("ERROR reading from socket");
+    if (write(fd, &c, 1) != 1)
+      error("ERROR writing to socket");
+    close(fd);
+    pthread_mutex_lock(&mutex);
+    nserved++;
+    pthread_mutex_unlock(&mutex);
+}
+
+void *server_thread(void *arg)
+{
+    if (backlog)
+      pthread_barrier_wait(&bar);
+    if (!use_poll) {
+      for (int i = 0; i < NCLIENT/NSERVER; ++i) {
+        int fd = accept(listenfd, NULL, NULL);
+        if (fd < 0)
+          error("ERROR on accept");
+        serve(fd);
+      }
+      return 0;
+    }
+    while (served() < NCLIENT) {
+      struct pollfd pfd;
+      pfd.fd = listenfd;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      if (poll(&pfd, 1, 100) <= 0)
+        continue;
+      int fd = accept(listenfd, NULL, NULL);
+      if (fd < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+          continue;
+        error("ERROR on accept");
+      }
+      serve(fd);
+    }
+    return 0;
+}
+
+void *client_thread(void *arg)
+{
+    struct sockaddr_in serv_addr;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+      error("ERROR opening socket");
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    serv_addr.sin_port = htons(portno);
+    if (connect(fd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0)
+      error("ERROR connecting");
+    char c = 'x';
+    if (write(fd, &c, 1) != 1)
+      error("ERROR writing to socket");
+    sem_post(&connected);
+    if (read(fd, &c, 1) != 1 || c != 'x')
+      error("ERROR reading from socket");
+    close(fd);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+     struct sockaddr_in serv_addr;
+     pthread_t servers[NSERVER], clients[NCLIENT];
+     int optval = 1;
+     const char *mode = getenv("ACCEPT_TEST");
+
+     use_poll = mode && !strcmp(mode, "poll");
+     backlog = mode && !strcmp(mode, "backlog");
+     srand(time(NULL));
+     portno = 20000 + rand()%1000;
+     listenfd = socket(AF_INET, SOCK_STREAM, 0);
+     if (listenfd < 0)
+        error("ERROR opening socket");
+     setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof optval);
+     memset(&serv_addr, 0, sizeof(serv_addr));
+     serv_addr.sin_family = AF_INET;
+     serv_addr.sin_addr.s_addr = INADDR_ANY;
+     serv_addr.sin_port = htons(portno);
+     if (bind(listenfd, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) < 0)
+       error("ERROR on binding");
+     listen(listenfd, NCLIENT);
+     if (use_poll)
+       fcntl(listenfd, F_SETFL, fcntl(listenfd, F_GETFL) | O_NONBLOCK);
+     sem_init(&connected, 0, 0);
+     pthread_barrier_init(&bar, NULL, NSERVER);
+
+     if (!backlog)
+       for (int i = 0; i < NSERVER; ++i)
+         pthread_create(&servers[i], NULL, server_thread, NULL);
+     for (int i = 0; i < NCLIENT; ++i)
+       pthread_create(&clients[i], NULL, client_thread, NULL);
+     if (backlog) {
+       for (int i = 0; i < NCLIENT; ++i)
+         sem_wait(&connected);
+       for (int i = 0; i < NSERVER; ++i)
+         pthread_create(&servers[i], NULL, server_thread, NULL);
+     }
+     for (int i = 0; i < NCLIENT; ++i)
+       pthread_join(clients[i], NULL);
+     for (int i = 0; i < NSERVER; ++i)
+       pthread_join(servers[i], NULL);
+     close(listenfd);
+     printf("served %d connections\n", nserved);
+     printf("test done\n");
+     return 0;
+}
+// CHECK indicates expected output checked by FileCheck; auto-generated by appending -gen to the RUN command above.
+// CHECK:      served 16 connections
+// CHECK-NEXT: test done
+// STAT:       served 16 connections
+// STAT-NEXT:  test done
+// STAT:       RUNTIME_STAT: {{[0-9]+.[0-9]+.[0-9]+.[0-9]+.[0-9]+.[0-9]+.[1-9][0-9]*$}}
@@ -0,0 +1,65 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime" -options log_type=async:async_log_ring_size=16
+
+// Many short critical sections with a tiny per-thread ring, so logging
+// threads keep running into a full ring and wait for the writer thread.
+// The fork in the middle exercises the child-side reset of the log.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#define NTHREADS 4
+#define NITERS 1000
+
+pthread_mutex_t mu = PTHREAD_MUTEX_INITIALIZER;
+int counter = 0;
+
+void *thread_func(void *arg) {
+  for (int i = 0; i < NITERS; ++i) {
+    pthread_mutex_lock(&mu);
+    ++ counter;
+    pthread_mutex_unlock(&mu);
+  }
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  pthread_t th[NTHREADS];
+  for (int i = 0; i < NTHREADS; ++i)
+    pthread_create(&th[i], NULL, thread_func, NULL);
+  for (int i = 0; i < NTHREADS; ++i)
+    pthread_join(th[i], NULL);
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    thread_func(NULL);
+    exit(0);
+  }
+  waitpid(pid, NULL, 0);
+
+  printf("counter %d\n", counter);
+  printf("test done\n");
+  return 0;
+}
+
+// CHECK: counter 4000
+// CHECK: test done
@@ -0,0 +1,89 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+// RUN: %srcroot/test/runtime/run-scheduler-test.py %s -gxx "%gxx" -llvmgcc "%llvmgcc" -projbindir "%projbindir" -ternruntime "%ternruntime" -ternannotlib "%ternannotlib"  -ternbcruntime "%ternbcruntime" -nondet -options dns_cache=1
+
+// Threads resolve the same names over and over; with dns_cache on, all
+// but the first lookup of each name are served from the runtime's cache
+// and every thread must see the same answer.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <pthread.h>
+
+#define NTHREAD (4)
+#define N (50)
+
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+int nresolved = 0;
+int nsame = 0;
+struct sockaddr_in first;
+bool have_first = false;
+
+void *resolver(void *arg)
+{
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  for (int i = 0; i < N; ++i) {
+    struct addrinfo *res;
+    if (getaddrinfo("localhost", "80", &hints, &res) != 0) {
+      fprintf(stderr, "getaddrinfo failed\n");
+      exit(1);
+    }
+    struct hostent *h = gethostbyname("localhost");
+    if (!h || h->h_addrtype != AF_INET) {
+      fprintf(stderr, "gethostbyname failed\n");
+      exit(1);
+    }
+    pthread_mutex_lock(&mutex);
+    nresolved++;
+    if (!have_first) {
+      memcpy(&first, res->ai_addr, sizeof(first));
+      have_first = true;
+    }
+    if (memcmp(&first, res->ai_addr, sizeof(first)) == 0)
+      nsame++;
+    pthread_mutex_unlock(&mutex);
+    freeaddrinfo(res);
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  pthread_t th[NTHREAD];
+  for (int i = 0; i < NTHREAD; ++i)
+    pthread_create(&th[i], NULL, resolver, NULL);
+  for (int i = 0; i < NTHREAD; ++i)
+    pthread_join(th[i], NULL);
+  printf("resolved %d times, %d same\n", nresolved, nsame);
+  printf("test done\n");
+  return 0;
+}
+// CHECK indicates expected output checked by FileCheck; auto-generated by appending -gen to the RUN command above.
+// CHECK:      resolved 200 times, 200 same
+// CHECK-NEXT: test done
@@ -21,9 +21,10 @@
 
 # TODO: test dynamic hook of synchronization routines
 
-# TODO: to check the determinism of the RR scheduler, perhaps just run the
-# test program a few times and check that the generated schedules are
-# identical.
+# Determinism of the RR scheduler is checked two ways: ScheduleCheck runs
+# a test program several times and diffs the normalized sync logs, and
+# FingerprintCheck runs it twice and compares the schedule fingerprints
+# (options::schedule_fingerprint).
 
 import re
 import os
@@ -52,8 +53,12 @@ parser.add_argument('-ternbcruntime', dest='ternbcruntime', required=True,
                     help='tern bc runtime')
 parser.add_argument('-nondet', dest='nondet', default=False, action='store_true',
                     help='skip checking of determinism')
+parser.add_argument('-options', dest='options', default='',
+                    help='extra TERN_OPTIONS, colon separated')
 parser.add_argument('-gen', dest='gen', default=False, action='store_true',
                     help='generate expected outputs instead of testing them')
+parser.add_argument('-prefix', dest='prefix', default='CHECK',
+                    help='FileCheck prefix of the expected output lines')
 
 def gen(cmd, prog):
     m = re.search('\|\s*FileCheck.*$', cmd)
@@ -179,6 +184,26 @@ def check_deterministic(cmd, prog):
             exit(1)
     return
 
+def run_fingerprint(cmd):
+    cmd = re.sub('(TERN_OPTIONS=\S+)', '\\1:schedule_fingerprint=1', cmd)
+    p = subprocess.Popen(cmd, stdout=open(os.devnull, 'w'),
+                         stderr=subprocess.PIPE, shell=True)
+    err = p.communicate()[1]
+    return re.findall('schedule fingerprint: .*', err)
+
+def check_fingerprint(cmd, prog):
+    # cheaper than check_deterministic: no sync log, just compare the
+    # rolling schedule fingerprint of two runs
+    fp = run_fingerprint(cmd)
+    assert len(fp) > 0, 'no schedule fingerprint printed'
+    new_fp = run_fingerprint(cmd)
+    if fp != new_fp:
+        print 'schedule fingerprints of %s differ!' % prog
+        print '\n'.join(fp)
+        print '\n'.join(new_fp)
+        exit(1)
+    print 'schedule fingerprints match (%s)' % fp[-1]
+
 def run(cmd, map):
     cmd = cmd.split('RUN:')
     if len(cmd) == 1:
@@ -188,12 +213,20 @@ def run(cmd, map):
         # print key, val
         if isinstance(val, str):
             cmd = cmd.replace('%'+key, val)
+    if args['options']:
+        cmd = re.sub('(TERN_OPTIONS=\S+)', '\\1:' + args['options'], cmd)
+    if args['prefix'] != 'CHECK':
+        cmd = cmd.replace('| FileCheck ', '| FileCheck -check-prefix=%s ' % args['prefix'])
     if args['gen'] and gen(cmd, prog):
         return
     if (not args['nondet']) and cmd.endswith('ScheduleCheck'):
         cmd = cmd.split('ScheduleCheck')[0]
         check_deterministic(cmd, prog)
         return
+    if (not args['nondet']) and cmd.endswith('FingerprintCheck'):
+        cmd = cmd.split('FingerprintCheck')[0]
+        check_fingerprint(cmd, prog)
+        return
     print 'running <%s>' % cmd
     os.system(cmd);
 
@@ -216,6 +249,7 @@ cmds = '''
 // test RR scheduler
 // RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 | FileCheck %s
 // RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 ScheduleCheck
+// RUN: env TERN_OPTIONS=dync_geteip=0:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 FingerprintCheck
 
 // test RR scheduler
 // RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:nanosec_per_turn=100000:enforce_turn_type=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 | FileCheck %s
@@ -237,6 +271,7 @@ if os.getenv('test_dync_only') != None :
 // test RR scheduler
 // RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 | FileCheck %s
 // RUN: env TERN_OPTIONS=set_mutex_errorcheck=1:dync_geteip=0:log_type=test:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=1:log_sync=1:dync_geteip=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 ScheduleCheck
+// RUN: env TERN_OPTIONS=dync_geteip=0:exec_sleep=0:output_dir=%t2.outdir:enforce_turn_type=1  LD_PRELOAD=$XTERN_ROOT/dync_hook/interpose.so  ./%t4 FingerprintCheck
 '''
 
 for cmd in cmds.splitlines():
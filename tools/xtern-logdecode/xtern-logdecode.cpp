@@ -0,0 +1,129 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+// Decodes compact sync logs (log_type = compact) back into the text
+// format TxtLogger writes, so the eval scripts work on them unchanged.
+//
+// Usage: xtern-logdecode [-o <dir>] [-q] tid-N.cmp ...
+//   -o <dir>  write tid-N.txt to <dir> (default: next to each input)
+//   -q        only print the statistics
+//
+// For each input, prints the # of records, bytes per record, the
+// compression ratio against the fixed 32-byte bin records and against the
+// text log, and the decode time per record.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include "tern/runtime/compact-log.h"
+
+using namespace std;
+using namespace tern;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static string output_file(const char *in, const char *outdir) {
+  string path(in), base(in), dir(".");
+  size_t slash = path.rfind('/');
+  if (slash != string::npos) {
+    dir = path.substr(0, slash);
+    base = path.substr(slash + 1);
+  }
+  if (outdir)
+    dir = outdir;
+  size_t dot = base.rfind('.');
+  if (dot != string::npos)
+    base = base.substr(0, dot);
+  return dir + "/" + base + ".txt";
+}
+
+static int decode(const char *in, const char *outdir, bool quiet) {
+  CompactLogDecoder dec;
+  if (!dec.open(in)) {
+    fprintf(stderr, "%s: not a compact sync log\n", in);
+    return -1;
+  }
+
+  FILE *out = NULL;
+  if (!quiet) {
+    string file = output_file(in, outdir);
+    out = fopen(file.c_str(), "w");
+    if (!out) {
+      perror(file.c_str());
+      return -1;
+    }
+    fprintf(out, "op insid turn app_time syscall_time sched_time tid args\n");
+  }
+
+  AsyncSyncRec rec;
+  uint64_t nrecs = 0;
+  uint64_t start = now_ns();
+  // decode once without printing so the time excludes stdio
+  while (dec.next(rec))
+    ++ nrecs;
+  uint64_t elapsed = now_ns() - start;
+
+  if (out) {
+    CompactLogDecoder again;
+    again.open(in);
+    while (again.next(rec))
+      CompactLogDecoder::print(out, rec);
+    long txt = ftell(out);
+    fclose(out);
+    fprintf(stderr, "%s: text log %ld bytes, %.2fx vs txt\n", in, txt,
+            dec.size() ? (double)txt / dec.size() : 0.0);
+  }
+
+  fprintf(stderr, "%s: %llu records, %lu bytes, %.2f bytes/record, "
+          "%.2fx vs bin, decode %.1f ns/record\n", in,
+          (unsigned long long)nrecs, (unsigned long)dec.size(),
+          nrecs ? (double)dec.size() / nrecs : 0.0,
+          dec.size() ? (double)nrecs * RECORD_SIZE / dec.size() : 0.0,
+          nrecs ? (double)elapsed / nrecs : 0.0);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  const char *outdir = NULL;
+  bool quiet = false;
+  int i, ret = 0;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+    if (!strcmp(argv[i], "-o") && i + 1 < argc)
+      outdir = argv[++i];
+    else if (!strcmp(argv[i], "-q"))
+      quiet = true;
+    else
+      break;
+  }
+  if (i == argc) {
+    fprintf(stderr, "Usage: %s [-o <dir>] [-q] tid-N.cmp ...\n", argv[0]);
+    return 1;
+  }
+  for (; i < argc; ++i)
+    if (decode(argv[i], outdir, quiet) < 0)
+      ret = 1;
+  return ret;
+}
@@ -0,0 +1,187 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+// Shows the live statistics that a process running with live_stat=1
+// publishes in /xtern-stat-<pid>: per-thread rates and the sync objects
+// threads spent the most time waiting on.
+//
+// Usage: xtern-top [-b] [-d <seconds>] [-n <iterations>] <pid>
+//   -b  batch mode: append reports instead of redrawing the screen
+//   -d  refresh interval, default 1 second
+//   -n  exit after this many reports
+
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "tern/runtime/live-stat.h"
+
+using namespace std;
+using namespace tern;
+
+struct obj_delta {
+  uint64_t addr, waits, wait_ns;
+  bool operator<(const obj_delta &o) const { return wait_ns > o.wait_ns; }
+};
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static LiveStatShm *attach(pid_t pid) {
+  char name[64];
+  getLiveStatName(name, sizeof(name), pid);
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) {
+    fprintf(stderr, "can't open %s: %s (is the process running with "
+            "live_stat=1?)\n", name, strerror(errno));
+    return NULL;
+  }
+  void *p = mmap(0, sizeof(LiveStatShm), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    perror("mmap");
+    return NULL;
+  }
+  LiveStatShm *s = (LiveStatShm*)p;
+  if (strncmp(s->magic, LIVE_STAT_MAGIC, sizeof(s->magic))
+      || s->version != LIVE_STAT_VERSION) {
+    fprintf(stderr, "%s: unknown format\n", name);
+    munmap(p, sizeof(LiveStatShm));
+    return NULL;
+  }
+  return s;
+}
+
+static void report(const LiveStatShm *cur, const LiveStatShm *prev,
+                   double secs, bool batch) {
+  if (!batch)
+    printf("\033[H\033[2J");
+  double up = (now_ns() - cur->start_ns) / 1e9;
+  printf("xtern-top: pid %d, up %.1fs, turn %llu (%.0f/s), %d threads\n\n",
+         cur->pid, up, (unsigned long long)cur->turn,
+         (cur->turn - prev->turn) / secs, cur->nthreads);
+  printf("%5s %10s %6s %10s %9s %9s %9s %9s %8s %9s\n",
+         "TID", "TURNS/s", "WAIT%", "WAITms/s", "BLOCK/s", "WAKEUP/s",
+         "LINEUPok", "LINEUPto", "NONDET", "IDLE/s");
+
+  int n = cur->nthreads;
+  if (n > LIVE_STAT_MAX_THREADS)
+    n = LIVE_STAT_MAX_THREADS;
+  for (int i = 0; i < n; ++i) {
+    const LiveThreadStat &c = cur->threads[i], &p = prev->threads[i];
+    if (c.turns == 0 && c.idle_turns == 0 && c.block_ops == 0)
+      continue;
+    double wait_ms = (c.turn_wait_ns - p.turn_wait_ns) / 1e6 / secs;
+    printf("%5d %10.0f %5.1f%% %10.2f %9.0f %9.0f %9llu %9llu %8llu %9.0f\n",
+           i, (c.turns - p.turns) / secs, wait_ms / 10.0, wait_ms,
+           (c.block_ops - p.block_ops) / secs, (c.wakeups - p.wakeups) / secs,
+           (unsigned long long)c.lineup_succ,
+           (unsigned long long)c.lineup_timeout,
+           (unsigned long long)c.nondet_entries,
+           (c.idle_turns - p.idle_turns) / secs);
+  }
+
+  vector<obj_delta> objs;
+  for (int i = 0; i < LIVE_STAT_MAX_OBJS; ++i) {
+    const LiveObjStat &c = cur->objs[i], &p = prev->objs[i];
+    if (!c.addr)
+      continue;
+    obj_delta d;
+    d.addr = c.addr;
+    d.waits = c.waits - (p.addr == c.addr ? p.waits : 0);
+    d.wait_ns = c.wait_ns - (p.addr == c.addr ? p.wait_ns : 0);
+    if (d.waits)
+      objs.push_back(d);
+  }
+  sort(objs.begin(), objs.end());
+  printf("\nmost waited sync objects:\n%18s %10s %12s\n",
+         "OBJECT", "WAITS/s", "WAITms/s");
+  for (size_t i = 0; i < objs.size() && i < 10; ++i)
+    printf("%18p %10.0f %12.2f\n", (void*)(uintptr_t)objs[i].addr,
+           objs[i].waits / secs, objs[i].wait_ns / 1e6 / secs);
+  if (cur->obj_overflow_ns != prev->obj_overflow_ns)
+    printf("%18s %10s %12.2f\n", "(other)", "",
+           (cur->obj_overflow_ns - prev->obj_overflow_ns) / 1e6 / secs);
+  printf("\n");
+  fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+  bool batch = false;
+  double interval = 1.0;
+  long iterations = -1;
+  int c;
+
+  while ((c = getopt(argc, argv, "bd:n:")) != -1) {
+    switch (c) {
+    case 'b': batch = true; break;
+    case 'd': interval = atof(optarg); break;
+    case 'n': iterations = atol(optarg); break;
+    default:
+      fprintf(stderr, "Usage: %s [-b] [-d <seconds>] [-n <iterations>] <pid>\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (optind >= argc || interval <= 0) {
+    fprintf(stderr, "Usage: %s [-b] [-d <seconds>] [-n <iterations>] <pid>\n",
+            argv[0]);
+    return 1;
+  }
+  pid_t pid = atoi(argv[optind]);
+  LiveStatShm *shm = attach(pid);
+  if (!shm)
+    return 1;
+
+  // the counters keep moving while we copy; that only blurs one interval
+  LiveStatShm *prev = (LiveStatShm*)malloc(sizeof(LiveStatShm));
+  LiveStatShm *cur = (LiveStatShm*)malloc(sizeof(LiveStatShm));
+  memcpy(prev, shm, sizeof(LiveStatShm));
+  uint64_t last = now_ns();
+
+  while (iterations != 0) {
+    usleep((useconds_t)(interval * 1000000));
+    if (kill(pid, 0) < 0 && errno == ESRCH) {
+      printf("process %d exited\n", pid);
+      break;
+    }
+    memcpy(cur, shm, sizeof(LiveStatShm));
+    uint64_t now = now_ns();
+    report(cur, prev, (now - last) / 1e9, batch);
+    swap(cur, prev);
+    last = now;
+    if (iterations > 0)
+      -- iterations;
+  }
+  munmap(shm, sizeof(LiveStatShm));
+  free(prev);
+  free(cur);
+  return 0;
+}
@@ -0,0 +1,546 @@
+/* Copyright (c) 2013,  Regents of the Columbia University 
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other 
+ * materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR 
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Exports a recorded schedule as Chrome trace-event JSON, for
+// chrome://tracing or ui.perfetto.dev.
+//
+// Usage: xtern-trace [-o trace.json] [-r pself-pid-N.txt] [-g ghz] [-i] <out dir>
+//   -o <file>  output (default: trace.json)
+//   -r <file>  also merge this rdtsc dump (record_rdtsc = 1)
+//   -g <ghz>   TSC rate for -r (default: from /proc/cpuinfo)
+//   -i         keep the idle thread
+//
+// Reads the text sync logs (tid-N.txt or tid-PID-N.txt; convert compact
+// and async logs first with xtern-logdecode or sync-log-to-txt.py).  Each
+// xtern thread gets four tracks: app (time between sync ops), turn-wait
+// (waiting in getTurn), sync-op (the op itself, holding the turn) and
+// blocked (blocking syscalls and the wait between the two records of
+// cond_wait, barrier_wait, ...).  Flow arrows go from every putTurn to
+// the getTurn of the next turn when the turn changes threads, and from
+// signal/broadcast, unlock, post and the last barrier arrival to the
+// thread they wake up.  With -r, the rdtsc spans of each thread get a
+// fifth track.
+//
+// The logged times are per-thread deltas, and the first delta of every
+// thread is zeroed by threadBegin, so each thread is placed on the
+// global time line at the end of the turn just before its first one,
+// the way draw-time-chart.pl does.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "tern/syncfuncs.h"
+
+using namespace std;
+using namespace tern;
+
+enum { TRACK_APP, TRACK_WAIT, TRACK_OP, TRACK_BLOCKED, TRACK_RDTSC,
+       NUM_TRACKS };
+static const char *track_names[] = {"app", "turn-wait", "sync-op",
+                                    "blocked", "rdtsc"};
+
+struct Record {
+  string op;            // as logged, with _first/_second
+  string base;          // without the suffix
+  unsigned sync;
+  bool first, second;
+  unsigned insid;
+  uint64_t turn;
+  int64_t app, syscall, sched;   // ns deltas as logged
+  int tid;
+  vector<uint64_t> args;
+  int64_t enter, got, done;      // absolute ns, set by align()
+  int op_track;
+};
+
+struct Thread {
+  int pid, tid;
+  vector<Record> recs;
+  int64_t offset;
+  bool aligned;
+};
+
+/// all threads of one process, keyed by tern tid
+typedef map<int, Thread> Process;
+
+static map<int, Process> procs;   // by pid (0 if not in the file name)
+
+static int64_t parse_time(const char *s) {
+  char *end;
+  int64_t sec = strtoll(s, &end, 10);
+  if (*end != ':')
+    return 0;
+  return sec * 1000000000LL + strtoll(end + 1, NULL, 10);
+}
+
+static bool ends_with(const string &s, const char *suffix) {
+  size_t n = strlen(suffix);
+  return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+static bool parse_file(const string &path, int pid, int tid) {
+  FILE *f = fopen(path.c_str(), "r");
+  if (!f) {
+    perror(path.c_str());
+    return false;
+  }
+  Thread &t = procs[pid][tid];
+  t.pid = pid;
+  t.tid = tid;
+  t.offset = 0;
+  t.aligned = false;
+  char line[4096];
+  while (fgets(line, sizeof(line), f)) {
+    if (!strncmp(line, "op ", 3))
+      continue;
+    vector<char *> fields;
+    for (char *s = strtok(line, " \n"); s; s = strtok(NULL, " \n"))
+      fields.push_back(s);
+    if (fields.size() < 7)
+      continue;
+    Record r;
+    r.op = fields[0];
+    r.first = ends_with(r.op, "_first");
+    r.second = ends_with(r.op, "_second");
+    r.base = r.op.substr(0, r.op.size() - (r.first ? 6 : r.second ? 7 : 0));
+    r.sync = syncfunc::getNameID(r.base.c_str());
+    r.insid = strtoul(fields[1], NULL, 16);
+    r.turn = strtoull(fields[2], NULL, 10);
+    r.app = parse_time(fields[3]);
+    r.syscall = parse_time(fields[4]);
+    r.sched = parse_time(fields[5]);
+    r.tid = atoi(fields[6]);
+    for (size_t i = 7; i < fields.size(); ++i)
+      r.args.push_back(strtoull(fields[i], NULL, 16));
+    r.enter = r.got = r.done = 0;
+    r.op_track = TRACK_OP;
+    if (r.sync != syncfunc::not_sync
+        && syncfunc::kind[r.sync] == syncfunc::BlockingSyscall)
+      r.op_track = TRACK_BLOCKED;
+    t.recs.push_back(r);
+  }
+  fclose(f);
+  return true;
+}
+
+/// tid-N.txt or tid-PID-N.txt
+static int read_logs(const char *dir, bool keep_idle) {
+  DIR *d = opendir(dir);
+  if (!d) {
+    perror(dir);
+    return -1;
+  }
+  int nfiles = 0;
+  struct dirent *e;
+  while ((e = readdir(d))) {
+    string name = e->d_name;
+    if (name.compare(0, 4, "tid-") || !ends_with(name, ".txt"))
+      continue;
+    int a, b, pid = 0, tid;
+    if (sscanf(name.c_str(), "tid-%d-%d.txt", &a, &b) == 2) {
+      pid = a;
+      tid = b;
+    } else if (sscanf(name.c_str(), "tid-%d.txt", &a) == 1) {
+      tid = a;
+    } else
+      continue;
+    if (tid == 1 && !keep_idle)
+      continue;
+    if (parse_file(string(dir) + "/" + name, pid, tid))
+      ++ nfiles;
+  }
+  closedir(d);
+  return nfiles;
+}
+
+/// turn the per-thread deltas into one time line per process
+static void align(Process &proc) {
+  map<uint64_t, Record *> by_turn;
+  vector<pair<uint64_t, Thread *> > order;
+  for (Process::iterator it = proc.begin(); it != proc.end(); ++it) {
+    Thread &t = it->second;
+    int64_t now = 0;
+    for (size_t i = 0; i < t.recs.size(); ++i) {
+      Record &r = t.recs[i];
+      r.enter = now + r.app;
+      r.got = r.enter + r.sched;
+      r.done = r.got + r.syscall;
+      now = r.done;
+    }
+    if (!t.recs.empty())
+      order.push_back(make_pair(t.recs[0].turn, &t));
+  }
+  sort(order.begin(), order.end());
+
+  for (size_t i = 0; i < order.size(); ++i) {
+    Thread &t = *order[i].second;
+    uint64_t first = order[i].first;
+    // the thread got its first turn when the previous turn was put
+    map<uint64_t, Record *>::iterator prev = by_turn.lower_bound(first);
+    if (prev != by_turn.begin()) {
+      --prev;
+      t.offset = prev->second->done - t.recs[0].got;
+    }
+    for (size_t j = 0; j < t.recs.size(); ++j) {
+      Record &r = t.recs[j];
+      r.enter += t.offset;
+      r.got += t.offset;
+      r.done += t.offset;
+      by_turn[r.turn] = &r;
+    }
+    t.aligned = true;
+  }
+}
+
+struct Writer {
+  FILE *f;
+  bool comma;
+  int64_t origin;       // ns mapped to ts 0
+  unsigned next_flow;
+
+  void begin_event() {
+    fprintf(f, comma ? ",\n" : "\n");
+    comma = true;
+  }
+  double us(int64_t ns) { return (ns - origin) / 1000.0; }
+  int track(int tid, int k) { return tid * NUM_TRACKS + k; }
+
+  void metadata(int pid, int tid, int k, const char *label) {
+    begin_event();
+    fprintf(f, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,"
+            "\"args\":{\"name\":\"T%d %s\"}}", pid, track(tid, k), tid, label);
+    begin_event();
+    fprintf(f, "{\"ph\":\"M\",\"name\":\"thread_sort_index\",\"pid\":%d,"
+            "\"tid\":%d,\"args\":{\"sort_index\":%d}}", pid, track(tid, k),
+            track(tid, k));
+  }
+
+  /// complete event; at least 1 ns long so that flows can bind to it
+  void span(int pid, int tid, int k, const string &name, int64_t start,
+            int64_t end, const Record *r = NULL) {
+    begin_event();
+    fprintf(f, "{\"ph\":\"X\",\"name\":\"%s\",\"cat\":\"%s\",\"pid\":%d,"
+            "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", name.c_str(),
+            track_names[k], pid, track(tid, k), us(start),
+            max<int64_t>(end - start, 1) / 1000.0);
+    if (r) {
+      fprintf(f, ",\"args\":{\"turn\":%llu,\"insid\":\"0x%x\"",
+              (unsigned long long)r->turn, r->insid);
+      for (size_t i = 0; i < r->args.size(); ++i)
+        fprintf(f, ",\"arg%u\":\"0x%llx\"", (unsigned)i,
+                (unsigned long long)r->args[i]);
+      fprintf(f, "}");
+    }
+    fprintf(f, "}");
+  }
+
+  void flow(const char *name, int pid, const Record *from, const Record *to) {
+    unsigned id = next_flow ++;
+    int64_t at = max(from->got, from->done - 1);
+    begin_event();
+    fprintf(f, "{\"ph\":\"s\",\"name\":\"%s\",\"cat\":\"flow\",\"id\":%u,"
+            "\"pid\":%d,\"tid\":%d,\"ts\":%.3f}", name, id, pid,
+            track(from->tid, from->op_track), us(at));
+    begin_event();
+    fprintf(f, "{\"ph\":\"f\",\"bp\":\"e\",\"name\":\"%s\",\"cat\":\"flow\","
+            "\"id\":%u,\"pid\":%d,\"tid\":%d,\"ts\":%.3f}", name, id, pid,
+            track(to->tid, to->op_track), us(to->got));
+  }
+};
+
+static void write_spans(Writer &w, Process &proc) {
+  for (Process::iterator it = proc.begin(); it != proc.end(); ++it) {
+    Thread &t = it->second;
+    for (int k = 0; k < TRACK_RDTSC; ++k)
+      w.metadata(t.pid, t.tid, k, track_names[k]);
+    for (size_t i = 0; i < t.recs.size(); ++i) {
+      Record &r = t.recs[i];
+      if (i > 0 && r.enter > t.recs[i-1].done) {
+        if (r.second)
+          w.span(t.pid, t.tid, TRACK_BLOCKED, r.base, t.recs[i-1].done,
+                 r.enter);
+        else
+          w.span(t.pid, t.tid, TRACK_APP, "app", t.recs[i-1].done, r.enter);
+      }
+      if (r.got > r.enter)
+        w.span(t.pid, t.tid, TRACK_WAIT, "wait " + r.base, r.enter, r.got);
+      w.span(t.pid, t.tid, r.op_track, r.op, r.got, r.done, &r);
+    }
+  }
+}
+
+/// who releases whom: for each record that was woken up (or acquired
+/// something another thread just released), the record that did it
+static bool is(const Record &r, unsigned sync) { return r.sync == sync; }
+
+static void write_flows(Writer &w, int pid, Process &proc) {
+  vector<Record *> all;
+  for (Process::iterator it = proc.begin(); it != proc.end(); ++it)
+    for (size_t i = 0; i < it->second.recs.size(); ++i)
+      all.push_back(&it->second.recs[i]);
+  struct by_turn {
+    bool operator()(const Record *a, const Record *b) const {
+      return a->turn < b->turn;
+    }
+  };
+  stable_sort(all.begin(), all.end(), by_turn());
+
+  // putTurn -> getTurn of the next turn, when it changes threads
+  for (size_t i = 1; i < all.size(); ++i)
+    if (all[i]->turn == all[i-1]->turn + 1 && all[i]->tid != all[i-1]->tid)
+      w.flow("turn", pid, all[i-1], all[i]);
+
+  // the latest release on each object
+  map<uint64_t, Record *> released;
+  for (size_t i = 0; i < all.size(); ++i) {
+    Record &r = *all[i];
+    if (r.args.empty())
+      continue;
+    uint64_t obj = r.args[0];
+    using namespace syncfunc;
+    if (is(r, pthread_cond_signal) || is(r, pthread_cond_broadcast)
+        || is(r, pthread_mutex_unlock) || is(r, sem_post)
+        || is(r, pthread_rwlock_unlock)
+        || (is(r, pthread_barrier_wait) && r.first)) {
+      released[obj] = &r;
+      continue;
+    }
+    bool woken = ((is(r, pthread_cond_wait) || is(r, pthread_cond_timedwait)
+                   || is(r, pthread_barrier_wait)) && r.second)
+      || is(r, pthread_mutex_lock) || is(r, pthread_mutex_timedlock)
+      || is(r, sem_wait) || is(r, sem_timedwait)
+      || is(r, pthread_rwlock_rdlock) || is(r, pthread_rwlock_wrlock);
+    map<uint64_t, Record *>::iterator rel = released.find(obj);
+    if (!woken || rel == released.end() || rel->second->tid == r.tid)
+      continue;
+    // only a real handoff if this thread had to wait for it
+    if (r.second || r.enter <= rel->second->done)
+      w.flow("wakeup", pid, rel->second, &r);
+    if (!is(*rel->second, pthread_cond_broadcast)
+        && !is(*rel->second, pthread_barrier_wait))
+      released.erase(rel);
+  }
+}
+
+/// rdtsc dump lines: <pthread id> <--depth><op> <START|END> <cycles> <eip>
+struct RdtscSpan {
+  string op;
+  uint64_t start, end;
+  unsigned depth;
+};
+
+static double tsc_ghz_from_cpuinfo(void) {
+  FILE *f = fopen("/proc/cpuinfo", "r");
+  if (!f)
+    return 0;
+  char line[1024];
+  double ghz = 0, mhz = 0;
+  while (fgets(line, sizeof(line), f)) {
+    char *at = strstr(line, "@ ");
+    if (!strncmp(line, "model name", 10) && at && strstr(at, "GHz"))
+      ghz = atof(at + 2);
+    if (!strncmp(line, "cpu MHz", 7) && strchr(line, ':') && mhz == 0)
+      mhz = atof(strchr(line, ':') + 1);
+  }
+  fclose(f);
+  return ghz ? ghz : mhz / 1000.0;
+}
+
+static int write_rdtsc(Writer &w, const char *path, double ghz) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    perror(path);
+    return -1;
+  }
+  map<uint64_t, vector<RdtscSpan> > spans;     // by pthread id
+  map<uint64_t, vector<RdtscSpan> > open;
+  char line[1024], op[512], what[64];
+  unsigned long long th, clk;
+  while (fgets(line, sizeof(line), f)) {
+    if (sscanf(line, "%llu %511s %63s %llu", &th, op, what, &clk) != 4)
+      continue;
+    unsigned depth = 0;
+    char *name = op;
+    while (!strncmp(name, "----", 4)) {
+      name += 4;
+      ++ depth;
+    }
+    vector<RdtscSpan> &stack = open[th];
+    if (!strcmp(what, "START")) {
+      RdtscSpan s = {name, clk, 0, depth};
+      stack.push_back(s);
+    } else if (!strcmp(what, "END")) {
+      // close the innermost open span of this op
+      for (size_t i = stack.size(); i-- > 0; )
+        if (stack[i].op == name) {
+          stack[i].end = clk;
+          spans[th].push_back(stack[i]);
+          stack.erase(stack.begin() + i);
+          break;
+        }
+    }
+  }
+  fclose(f);
+
+  // pthread id -> (pid, tern tid), from the tern_thread_begin records
+  map<uint64_t, pair<int, int> > tids;
+  for (map<int, Process>::iterator p = procs.begin(); p != procs.end(); ++p)
+    for (Process::iterator t = p->second.begin(); t != p->second.end(); ++t)
+      for (size_t i = 0; i < t->second.recs.size(); ++i) {
+        Record &r = t->second.recs[i];
+        if (r.sync == syncfunc::tern_thread_begin && !r.args.empty())
+          tids[(unsigned)r.args[0]] = make_pair(p->first, t->first);
+      }
+
+  // put each GET_TURN END on the getTurn of the same thread's records
+  // that took a turn (every record but the second of a pair), in order,
+  // and use the median offset
+  vector<int64_t> diffs;
+  for (map<uint64_t, vector<RdtscSpan> >::iterator s = spans.begin();
+       s != spans.end(); ++s) {
+    if (!tids.count(s->first))
+      continue;
+    pair<int, int> id = tids[s->first];
+    Thread &t = procs[id.first][id.second];
+    vector<uint64_t> gets;
+    for (size_t i = 0; i < s->second.size(); ++i)
+      if (s->second[i].op == "GET_TURN")
+        gets.push_back(s->second[i].end);
+    sort(gets.begin(), gets.end());
+    size_t k = 0;
+    for (size_t i = 0; i < t.recs.size() && k < gets.size(); ++i)
+      if (!t.recs[i].second)
+        diffs.push_back(t.recs[i].got - (int64_t)(gets[k++] / ghz));
+  }
+  int64_t offset;
+  if (!diffs.empty()) {
+    nth_element(diffs.begin(), diffs.begin() + diffs.size() / 2, diffs.end());
+    offset = diffs[diffs.size() / 2];
+  } else {
+    // nothing to line up with: start the rdtsc data at ts 0
+    uint64_t min_clk = ~0ULL;
+    for (map<uint64_t, vector<RdtscSpan> >::iterator s = spans.begin();
+         s != spans.end(); ++s)
+      for (size_t i = 0; i < s->second.size(); ++i)
+        min_clk = min<uint64_t>(min_clk, s->second[i].start);
+    offset = w.origin - (int64_t)(min_clk / ghz);
+  }
+
+  int unknown = 0;
+  for (map<uint64_t, vector<RdtscSpan> >::iterator s = spans.begin();
+       s != spans.end(); ++s) {
+    int pid, tid;
+    if (tids.count(s->first)) {
+      pid = tids[s->first].first;
+      tid = tids[s->first].second;
+    } else {
+      // not in the sync log (idle thread, or no log at all)
+      pid = -1;
+      tid = unknown ++;
+      if (tid == 0) {
+        w.begin_event();
+        fprintf(w.f, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":-1,"
+                "\"args\":{\"name\":\"rdtsc, not in the sync logs\"}}");
+      }
+    }
+    w.metadata(pid, tid, TRACK_RDTSC, track_names[TRACK_RDTSC]);
+    // emit outer spans first so nesting is well formed at equal starts
+    vector<RdtscSpan> &v = s->second;
+    for (size_t i = 0; i < v.size(); ++i)
+      w.span(pid, tid, TRACK_RDTSC, v[i].op,
+             (int64_t)(v[i].start / ghz) + offset,
+             (int64_t)(v[i].end / ghz) + offset);
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  const char *output = "trace.json", *rdtsc = NULL;
+  double ghz = 0;
+  bool keep_idle = false;
+  int i;
+
+  for (i = 1; i < argc && argv[i][0] == '-'; ++i) {
+    if (!strcmp(argv[i], "-o") && i + 1 < argc)
+      output = argv[++i];
+    else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+      rdtsc = argv[++i];
+    else if (!strcmp(argv[i], "-g") && i + 1 < argc)
+      ghz = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-i"))
+      keep_idle = true;
+    else
+      break;
+  }
+  if (i != argc - 1) {
+    fprintf(stderr, "Usage: %s [-o trace.json] [-r pself-pid-N.txt] "
+            "[-g ghz] [-i] <out dir>\n", argv[0]);
+    return 1;
+  }
+  int nfiles = read_logs(argv[i], keep_idle);
+  if (nfiles < 0)
+    return 1;
+  if (nfiles == 0 && !rdtsc) {
+    fprintf(stderr, "%s: no tid-*.txt sync logs\n", argv[i]);
+    return 1;
+  }
+  if (rdtsc && ghz <= 0 && (ghz = tsc_ghz_from_cpuinfo()) <= 0) {
+    fprintf(stderr, "can't tell the TSC rate, use -g\n");
+    return 1;
+  }
+
+  Writer w;
+  w.f = fopen(output, "w");
+  if (!w.f) {
+    perror(output);
+    return 1;
+  }
+  w.comma = false;
+  w.next_flow = 0;
+  w.origin = INT64_MAX;
+  size_t nrecs = 0;
+  for (map<int, Process>::iterator p = procs.begin(); p != procs.end(); ++p) {
+    align(p->second);
+    for (Process::iterator t = p->second.begin(); t != p->second.end(); ++t) {
+      if (!t->second.recs.empty())
+        w.origin = min(w.origin, t->second.recs[0].got);
+      nrecs += t->second.recs.size();
+    }
+  }
+  if (w.origin == INT64_MAX)
+    w.origin = 0;
+
+  fprintf(w.f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+  for (map<int, Process>::iterator p = procs.begin(); p != procs.end(); ++p) {
+    write_spans(w, p->second);
+    write_flows(w, p->first, p->second);
+  }
+  if (rdtsc && write_rdtsc(w, rdtsc, ghz) < 0)
+    return 1;
+  fprintf(w.f, "\n]}\n");
+  fclose(w.f);
+  fprintf(stderr, "%s: %lu records from %d logs, %u flows\n", output,
+          (unsigned long)nrecs, nfiles, w.next_flow);
+  return 0;
+}
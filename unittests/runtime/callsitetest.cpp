@@ -0,0 +1,76 @@
+#include <execinfo.h>
+#include <stdio.h>
+#include <time.h>
+#include "gtest/gtest.h"
+#include "tern/runtime/callsite.h"
+
+using namespace tern;
+
+// needs -fno-omit-frame-pointer, see the Makefile
+
+static void *walk_first[2], *bt_first[3];
+
+static void __attribute__((noinline)) callee(void) {
+  frameWalk(__builtin_frame_address(0), walk_first, 2);
+  backtrace(bt_first, 3);
+  asm volatile("" ::: "memory");
+}
+
+static void __attribute__((noinline)) caller(void) {
+  callee();
+  asm volatile("" ::: "memory");
+}
+
+// the walk sees the same return addresses as the unwinder
+TEST(callsitetest, matches_backtrace) {
+  caller();
+  EXPECT_EQ(bt_first[1], walk_first[0]);
+  EXPECT_EQ(bt_first[2], walk_first[1]);
+}
+
+TEST(callsitetest, bad_frame) {
+  void *rets[4];
+  int local;
+  EXPECT_EQ(0, frameWalk(NULL, rets, 4));
+  EXPECT_EQ(0, frameWalk((void*)0x1234, rets, 4));
+  // a pointer into the stack that is not a frame stops the walk early
+  EXPECT_GE(4, frameWalk(&local, rets, 4));
+}
+
+static uint64_t now_ns(void) {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static volatile uint64_t sink;
+
+static void __attribute__((noinline)) bench(int method, int depth) {
+  void *rets[CALLSITE_MAX_DEPTH];
+  if (depth > 0) {
+    bench(method, depth - 1);
+    asm volatile("" ::: "memory");
+    return;
+  }
+  const int n = 100000;
+  uint64_t start = now_ns();
+  for (int i = 0; i < n; ++i) {
+    switch (method) {
+    case 0: sink = (uint64_t)__builtin_return_address(0); break;
+    case 1: sink = stackSignature(__builtin_frame_address(0)); break;
+    case 2: sink = backtrace(rets, 5); break;
+    case 3: sink = backtrace(rets, CALLSITE_MAX_DEPTH); break;
+    }
+  }
+  static const char *names[] = {"__builtin_return_address",
+    "frame pointer walk (20)", "backtrace (5)", "backtrace (20)"};
+  fprintf(stderr, "%-26s %8.1f ns/call\n", names[method],
+          (double)(now_ns() - start) / n);
+}
+
+// not a pass/fail test; prints what each way of getting a call site costs
+// 30 frames down
+TEST(callsitetest, benchmark) {
+  for (int m = 0; m < 4; ++m)
+    bench(m, 30);
+}
@@ -0,0 +1,167 @@
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+#include "gtest/gtest.h"
+#include "tern/runtime/compact-log.h"
+
+using namespace tern;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// a lock/unlock/cond_wait mix over a few objects and call sites, roughly
+// what one thread of the test programs logs
+static void make_recs(std::vector<AsyncSyncRec> &recs, unsigned num) {
+  for (unsigned i = 0; i < num; ++i) {
+    AsyncSyncRec rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.turn = 3 * i + i % 2;
+    rec.insid = 0x80400000 + (i % 5) * 0x20;
+    rec.tid = 2;
+    rec.after = 1;
+    // update_time() intervals, in ns
+    rec.app_time = 250 + (i * 37) % 4000;
+    rec.syscall_time = 40 + i % 50;
+    rec.sched_time = 900 + (i * 13) % 20000;
+    switch (i % 3) {
+    case 0:
+      rec.sync = syncfunc::pthread_mutex_lock;
+      rec.args[0] = 0x601040 + (i % 4) * 0x40;
+      break;
+    case 1:
+      rec.sync = syncfunc::pthread_mutex_unlock;
+      rec.args[0] = 0x601040 + (i % 4) * 0x40;
+      break;
+    case 2:
+      rec.sync = syncfunc::pthread_cond_timedwait;
+      rec.args[0] = 0x6010c0;
+      rec.args[1] = 0x601040;
+      rec.args[2] = i % 7 ? 0 : ETIMEDOUT;
+      break;
+    }
+    rec.nargs = NumLoggedSyncArgs(rec.sync);
+    recs.push_back(rec);
+  }
+}
+
+TEST(compactlogtest, varint) {
+  char buf[16];
+  uint64_t vals[] = {0, 1, 127, 128, 300, 0xffffffffULL, ~0ULL};
+  for (unsigned i = 0; i < sizeof(vals)/sizeof(vals[0]); ++i) {
+    char *end = putVarint(buf, vals[i]);
+    uint64_t v;
+    EXPECT_EQ(end, getVarint(buf, end, v));
+    EXPECT_EQ(vals[i], v);
+    // a truncated varint is detected
+    if (end - buf > 1) {
+      EXPECT_TRUE(getVarint(buf, end - 1, v) == NULL);
+    }
+  }
+  int64_t svals[] = {0, -1, 1, -64, 64, -1000000};
+  for (unsigned i = 0; i < sizeof(svals)/sizeof(svals[0]); ++i)
+    EXPECT_EQ(svals[i], unzigzag(zigzag(svals[i])));
+}
+
+TEST(compactlogtest, roundtrip) {
+  const unsigned num = 100000;
+  std::vector<AsyncSyncRec> recs;
+  make_recs(recs, num);
+
+  std::vector<char> buf(num * COMPACT_MAX_REC);
+  CompactLogEncoder enc;
+  char *p = &buf[0];
+  uint64_t start = now_ns();
+  for (unsigned i = 0; i < num; ++i)
+    p = enc.encode(p, recs[i]);
+  uint64_t enc_ns = now_ns() - start;
+  size_t size = p - &buf[0];
+
+  CompactLogDecoder dec;
+  dec.attach(&buf[0], size, 2);
+  AsyncSyncRec rec;
+  unsigned n = 0;
+  start = now_ns();
+  while (dec.next(rec)) {
+    ASSERT_LT(n, num);
+    EXPECT_EQ(recs[n].turn, rec.turn);
+    EXPECT_EQ(recs[n].insid, rec.insid);
+    EXPECT_EQ(recs[n].sync, rec.sync);
+    EXPECT_EQ(recs[n].app_time, rec.app_time);
+    EXPECT_EQ(recs[n].syscall_time, rec.syscall_time);
+    EXPECT_EQ(recs[n].sched_time, rec.sched_time);
+    ASSERT_EQ(recs[n].nargs, rec.nargs);
+    for (unsigned i = 0; i < rec.nargs; ++i)
+      EXPECT_EQ(recs[n].args[i], rec.args[i]);
+    ++ n;
+  }
+  uint64_t dec_ns = now_ns() - start;
+  EXPECT_EQ(num, n);
+
+  // the fixed-size bin log spends RECORD_SIZE bytes per record
+  EXPECT_LT(size * 2, (size_t)num * RECORD_SIZE);
+  printf("compact log: %.2f bytes/record (%.2fx vs bin), "
+         "encode %.1f ns/record, decode %.1f ns/record\n",
+         (double)size / num, (double)num * RECORD_SIZE / size,
+         (double)enc_ns / num, (double)dec_ns / num);
+}
+
+#ifndef UNITTEST_LOG_DIR
+#define UNITTEST_LOG_DIR "logs"
+#endif
+
+// logs/semaphore-test.cmp is the main thread of test/runtime/semaphore-test
+// recorded with log_type=compact.  Re-encoding what it decodes to must give
+// back the same bytes, so the recorded numbers hold for real schedules too.
+TEST(compactlogtest, recorded) {
+  const char *file = UNITTEST_LOG_DIR "/semaphore-test.cmp";
+  CompactLogDecoder dec;
+  ASSERT_TRUE(dec.open(file));
+
+  std::vector<AsyncSyncRec> recs;
+  AsyncSyncRec rec;
+  FILE *txt = tmpfile();
+  ASSERT_TRUE(txt != NULL);
+  while (dec.next(rec)) {
+    EXPECT_EQ(dec.getTid(), rec.tid);
+    CompactLogDecoder::print(txt, rec);
+    recs.push_back(rec);
+  }
+  ASSERT_FALSE(recs.empty());
+  size_t txt_size = ftell(txt);
+  fclose(txt);
+
+  std::vector<char> orig(dec.size());
+  FILE *f = fopen(file, "r");
+  ASSERT_TRUE(f != NULL);
+  fseek(f, -(long)orig.size(), SEEK_END);
+  ASSERT_EQ(orig.size(), fread(&orig[0], 1, orig.size(), f));
+  fclose(f);
+
+  // the log is small; re-encode it enough times to time it
+  const unsigned reps = 1000;
+  std::vector<char> buf(recs.size() * COMPACT_MAX_REC);
+  size_t size = 0;
+  uint64_t start = now_ns();
+  for (unsigned r = 0; r < reps; ++r) {
+    CompactLogEncoder enc;
+    char *p = &buf[0];
+    for (unsigned i = 0; i < recs.size(); ++i)
+      p = enc.encode(p, recs[i]);
+    size = p - &buf[0];
+  }
+  uint64_t enc_ns = now_ns() - start;
+  ASSERT_EQ(orig.size(), size);
+  EXPECT_EQ(0, memcmp(&orig[0], &buf[0], size));
+
+  size_t num = recs.size();
+  EXPECT_LT(size * 2, num * RECORD_SIZE);
+  printf("semaphore-test: %u records, %.2f bytes/record "
+         "(%.2fx vs bin, %.2fx vs txt), encode %.1f ns/record\n",
+         (unsigned)num, (double)size / num,
+         (double)num * RECORD_SIZE / size, (double)txt_size / size,
+         (double)enc_ns / reps / num);
+}
@@ -0,0 +1,63 @@
+#ifndef __TERN_UNITTESTS_FAKE_SCHEDULER_H
+#define __TERN_UNITTESTS_FAKE_SCHEDULER_H
+
+#include <list>
+#include <vector>
+#include "tern/runtime/record-scheduler.h"
+
+namespace tern {
+
+/// @_S (RRScheduler or a child) with fake threads 1..n that never run;
+/// they only sit in the queues, so tests and benchmarks can drive the
+/// scheduler's bookkeeping from the main thread, which holds the turn.
+template <typename _S>
+struct FakeScheduler: public _S {
+  using _S::runq;
+  using _S::waitq;
+  using _S::turnCount;
+  using _S::waits;
+  using _S::nextTimeout;
+  using _S::fireTimeouts;
+  using _S::check_wakeup;
+  using _S::inter_pro_wakeup_tids;
+  using _S::inter_pro_wakeup_flag;
+  using _S::keep_turn;
+  using _S::coalesce_left;
+
+  /// fake threads 1..n, none of them on @runq
+  explicit FakeScheduler(int n) {
+    for (long i = 1; i <= n; ++i)
+      this->create((pthread_t)i);
+    drain();
+  }
+
+  /// what wait() does before it gives up the turn
+  void park(int tid, void *chan, uint64_t timeout) {
+    waits[tid].chan = chan;
+    waits[tid].timeout = timeout;
+    waitq.push_back(tid);
+  }
+
+  bool waiting(int tid) {
+    for (std::list<int>::iterator it = waitq.begin(); it != waitq.end(); ++it)
+      if (*it == tid)
+        return true;
+    return false;
+  }
+
+  /// put everything but the main thread off @runq again
+  void drain() {
+    while (runq.size() > 1)
+      runq.erase(++runq.begin());
+  }
+
+  std::vector<int> runnable() {
+    return std::vector<int>(runq.begin(), runq.end());
+  }
+
+  void setTurnCount(uint64_t n) { turnCount = n; }
+};
+
+}
+
+#endif
@@ -0,0 +1,50 @@
+#include <string.h>
+#include "gtest/gtest.h"
+#include "tern/runtime/latency-hist.h"
+
+using namespace tern;
+
+TEST(latencyhisttest, buckets) {
+  // every value lands in the bucket whose range contains it
+  for (uint64_t v = 0; v < 100000; ++v) {
+    unsigned b = LatencyHist::bucket(v);
+    ASSERT_LT(b, (unsigned)LAT_NUM_BUCKETS);
+    ASSERT_LE(LatencyHist::bucketLow(b), v);
+    if (b + 1 < LAT_NUM_BUCKETS) {
+      ASSERT_GT(LatencyHist::bucketLow(b + 1), v);
+    }
+  }
+  // relative bucket width is bounded by 2^-LAT_SUB_BITS
+  for (unsigned b = (2 << LAT_SUB_BITS); b + 1 < LAT_NUM_BUCKETS; ++b) {
+    uint64_t lo = LatencyHist::bucketLow(b), hi = LatencyHist::bucketLow(b + 1);
+    EXPECT_LE((hi - lo) * (1 << LAT_SUB_BITS), lo);
+  }
+  EXPECT_EQ((unsigned)LAT_NUM_BUCKETS - 1, LatencyHist::bucket(~0ULL));
+  EXPECT_EQ(1ULL << LAT_MAX_EXP, LatencyHist::bucketLow(LAT_NUM_BUCKETS - 1));
+}
+
+TEST(latencyhisttest, percentiles) {
+  LatencyHist h;
+  memset(&h, 0, sizeof(h));
+  // 1..10000 ns, uniformly
+  for (uint64_t v = 1; v <= 10000; ++v)
+    h.add(v);
+  EXPECT_EQ(10000U, h.count());
+  EXPECT_EQ(10000U, h.max_ns);
+  double ps[] = {50, 90, 99, 99.9};
+  for (unsigned i = 0; i < sizeof(ps)/sizeof(ps[0]); ++i) {
+    double exact = ps[i] * 100;
+    uint64_t got = h.percentile(ps[i]);
+    EXPECT_LE(got, exact);
+    EXPECT_GE(got, exact * (1.0 - 1.0 / (1 << LAT_SUB_BITS)));
+  }
+
+  LatencyHist h2;
+  memset(&h2, 0, sizeof(h2));
+  h2.add(1000000);
+  h.merge(h2);
+  EXPECT_EQ(10001U, h.count());
+  EXPECT_EQ(1000000U, h.max_ns);
+  EXPECT_EQ(LatencyHist::bucketLow(LatencyHist::bucket(1000000)),
+            h.percentile(100));
+}
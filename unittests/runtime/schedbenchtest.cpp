@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <time.h>
+#include <stdint.h>
+#include "gtest/gtest.h"
+#include "tern/runtime/record-scheduler.h"
+#include "fake-scheduler.h"
+
+using namespace tern;
+
+// Microbenchmarks of the RR scheduler's bookkeeping: @runq, the single
+// @waitq scanned by signal() and fireTimeouts(), and the inter-process
+// wakeup set.  Nothing blocks: the main thread holds the turn throughout
+// and parks fake threads directly on the structures, so the numbers are
+// the cost of the data structures alone.  Not pass/fail beyond sanity
+// checks; run with --gtest_filter=schedbench.* and read stderr.
+
+static uint64_t now_ns(void) {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/// @k is channels for signal/broadcast and timeouts for fireTimeouts
+static void report(const char *what, int n, int k, uint64_t ns, long ops) {
+  fprintf(stderr, "%-22s N=%5d K=%5d %10.1f ns/op\n", what, n, k,
+          (double)ns / ops);
+}
+
+typedef FakeScheduler<RRScheduler> BenchScheduler;
+
+static char chans[4096];
+
+// N waiters spread round robin over K channels, then one signal per
+// waiter.  The waiter to wake is found by scanning @waitq, so the cost
+// grows with how far down the queue the first match on the channel is.
+static void bench_signal(int n, int k, bool all) {
+  BenchScheduler s(n);
+  const int rounds = 20000 / n + 1;
+  uint64_t ns = 0;
+  long ops = 0;
+  for (int r = 0; r < rounds; ++r) {
+    for (int t = 1; t <= n; ++t)
+      s.park(t, &chans[(t - 1) % k], Scheduler::FOREVER);
+    uint64_t start = now_ns();
+    if (all) {
+      for (int c = k - 1; c >= 0; --c)
+        s.signal(&chans[c], true);
+      ops += k;
+    } else {
+      for (int t = n; t >= 1; --t)
+        s.signal(&chans[(t - 1) % k]);
+      ops += n;
+    }
+    ns += now_ns() - start;
+    ASSERT_TRUE(s.waitq.empty());
+    ASSERT_EQ((size_t)n + 1, s.runq.size());
+    s.drain();
+  }
+  report(all ? "broadcast" : "signal", n, k, ns, ops);
+}
+
+TEST(schedbench, signal) {
+  int ns[] = {16, 256, 1024};
+  for (unsigned i = 0; i < sizeof(ns)/sizeof(ns[0]); ++i) {
+    bench_signal(ns[i], 1, false);
+    bench_signal(ns[i], 16, false);
+    bench_signal(ns[i], ns[i], false);
+  }
+}
+
+TEST(schedbench, broadcast) {
+  int ns[] = {16, 256, 1024};
+  for (unsigned i = 0; i < sizeof(ns)/sizeof(ns[0]); ++i) {
+    bench_signal(ns[i], 1, true);
+    bench_signal(ns[i], 16, true);
+    bench_signal(ns[i], ns[i], true);
+  }
+}
+
+// N waiters of which M have a timeout, one per turn starting at turn 1.
+// Every turn the holder calls fireTimeouts() (as next() does), which
+// scans all of @waitq even when nothing expires.
+static void bench_timeouts(int n, int m) {
+  BenchScheduler s(n);
+  const int rounds = 20000 / n + 1;
+  uint64_t ns = 0, scan_ns = 0;
+  long ops = 0, scans = 0;
+  for (int r = 0; r < rounds; ++r) {
+    s.setTurnCount(0);
+    for (int t = 1; t <= n; ++t)
+      s.park(t, &chans[0], t <= m ? (uint64_t)t : Scheduler::FOREVER);
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < 16; ++i)
+      ASSERT_EQ(0, s.fireTimeouts());
+    scan_ns += now_ns() - start;
+    scans += 16;
+
+    int fired = 0;
+    start = now_ns();
+    for (int turn = 2; turn <= m + 1; ++turn) {
+      s.setTurnCount(turn);
+      fired += s.fireTimeouts();
+      s.nextTimeout();
+    }
+    ns += now_ns() - start;
+    ops += m;
+    ASSERT_EQ(m, fired);
+    s.signal(&chans[0], true);
+    s.drain();
+  }
+  report("fireTimeouts (none)", n, 0, scan_ns, scans);
+  report("fireTimeouts (expire)", n, m, ns, ops);
+}
+
+TEST(schedbench, timeouts) {
+  bench_timeouts(16, 16);
+  bench_timeouts(256, 16);
+  bench_timeouts(256, 256);
+  bench_timeouts(1024, 64);
+  bench_timeouts(1024, 1024);
+}
+
+// N threads come back from inter-process operations at once; the turn
+// holder moves them all from the wakeup set to @runq in check_wakeup().
+static void bench_wakeup_storm(int n) {
+  BenchScheduler s(n);
+  const int rounds = 20000 / n + 1;
+  uint64_t ns = 0;
+  long ops = 0;
+  for (int r = 0; r < rounds; ++r) {
+    for (int t = 1; t <= n; ++t)
+      s.inter_pro_wakeup_tids.insert(t);
+    s.inter_pro_wakeup_flag = true;
+    uint64_t start = now_ns();
+    s.check_wakeup();
+    ns += now_ns() - start;
+    ops += n;
+    ASSERT_EQ((size_t)n + 1, s.runq.size());
+    s.drain();
+  }
+  report("wakeup storm", n, 0, ns, ops);
+}
+
+TEST(schedbench, wakeup_storm) {
+  bench_wakeup_storm(16);
+  bench_wakeup_storm(256);
+  bench_wakeup_storm(1024);
+}
+
+// the operations putTurn() and the network path do on @runq
+TEST(schedbench, run_queue) {
+  const int n = 1024, rounds = 200;
+  run_queue q;
+  for (int t = 0; t < n; ++t)
+    q.create_thd_elem(t);
+  for (int t = 0; t < n; ++t)
+    q.push_back(t);
+
+  uint64_t start = now_ns();
+  for (int r = 0; r < rounds; ++r)
+    for (int t = 0; t < n; ++t) {
+      int tid = q.front();
+      q.pop_front();
+      q.push_back(tid);
+    }
+  report("runq pop+push_back", n, 0, now_ns() - start, (long)rounds * n);
+
+  start = now_ns();
+  for (int r = 0; r < rounds; ++r)
+    for (int t = 0; t < n; ++t) {
+      int tid = q.front();
+      q.pop_front();
+      q.push_front(tid);
+    }
+  report("runq pop+push_front", n, 0, now_ns() - start, (long)rounds * n);
+
+  // remove a thread from the middle and put it back, as a thread does
+  // when it blocks in an inter-process operation and is woken up
+  start = now_ns();
+  for (int r = 0; r < rounds; ++r)
+    for (int t = 0; t < n; ++t) {
+      run_queue::iterator it = q.begin();
+      for (int i = 0; i < n / 2; ++i)
+        ++it;
+      int tid = *it;
+      q.erase(it);
+      ASSERT_FALSE(q.in(tid));
+      q.push_back(tid);
+    }
+  report("runq find+erase+push", n, 0, now_ns() - start, (long)rounds * n);
+  ASSERT_EQ((size_t)n, q.size());
+}
@@ -0,0 +1,26 @@
+#include "gtest/gtest.h"
+#include "tern/syncfuncs.h"
+#include "tern/runtime/schedule-fingerprint.h"
+
+using namespace tern;
+
+static uint64_t run_schedule(uint64_t mu_a, uint64_t mu_b, bool swap) {
+  ScheduleFingerprint::reset();
+  ScheduleFingerprint::update(1, swap ? 2 : 1, syncfunc::pthread_mutex_lock, mu_a);
+  ScheduleFingerprint::update(2, swap ? 1 : 2, syncfunc::pthread_mutex_lock, mu_b);
+  ScheduleFingerprint::update(3, 1, syncfunc::pthread_mutex_unlock, mu_a);
+  // fds and sizes of syscalls are not part of the schedule
+  ScheduleFingerprint::update(4, 2, syncfunc::read, mu_a + mu_b);
+  return ScheduleFingerprint::hash;
+}
+
+// Objects are renamed by first use, so the same schedule over objects at
+// other addresses gives the same fingerprint; a different order does not.
+TEST(schedulefingerprinttest, canonical_objects) {
+  uint64_t h1 = run_schedule(0x1000, 0x2000, false);
+  uint64_t h2 = run_schedule(0x7f00, 0x3000, false);
+  uint64_t h3 = run_schedule(0x1000, 0x2000, true);
+  EXPECT_EQ(h1, h2);
+  EXPECT_NE(h1, h3);
+  EXPECT_EQ(4U, ScheduleFingerprint::nops);
+}
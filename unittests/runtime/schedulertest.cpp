@@ -1,5 +1,11 @@
+#include <errno.h>
+#include <stdint.h>
+#include <vector>
 #include "gtest/gtest.h"
+#include "tern/options.h"
+#include "tern/syncfuncs.h"
 #include "tern/runtime/record-scheduler.h"
+#include "fake-scheduler.h"
 
 using namespace tern;
 
@@ -8,3 +14,153 @@ TEST(scheduler, single_thread) {
   //RRSchedulerCV rrcv(pthread_self());
   // TODO: unit test cases
 }
+
+// push_front() must link the old head back to the new one, or erasing
+// the old head leaves the new head pointing at a detached element
+TEST(scheduler, run_queue_push_front_then_erase_old_head) {
+  run_queue q;
+  for (int t = 0; t < 4; ++t)
+    q.create_thd_elem(t);
+  q.push_back(0);
+  q.push_back(1);
+  q.push_back(2);
+  q.push_front(3);
+  run_queue::iterator it = q.begin();
+  ++it;
+  ASSERT_EQ(0, *it);
+  q.erase(it);
+
+  std::vector<int> order;
+  for (it = q.begin(); it != q.end(); ++it)
+    order.push_back(*it);
+  ASSERT_EQ(3U, order.size());
+  EXPECT_EQ(3, order[0]);
+  EXPECT_EQ(1, order[1]);
+  EXPECT_EQ(2, order[2]);
+  EXPECT_EQ(3U, q.size());
+}
+
+/// RR scheduler with fake threads parked on @waitq, so timeouts can be
+/// checked without running anything
+typedef FakeScheduler<RRScheduler> TurnScheduler;
+
+static const uint64_t TWO_32 = 1ULL << 32;
+
+TEST(scheduler, turn_count_past_32_bits) {
+  TurnScheduler s(0);
+  s.setTurnCount(TWO_32 - 2);
+  EXPECT_EQ(TWO_32 - 2, s.incTurnCount());
+  EXPECT_EQ(TWO_32 - 1, s.incTurnCount());
+  EXPECT_EQ(TWO_32, s.incTurnCount());
+  EXPECT_EQ(TWO_32, s.getTurnCount());
+}
+
+TEST(scheduler, timeout_across_32_bits) {
+  TurnScheduler s(2);
+  s.setTurnCount(TWO_32 - 4);
+  // a relative timeout of 10 turns ends past 2^32; truncated to 32 bits
+  // it would be in the past and fire right away
+  uint64_t timeout = s.getTurnCount() + 10;
+  s.park(1, &s, timeout);
+  s.park(2, &s, Scheduler::FOREVER);
+  EXPECT_EQ(timeout, s.nextTimeout());
+
+  // a wait times out on the turn that reaches its timeout
+  while (s.getTurnCount() + 1 < timeout) {
+    s.incTurnCount();
+    ASSERT_TRUE(s.waiting(1)) << "timed out early at turn "
+                              << s.getTurnCount();
+  }
+  s.incTurnCount();
+  EXPECT_FALSE(s.waiting(1));
+  EXPECT_EQ(ETIMEDOUT, s.waits[1].status);
+  EXPECT_TRUE(s.waiting(2));
+  EXPECT_EQ(Scheduler::FOREVER, s.nextTimeout());
+}
+
+TEST(scheduler, timeouts_fire_in_order_past_32_bits) {
+  TurnScheduler s(3);
+  s.setTurnCount(TWO_32 + 100);
+  s.park(1, &s, TWO_32 + 103);
+  s.park(2, &s, TWO_32 + 101);
+  s.park(3, &s, TWO_32 - 1 + 200);
+  EXPECT_EQ(TWO_32 + 101, s.nextTimeout());
+  for (int i = 0; i < 3; ++i)
+    s.incTurnCount();
+  EXPECT_FALSE(s.waiting(2));
+  EXPECT_TRUE(s.waiting(1));
+  EXPECT_TRUE(s.waiting(3));
+  for (int i = 0; i < 2; ++i)
+    s.incTurnCount();
+  EXPECT_FALSE(s.waiting(1));
+  EXPECT_EQ(TWO_32 + 199, s.nextTimeout());
+}
+
+TEST(scheduler, coalesce_keeps_turn_within_budget) {
+  int saved = options::coalesce_ops;
+  options::coalesce_ops = 2;
+  TurnScheduler s(1);
+  s.runq.push_back(1);
+
+  // a blocking op never keeps the turn, so the budget is not used
+  s.coalesce(syncfunc::pthread_mutex_lock);
+  EXPECT_FALSE(s.keep_turn);
+
+  // two unlocks in a row keep the turn ...
+  for (int i = 0; i < 2; ++i) {
+    s.coalesce(syncfunc::pthread_mutex_unlock);
+    s.incTurnCount();
+    s.putTurn();
+    EXPECT_EQ(0, s.runq.front());
+    s.getTurn();
+  }
+  // ... the third hands it on
+  s.coalesce(syncfunc::pthread_mutex_unlock);
+  EXPECT_FALSE(s.keep_turn);
+  s.incTurnCount();
+  s.putTurn();
+  EXPECT_EQ(1, s.runq.front());
+  EXPECT_EQ(2, s.coalesce_left[0]) << "budget is refilled once the turn moves";
+  options::coalesce_ops = saved;
+}
+
+TEST(scheduler, coalesce_only_for_marked_ops) {
+  int saved = options::coalesce_ops;
+  options::coalesce_ops = 4;
+  TurnScheduler s(2);
+  s.runq.push_back(1);
+  s.runq.push_back(2);
+
+  // a kept turn is not visible to the threads queued behind
+  s.coalesce(syncfunc::pthread_mutex_unlock);
+  s.incTurnCount();
+  s.putTurn();
+  EXPECT_EQ(0, s.runq.front());
+  EXPECT_EQ(3U, s.runq.size());
+  s.getTurn();
+
+  // an op the runtime did not mark (no coalesce() call), e.g. one
+  // followed by app code, hands the turn on with budget left
+  s.incTurnCount();
+  s.putTurn();
+  EXPECT_EQ(1, s.runq.front());
+  EXPECT_EQ(4, s.coalesce_left[0]);
+  EXPECT_FALSE(s.keep_turn);
+  options::coalesce_ops = saved;
+}
+
+TEST(scheduler, coalesce_not_across_pass_through_ops) {
+  // eval/sync-instr marks unlock(m); lock(m) ...
+  EXPECT_TRUE(syncfunc::takesTurn(syncfunc::pthread_mutex_unlock));
+  EXPECT_TRUE(syncfunc::takesTurn(syncfunc::pthread_mutex_lock));
+  EXPECT_TRUE(syncfunc::takesTurn(syncfunc::pthread_cond_wait));
+  EXPECT_TRUE(syncfunc::takesTurn(syncfunc::sem_post));
+  // ... but not unlock(m); t = time(0); while (!flag); since time() does
+  // not take the turn and so would not hand the kept one on
+  EXPECT_FALSE(syncfunc::takesTurn(syncfunc::time));
+  EXPECT_FALSE(syncfunc::takesTurn(syncfunc::gettimeofday));
+  EXPECT_FALSE(syncfunc::takesTurn(syncfunc::clock_gettime));
+  EXPECT_FALSE(syncfunc::takesTurn(syncfunc::write));
+  EXPECT_FALSE(syncfunc::takesTurn(syncfunc::close));
+  EXPECT_FALSE(syncfunc::takesTurn(syncfunc::sleep));
+}
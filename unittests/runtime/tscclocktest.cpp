@@ -0,0 +1,62 @@
+#include <time.h>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "tern/runtime/tsc-clock.h"
+
+using namespace tern;
+
+// TscClock::now() must track CLOCK_MONOTONIC_RAW within a small relative
+// error over intervals much longer than the calibration noise.
+static void check_against_raw(unsigned usec) {
+  uint64_t raw0 = TscClock::monotonicRaw(), now0 = TscClock::now();
+  usleep(usec);
+  uint64_t raw1 = TscClock::monotonicRaw(), now1 = TscClock::now();
+
+  double raw = (double)(raw1 - raw0), tsc = (double)(now1 - now0);
+  // 0.5% of the interval, plus 50us for preemption between the reads
+  EXPECT_NEAR(raw, tsc, raw * 0.005 + 50000)
+    << "interval " << usec << "us, tsc " << TscClock::usingTsc();
+}
+
+TEST(tscclocktest, accuracy) {
+  TscClock::init();
+  if (TscClock::usingTsc())
+    printf("TscClock: %.4f TSC cycles per ns\n", TscClock::tscPerNs());
+  else
+    printf("TscClock: no invariant TSC, using CLOCK_MONOTONIC_RAW\n");
+  check_against_raw(10000);
+  check_against_raw(100000);
+  check_against_raw(500000);
+}
+
+TEST(tscclocktest, monotonic) {
+  TscClock::init();
+  uint64_t last = TscClock::now();
+  for (int i = 0; i < 100000; ++i) {
+    uint64_t now = TscClock::now();
+    ASSERT_GE(now, last);
+    last = now;
+  }
+}
+
+TEST(tscclocktest, conversion) {
+  TscClock::init();
+  if (!TscClock::usingTsc())
+    return;
+  // scaling must be linear and not overflow for large TSC values
+  uint64_t c = 1000000000ULL;
+  double per = (double)TscClock::cyclesToNs(c) / c;
+  uint64_t big = 1ULL << 58;
+  double ratio = (double)TscClock::cyclesToNs(big) / (double)big;
+  EXPECT_NEAR(per, ratio, per * 1e-6);
+  EXPECT_NEAR((double)TscClock::cyclesToNs(2 * c),
+              2.0 * TscClock::cyclesToNs(c), 1.0);
+}
+
+TEST(tscclocktest, fallback) {
+  TscClock::init(/*force_fallback=*/true);
+  EXPECT_FALSE(TscClock::usingTsc());
+  check_against_raw(10000);
+  TscClock::init(); // restore for the tests that may run later
+  check_against_raw(10000);
+}
@@ -0,0 +1,113 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "gtest/gtest.h"
+#include "tern/options.h"
+#include "tern/syncfuncs.h"
+#include "tern/runtime/tsc-clock.h"
+#include "tern/runtime/turn-hog.h"
+
+using namespace tern;
+
+// Thread "B" takes the turn right away; "A" shows up late while two
+// others are queued, so the stall is charged to A's region.
+TEST(turnhogtest, charge_late_thread) {
+  TscClock::init();
+  unsigned waiters;
+
+  TurnHogProfiler::arrive();
+  uint64_t t = TscClock::now();
+  EXPECT_EQ(0U, TurnHogProfiler::grant(t, t, waiters));
+  TurnHogProfiler::release(syncfunc::pthread_mutex_unlock, 0x10, 0, waiters, t);
+
+  // two threads queue, and the turn sits idle until A arrives
+  TurnHogProfiler::arrive();
+  TurnHogProfiler::arrive();
+  usleep(20000);
+  TurnHogProfiler::arrive();
+  uint64_t a = TscClock::now();
+  uint64_t stall = TurnHogProfiler::grant(a, a, waiters);
+  EXPECT_EQ(2U, waiters);
+  EXPECT_GE(stall, 15000000U);
+  TurnHogProfiler::release(syncfunc::pthread_mutex_lock, 0x20, stall, waiters, a);
+
+  // a thread that was already waiting is not charged
+  uint64_t w = TscClock::now() - 1000000;
+  EXPECT_EQ(0U, TurnHogProfiler::grant(w, TscClock::now(), waiters));
+  TurnHogProfiler::release(syncfunc::pthread_mutex_lock, 0x30, 0, waiters, 0);
+  TurnHogProfiler::grant(w, TscClock::now(), waiters);
+
+  options::output_dir = "/tmp";
+  TurnHogProfiler::dump();
+  char path[64], line[256];
+  snprintf(path, sizeof(path), "/tmp/turn-hogs-%d.txt", (int)getpid());
+  FILE *f = fopen(path, "r");
+  ASSERT_TRUE(f != NULL);
+  // two comment lines, the header, then the top region
+  for (int i = 0; i < 4; ++i)
+    ASSERT_TRUE(fgets(line, sizeof(line), f) != NULL);
+  fclose(f);
+  unlink(path);
+  EXPECT_TRUE(strstr(line, "pthread_mutex_unlock@0x10 -> pthread_mutex_lock@0x20") != NULL)
+    << line;
+}
+
+struct hog_waiter {
+  uint64_t arrive_ns, stall_ns;
+};
+
+// the lock holder's turn: it had the turn given back right after a yield()
+static void *hog_holder(void *arg) {
+  hog_waiter *w = (hog_waiter *)arg;
+  unsigned waiters;
+  uint64_t g = TscClock::now();
+  w->stall_ns = TurnHogProfiler::grant(w->arrive_ns, g, waiters);
+  TurnHogProfiler::arrive(); // another thread queues while we hold the lock
+  usleep(30000);
+  TurnHogProfiler::release(syncfunc::pthread_mutex_unlock, 0x40, 0, waiters, g);
+  return NULL;
+}
+
+// "L" parks in a contended lock() for 30ms while "W" runs, then gets the
+// turn back and finishes.  Only the time L held the turn counts as its
+// in-op time, and W, queued when L parked, is not charged for a stall.
+TEST(turnhogtest, contended_lock) {
+  TscClock::init();
+  unsigned waiters;
+
+  TurnHogProfiler::arrive();
+  uint64_t g = TscClock::now();
+  TurnHogProfiler::grant(g, g, waiters);
+  hog_waiter w;
+  TurnHogProfiler::arrive();
+  w.arrive_ns = TscClock::now();
+  usleep(5000);
+  TurnHogProfiler::yield(g); // syncWait() on the lock
+
+  pthread_t th;
+  ASSERT_EQ(0, pthread_create(&th, NULL, hog_holder, &w));
+  pthread_join(th, NULL);
+  EXPECT_EQ(0U, w.stall_ns);
+
+  // turnWait() restarted L's clock when the turn came back
+  uint64_t back = TscClock::now();
+  TurnHogProfiler::release(syncfunc::pthread_mutex_lock, 0x50, 0, 0, back);
+  uint64_t t = TscClock::now();
+  TurnHogProfiler::grant(t, t, waiters);
+
+  options::output_dir = "/tmp";
+  TurnHogProfiler::dump();
+  char path[64], line[256];
+  snprintf(path, sizeof(path), "/tmp/turn-hogs-%d.txt", (int)getpid());
+  FILE *f = fopen(path, "r");
+  ASSERT_TRUE(f != NULL);
+  double in_op_ms = -1;
+  while (fgets(line, sizeof(line), f))
+    if (strstr(line, "-> pthread_mutex_lock@0x50"))
+      sscanf(line, "%*u %*f %lf", &in_op_ms);
+  fclose(f);
+  unlink(path);
+  EXPECT_GE(in_op_ms, 4.0);
+  EXPECT_LT(in_op_ms, 20.0) << "the 30ms parked in lock() is not in-op time";
+}